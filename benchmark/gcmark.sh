@@ -0,0 +1,6 @@
+#!/bin/sh
+# major GC marking time of benchmark/gcmark.mxc by number of marking threads
+for n in 1 2 4 8; do
+    MAXC_GC_THREADS=$n MAXC_GC_STATS=1 ./maxc benchmark/gcmark.mxc 2>&1 >/dev/null |
+        grep "final marking"
+done
@@ -0,0 +1,6 @@
+#!/bin/sh
+# the same addresses checked by the re module and by a hand-written matcher
+for f in regex regex-hand; do
+    echo "$f:"
+    time ./maxc benchmark/$f.mxc >/dev/null
+done
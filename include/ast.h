@@ -14,6 +14,7 @@ enum NDTYPE {
     NDTYPE_CHAR,
     NDTYPE_LIST,
     NDTYPE_SUBSCR,
+    NDTYPE_SLICE,
     NDTYPE_TUPLE,
     NDTYPE_RETURN,
     NDTYPE_BREAK,
@@ -31,6 +32,7 @@ enum NDTYPE {
     NDTYPE_BLOCK,
     NDTYPE_TYPEDBLOCK,
     NDTYPE_STRING,
+    NDTYPE_FORMAT,
     NDTYPE_BINARY,
     NDTYPE_MEMBER,
     NDTYPE_DOTEXPR,
@@ -40,9 +42,11 @@ enum NDTYPE {
     NDTYPE_EXPRIF,
     NDTYPE_FOR,
     NDTYPE_WHILE,
+    NDTYPE_MATCH,
     NDTYPE_NAMESOLVER,
     NDTYPE_NAMESPACE,
     NDTYPE_ASSERT,
+    NDTYPE_REGION,
     NDTYPE_NONENODE,
 };
 
@@ -79,7 +83,7 @@ typedef struct NodeNull {
 
 typedef struct NodeChar {
     AST_HEAD;
-    char ch;
+    int32_t ch;     /* code point */
 } NodeChar;
 
 typedef struct NodeString {
@@ -87,6 +91,12 @@ typedef struct NodeString {
     char *string;
 } NodeString;
 
+/* "a{x}b" and format("a{}b", x): the pieces are written one after another */
+typedef struct NodeFormat {
+    AST_HEAD;
+    Vector *pieces;
+} NodeFormat;
+
 typedef struct NodeList {
     AST_HEAD;
     /* let a = [10, 20, 30, 40]; */
@@ -123,8 +133,16 @@ typedef struct NodeSubscript {
     Ast *ls;
     Ast *index;
     bool istuple; // default: list
+    bool inbounds;  // index proven to be below the length
 } NodeSubscript;
 
+typedef struct NodeSlice {
+    AST_HEAD;
+    Ast *ls;
+    Ast *begin;
+    Ast *end;
+} NodeSlice;
+
 typedef struct NodeUnaop {
     AST_HEAD;
     enum UNAOP op;
@@ -201,6 +219,8 @@ typedef struct NodeFunction {
     int op;  // operator overloading
     /* generic */
     Vector *typevars;
+    /* user functions called from the body (for purity inference) */
+    Vector *callees;
 } NodeFunction;
 
 struct NodeFnCall {
@@ -249,6 +269,14 @@ typedef struct NodeWhile {
     Ast *body;
 } NodeWhile;
 
+typedef struct NodeMatch {
+    AST_HEAD;
+    Ast *target;
+    Vector *pats;   /* Vector of patterns for each arm */
+    Vector *bodies;
+    Ast *otherwise; /* `_` arm */
+} NodeMatch;
+
 typedef struct NodeBlock {
     AST_HEAD;
     Vector *cont;
@@ -271,12 +299,19 @@ typedef struct NodeAssert {
     Ast *cond;
 } NodeAssert;
 
+typedef struct NodeRegion {
+    AST_HEAD;
+    Ast *block;
+    Vector *vars;   /* variables declared inside, set by sema */
+} NodeRegion;
+
 typedef struct NoneNode_ {
     AST_HEAD;
 } NoneNode_;
 
 bool Ast_isexpr(Ast *);
 bool node_is_number(Ast *);
+bool pattern_int(Ast *, int64_t *);
 
 extern NoneNode_ nonenode;
 #define NONE_NODE ((Ast *)&nonenode)
@@ -285,7 +320,7 @@ NodeNumber *new_node_number_int(int64_t);
 NodeNumber *new_node_number_float(double);
 NodeBool *new_node_bool(bool);
 NodeNull *new_node_null();
-NodeChar *new_node_char(char);
+NodeChar *new_node_char(int32_t);
 NodeString *new_node_string(char *);
 NodeList *new_node_list(Vector *, size_t, Ast *, Ast *);
 NodeTuple *new_node_tuple(Vector *, uint16_t, Type *);
@@ -294,9 +329,12 @@ NodeReturn *new_node_return(Ast *);
 NodeIf *new_node_if(Ast *, Ast *, Ast *, bool);
 NodeFor *new_node_for(Vector *, Ast *, Ast *);
 NodeWhile *new_node_while(Ast *, Ast *);
+NodeMatch *new_node_match(Ast *, Vector *, Vector *, Ast *);
 NodeMember *new_node_member(Ast *, Ast *);
 NodeDotExpr *new_node_dotexpr(Ast *, Ast *);
 NodeSubscript *new_node_subscript(Ast *, Ast *);
+NodeSlice *new_node_slice(Ast *, Ast *, Ast *);
+NodeFormat *new_node_format(Vector *);
 NodeUnaop *new_node_unary(enum UNAOP, Ast *);
 NodeFunction *new_node_function(NodeVariable *, Ast *, Vector *, Varlist *);
 NodeFnCall *new_node_fncall(Ast *f, Vector *, Ast *);
@@ -314,6 +352,7 @@ NodeBlock *new_node_typedblock(Vector *);
 NodeNameSpace *new_node_namespace(char *, NodeBlock *);
 NodeNameSolver *new_node_namesolver(Ast *, Ast *);
 NodeAssert *new_node_assert(Ast *);
+NodeRegion *new_node_region(Ast *);
 
 #define CAST_AST(node) ((Ast *)(node))
 #define CAST_TYPE(node) ((Type *)(node))
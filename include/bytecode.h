@@ -21,7 +21,8 @@ Bytecode *New_Bytecode();
 void push_0arg(Bytecode *, enum OPCODE);
 void push_push(Bytecode *, int);
 void push_ipush(Bytecode *, int32_t);
-void push_cpush(Bytecode *, char);
+void push_cpush(Bytecode *, int32_t);
+void push_jmpeq(Bytecode *, size_t);
 void push_jmpneq(Bytecode *, size_t);
 void push_jmp(Bytecode *, size_t);
 void push_jmp_nerr(Bytecode *, int);
@@ -34,17 +35,17 @@ void push_lpush(Bytecode *, int);
 void push_functionset(Bytecode *, int);
 void push_structset(Bytecode *, int);
 void push_call(Bytecode *, int);
+void push_format(Bytecode *, int);
 void push_member_load(Bytecode *, int);
 void push_member_store(Bytecode *, int);
 void push_iter_next(Bytecode *, int);
 void replace_int32(size_t, Bytecode *, int32_t);
 void push_int8(Bytecode *, int8_t);
 void push_int32(Bytecode *, int32_t);
+void push_int64(Bytecode *, int64_t);
 
 Vector *set_label_opcode(Bytecode *);
 
-#ifdef MXC_DEBUG
 void codedump(uint8_t[], size_t *, Vector *);
-#endif
 
 #endif
@@ -0,0 +1,11 @@
+#ifndef MXC_CTFE_H
+#define MXC_CTFE_H
+
+#include "ast.h"
+#include "function.h"
+
+void ctfe_init(void);
+void ctfe_register(NodeFunction *, userfunction *);
+Ast *ctfe_fold_call(NodeFnCall *);
+
+#endif
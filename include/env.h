@@ -13,6 +13,8 @@ enum BLTINFN;
 enum VARATTR {
     VARATTR_CONST = 0b0001,
     VARATTR_UNINIT = 0b0010,
+    VARATTR_PURE = 0b0100,
+    VARATTR_MAYNEG = 0b1000,
 };
 
 typedef struct Varlist {
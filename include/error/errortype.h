@@ -7,6 +7,9 @@ enum RuntimeErrType {
     RTERR_ZERO_DIVISION,
     RTERR_ASSERT,
     RTERR_UNIMPLEMENTED,
+    RTERR_OUT_OF_FUEL,
+    RTERR_BADSLICE,
+    RTERR_BADPATTERN,
 };
 
 #endif
@@ -13,10 +13,13 @@ typedef struct RuntimeErr {
     enum RuntimeErrType type;    
     MxcValue args[2];
     int argc;
+    const char *msg;
 } RuntimeErr;
 
 void mxc_raise_err(Frame *frame, enum RuntimeErrType);
 void raise_outofrange(Frame *, MxcValue, MxcValue);
+void raise_badslice(Frame *, MxcValue, MxcValue);
+void raise_badpattern(Frame *, MxcValue, const char *);
 void runtime_error(Frame *);
 
 #endif
@@ -3,19 +3,79 @@
 
 #include "mem.h"
 #include "frame.h"
+#include "region.h"
 
 extern Frame *cur_frame;
+extern int gc_pending;
+extern int gc_globals_dirty;
+extern int gc_marking;
 
-typedef struct GCHeap {
-    struct GCHeap *next;
-    MxcObject *obj;
-} GCHeap;
+#ifndef USE_MARK_AND_SWEEP
+/* heap references are counted: the stored value gains one, the old loses one */
+#define GC_WRITE_BARRIER(ob, v)                                             \
+    do {                                                                    \
+        RC_INCREF(v);                                                       \
+        GC_REGION_BARRIER(ob, v);                                           \
+    } while(0)
+#define GC_SATB_BARRIER(old)        RC_DECREF(old)
+#define GC_GLOBAL_BARRIER(v)        ((void)0)
+#else
+/* old objects must be remembered when they start pointing to young ones */
+#define GC_WRITE_BARRIER(ob, v)                                             \
+    do {                                                                    \
+        if(isobj(v) && IS_YOUNG((v).obj) && !IS_YOUNG(ob) &&                \
+           !(((MxcObject *)(ob))->gc_flags & GC_REMEMBERED))                \
+            gc_remember((MxcObject *)(ob));                                 \
+        GC_REGION_BARRIER(ob, v);                                           \
+    } while(0)
 
-extern GCHeap root;
-extern GCHeap *tailp;
+#define GC_GLOBAL_BARRIER(v)                                                \
+    do {                                                                    \
+        if(isobj(v) && IS_YOUNG((v).obj))                                   \
+            gc_globals_dirty = 1;                                           \
+    } while(0)
 
-void heap_dump(void);
-size_t heap_length(void);
+/* keeps the snapshot of a running major cycle: shade what is overwritten */
+#define GC_SATB_BARRIER(old)                                                \
+    do {                                                                    \
+        if(gc_marking)                                                      \
+            gc_shade(old);                                                  \
+    } while(0)
+#endif  /* USE_MARK_AND_SWEEP */
+
+/*
+ *  C code keeps temporaries alive across a possible collection by
+ *  storing them in handles. Handles are roots and are updated when
+ *  their object moves, so values must be read back through them.
+ *
+ *      HandleScope scope = GC_SCOPE_OPEN();
+ *      MxcValue *res = gc_handle(new_string_static("[", 1));
+ *      ...
+ *      GC_SCOPE_CLOSE(scope);
+ */
+#define GC_NHANDLE_MAX  4096
+
+typedef int HandleScope;
+
+extern MxcValue gc_handles[GC_NHANDLE_MAX];
+extern int gc_nhandles;
+
+#define GC_SCOPE_OPEN()     (gc_nhandles)
+#define GC_SCOPE_CLOSE(s)   ((void)(gc_nhandles = (s)))
+
+void gc_init(void);
+void gc_visit_roots(ob_visit_fn);
+void rc_track(MxcObject *);
+void rc_adopt(MxcObject *);
+void rc_reconcile(bool);
+size_t rc_ncycle(void);
+MxcValue *gc_handle(MxcValue);
+bool gc_option(const char *);
+void gc_remember(MxcObject *);
+void gc_shade(MxcValue);
+void gc_parallel_mark(Vector *, int);
+void gc_safepoint(void);
+void gc_minor(void);
 void gc_run(void);
 
 #endif
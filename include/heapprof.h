@@ -0,0 +1,25 @@
+#ifndef MXC_HEAPPROF_H
+#define MXC_HEAPPROF_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "object/object.h"
+
+/*
+ *  --heap-profile[=<prefix>] records the allocation site (function and
+ *  bytecode offset) of every object. <prefix>.prof gets a table of the
+ *  sites active in each major cycle and the totals at exit, and each
+ *  heap_snapshot() call, as well as the exit, writes <prefix>.<n>.snap.
+ */
+extern bool heap_profiling;
+
+bool heapprof_option(const char *);
+void heapprof_alloc(MxcObject *);
+void heapprof_resize(MxcObject *, size_t);
+void heapprof_free(MxcObject *);
+void heapprof_move(MxcObject *, MxcObject *);
+void heapprof_gc(void);
+void heapprof_snapshot(void);
+
+#endif
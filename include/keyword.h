@@ -5,6 +5,8 @@ enum TKIND {
     TKIND_Char,
     TKIND_Identifer,
     TKIND_BQLIT,
+    TKIND_FString,      // start of "..{expr}.."
+    TKIND_FStringEnd,
     // KeyWord
     TKIND_TInt,
     TKIND_TUint,
@@ -42,6 +44,8 @@ enum TKIND {
     TKIND_Xor,
     TKIND_BreakPoint,
     TKIND_Assert,
+    TKIND_Match,
+    TKIND_Region,
     // Symbol
     TKIND_Lparen,      // (
     TKIND_Rparen,      // )
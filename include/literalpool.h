@@ -4,6 +4,7 @@
 #include "function.h"
 #include "util.h"
 #include "object/object.h"
+#include "object/strobject.h"
 
 enum LITKIND {
     LIT_STR,
@@ -16,7 +17,7 @@ enum LITKIND {
 typedef struct Literal {
     enum LITKIND kind;
     union {
-        char *str; // str
+        InternedStr *str;
         double fnumber;
         int64_t lnum;
         userfunction *func;
@@ -25,7 +26,7 @@ typedef struct Literal {
 } Literal;
 
 Literal *New_Literal();
-Literal *New_Literal_With_Str(char *);
+Literal *New_Literal_With_Str(InternedStr *);
 Literal *New_Literal_Long(int64_t);
 Literal *New_Literal_With_Fnumber(double);
 Literal *New_Literal_With_Userfn(userfunction *);
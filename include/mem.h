@@ -1,6 +1,8 @@
 #ifndef MAXC_MEM_H
 #define MAXC_MEM_H
 
+#include <stdbool.h>
+
 #include "object/object.h"
 #include "object/boolobject.h"
 #include "object/charobject.h"
@@ -10,58 +12,109 @@
 #include "object/listobject.h"
 #include "object/strobject.h"
 
-#define OBJECT_POOL
-
-#ifdef OBJECT_POOL
-union obalign {
-    MxcChar c;
-    MxcList l;
-    MxcIStruct st;
-    MxcString s;
-    MxcTuple t;
-    MxcFunction fn;
-    MxcCFunc cf;
+/*
+ *  Objects live in HEAP_PAGE_SIZE-aligned pages. Each page serves one
+ *  size class and keeps side bitmaps with one bit per 16-byte granule,
+ *  set at the first granule of an object.
+ */
+#define HEAP_PAGE_SIZE      (64 * 1024)
+#define HEAP_GRANULE_SHIFT  4
+#define HEAP_GRANULE        (1 << HEAP_GRANULE_SHIFT)
+#define HEAP_NGRANULE       (HEAP_PAGE_SIZE / HEAP_GRANULE)
+#define HEAP_BITMAP_WORDS   (HEAP_NGRANULE / 64)
+#define HEAP_MAX_SMALL      256
+#define HEAP_NCLASS         8
+
+typedef struct HeapPage HeapPage;
+
+struct HeapPage {
+    HeapPage *next;         /* all pages of the size class */
+    HeapPage *next_avail;   /* pages with free slots */
+    MxcObject *freelist;
+    uint32_t objsize;
+    uint32_t nfree;
+    uint32_t nslot;
+    uint16_t first;         /* granule of the first slot */
+    uint8_t sizeclass;
+    uint8_t inavail;
+    uint8_t unswept;
+    uint8_t region;         /* nesting depth of the owning region block, or 0 */
+    uint32_t *rank;         /* while compacting: live objects before each word */
+    uint32_t *sites;        /* --heap-profile: allocation site of each granule */
+    uint64_t allocbits[HEAP_BITMAP_WORDS];
+    uint64_t markbits[HEAP_BITMAP_WORDS];
 };
 
-typedef struct ObjectPool {
-    MxcObject **pool;
-    uint16_t len;
-    uint16_t reserved;
-} ObjectPool;
+#define HEAP_PAGE(ob)   \
+    ((HeapPage *)((uintptr_t)(ob) & ~(uintptr_t)(HEAP_PAGE_SIZE - 1)))
+#define HEAP_GRANULE_OF(ob) \
+    (((uintptr_t)(ob) & (HEAP_PAGE_SIZE - 1)) >> HEAP_GRANULE_SHIFT)
 
-#define OBPOOL_LAST (obpool.pool[obpool.len - 1])
+#define BITMAP_TEST(bm, i)  ((bm)[(i) >> 6] & ((uint64_t)1 << ((i) & 63)))
+#define BITMAP_SET(bm, i)   ((bm)[(i) >> 6] |= ((uint64_t)1 << ((i) & 63)))
+#define BITMAP_CLEAR(bm, i) ((bm)[(i) >> 6] &= ~((uint64_t)1 << ((i) & 63)))
 
-void New_Objectpool(void);
-void obpool_push(MxcObject *);
+#define GC_MARKED(ob)   BITMAP_TEST(HEAP_PAGE(ob)->markbits, HEAP_GRANULE_OF(ob))
+#define GC_SET_MARK(ob) BITMAP_SET(HEAP_PAGE(ob)->markbits, HEAP_GRANULE_OF(ob))
 
-#endif
+/*
+ *  New objects are bump-allocated in the nursery. Survivors of a minor
+ *  collection are copied into the pages above.
+ */
+#define NURSERY_SIZE    (1024 * 1024)
 
-#ifdef OBJECT_POOL
-#   define Mxc_free(ob) do {                    \
-        obpool_push((MxcObject *)(ob));         \
-    } while(0)
-#else
-#   define Mxc_free(ob) free(ob)
-#endif  /* OBJECT_POOL */
+extern uint8_t *nursery_start;
 
-#ifndef USE_MARK_AND_SWEEP
-#   define INCREF(ob) (++((MxcObject *)(ob))->refcount)
+/*
+ *  Byte counts of the old generation, including out-of-line buffers
+ *  registered with Mxc_set_extsize. A major cycle starts once heap_bytes
+ *  reaches gc_trigger.
+ */
+extern size_t heap_bytes;
+extern size_t allocated_mem;
+extern size_t gc_trigger;
+
+#define IS_YOUNG(ob)    \
+    ((uintptr_t)(ob) - (uintptr_t)nursery_start < NURSERY_SIZE)
 
-#   define DECREF(ob)                                                              \
-        do {                                                                       \
-            if(--((MxcObject *)(ob))->refcount == 0) {                             \
-                OBJIMPL((MxcObject *)ob)->dealloc((MxcObject *)ob);                \
-            }                                                                      \
+#define Mxc_free(ob) heap_free((MxcObject *)(ob))
+
+/* references from the stack and from locals are never counted */
+#define INCREF(ob) ((void)0)
+#define DECREF(ob) ((void)0)
+
+#ifndef USE_MARK_AND_SWEEP
+#   define RC_INCREF(v)                                                     \
+        do {                                                                \
+            MxcValue v_ = (v);                                              \
+            if(isobj(v_)) ++v_.obj->refcount;                               \
         } while(0)
+#   define RC_DECREF(v)                                                     \
+        do {                                                                \
+            MxcValue v_ = (v);                                              \
+            if(isobj(v_)) rc_decref(v_.obj);                                \
+        } while(0)
+
+void rc_decref(MxcObject *);
 #else
-#   define INCREF(ob) ((void)0)
-#   define DECREF(ob) ((void)0)
+#   define RC_INCREF(v) ((void)0)
+#   define RC_DECREF(v) ((void)0)
 #endif  /* USE_MARK_AND_SWEEP */
 
-#define GC_MARK(ob) (OBJIMPL(ob)->mark((MxcObject *)(ob)))
-#define GC_GUARD(ob) (OBJIMPL(ob)->guard((MxcObject *)(ob)))
-#define GC_UNGUARD(ob) (OBJIMPL(ob)->unguard((MxcObject *)(ob)))
-
 MxcObject *Mxc_malloc(size_t);
+MxcObject *Mxc_malloc_fin(size_t);
+void Mxc_set_extsize(MxcObject *, size_t);
+MxcObject *heap_alloc(size_t);
+void heap_free(MxcObject *);
+void nursery_reset(void);
+void heap_sweep_start(void);
+bool heap_sweep_step(size_t);
+void heap_sweep(void);
+bool heap_compact_start(double);
+MxcObject *heap_forward(MxcObject *);
+void heap_trace_live(ob_visit_fn);
+size_t heap_compact_finish(void);
+void heap_dump(void);
+size_t heap_length(void);
 
 #endif  /* MAXC_MEM_H */
@@ -33,4 +33,15 @@ void cbltin_add_obj(Vector *, NodeVariable *, MxcValue);
 void builtin_Init(void);
 extern Vector *Global_Cbltins;
 
+/*
+ *  Native modules. `import <name>;` puts their functions in the
+ *  namespace <name>, next to anything lib/<name>.mxc defines.
+ */
+void strmod_Init(void);
+void remod_Init(void);
+MxcModule *new_cmodule(char *);
+MxcModule *search_cmodule(char *);
+void cmodule_visit(ob_visit_fn);
+extern Vector *Global_Cmodules;
+
 #endif
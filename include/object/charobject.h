@@ -3,12 +3,7 @@
 
 #include "object/object.h"
 
-typedef struct MxcChar {
-    OBJECT_HEAD;
-    char ch;
-} MxcChar;
-
-MxcValue new_char(char);
-MxcValue new_char_ref(char *c);
+/* chars are immediate code points, see mval_char */
+void char_tostring(MxcValue, MxcWriter *);
 
 #endif
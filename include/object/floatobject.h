@@ -22,6 +22,6 @@ MxcValue float_div(MxcValue, MxcValue);
 #define FloatMul(l, r) (mval_float((l).fnum * (r).fnum))
 #define FloatDiv(l, r) (mval_float((l).fnum / (r).fnum))
 
-MxcValue float_tostring(MxcValue);
+void float_tostring(MxcValue, MxcWriter *);
 
 #endif
@@ -18,6 +18,6 @@ MxcValue new_list_with_size(MxcValue, MxcValue);
 MxcValue list_get(MxcIterable *, int64_t);
 MxcValue list_set(MxcIterable *, int64_t, MxcValue);
 
-MxcValue list_tostring(MxcObject *);
+void list_tostring(MxcObject *, MxcWriter *);
 
 #endif
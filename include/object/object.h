@@ -9,7 +9,10 @@
 #define ITERABLE_OBJECT_HEAD MxcIterable base
 #define ITERABLE(ob) ((MxcIterable *)(ob))
 
+/* `make rc` builds with deferred reference counting instead */
+#ifndef MXC_DEFERRED_RC
 #define USE_MARK_AND_SWEEP
+#endif
 
 struct MxcString;
 typedef struct MxcString MxcString;
@@ -21,16 +24,32 @@ typedef struct MxcValue MxcValue;
 
 struct MxcObject {
     MxcObjImpl *impl;
-    unsigned char marked;
-    unsigned char gc_guard;
+    unsigned char gc_flags;
+    unsigned short size;
+    uint32_t extsize;   /* malloc'd bytes owned by the object */
+#ifndef USE_MARK_AND_SWEEP
+    uint32_t refcount;  /* references from heap objects only */
+#endif
 };
 
+#define GC_FORWARDED    0x1
+#define GC_REMEMBERED   0x2
+/* deferred reference counting */
+#define GC_ZCT          0x4
+#define GC_ROOTED       0x8
+#define GC_PURPLE       0x10
+#define GC_GRAY         0x20
+#define GC_WHITE        0x40
+/* allocated in a region block, see region.h */
+#define GC_REGION       0x80
+
 enum VALUET {
     VAL_INT,
     VAL_FLO,
     VAL_TRUE,
     VAL_FALSE,
     VAL_NULL,
+    VAL_CHAR,
     VAL_OBJ,
     VAL_INVALID = -1,
 };
@@ -49,23 +68,22 @@ struct MxcValue {
 #define mval_true      (MxcValue){ .t = VAL_TRUE, .num = 1 }
 #define mval_false     (MxcValue){ .t = VAL_FALSE, .num = 0 }
 #define mval_null      (MxcValue){ .t = VAL_NULL, .num = 0 }
+#define mval_char(c)   (MxcValue){ .t = VAL_CHAR, .num = (uint32_t)(c) }
 #define mval_obj(v)    (MxcValue){ .t = VAL_OBJ, .obj = (MxcObject *)(v) }
 #define mval_invalid   (MxcValue){ .t = VAL_INVALID, {0}}
 
 #define Invalid_val(v)  ((v).t == VAL_INVALID)
 #define isobj(v)        ((v).t == VAL_OBJ)
 
-#define optr(v)     (v.obj)
-#define ostr(v)     ((MxcString *)v.obj)
-#define ocallee(v)  ((MxcCallable *)v.obj)
-#define olist(v)    ((MxcList *)v.obj)
-#define ostrct(v)   ((MxcIStruct *)v.obj)
+#define optr(v)     ((v).obj)
+#define ostr(v)     ((MxcString *)(v).obj)
+#define ocallee(v)  ((MxcCallable *)(v).obj)
+#define olist(v)    ((MxcList *)(v).obj)
+#define ostrct(v)   ((MxcIStruct *)(v).obj)
 
 MxcValue mval2str(MxcValue);
+void mval_write(MxcWriter *, MxcValue);
 MxcValue mval_copy(MxcValue);
-void mgc_mark(MxcValue);
-void mgc_guard(MxcValue);
-void mgc_unguard(MxcValue);
 
 typedef struct MxcError {
     OBJECT_HEAD;
@@ -79,6 +97,7 @@ typedef struct MxcTuple {
 typedef struct MxcIStruct {
     OBJECT_HEAD;
     MxcValue *field;
+    int nfield;
 } MxcIStruct;
 
 MxcValue new_struct(int);
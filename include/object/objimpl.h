@@ -12,35 +12,36 @@ typedef struct MxcIterable MxcIterable;
 
 struct MxcString;
 typedef struct MxcString MxcString;
+struct MxcWriter;
+typedef struct MxcWriter MxcWriter;
 
-typedef MxcValue (*ob_tostring_fn)(MxcObject *);
+typedef void (*ob_tostring_fn)(MxcObject *, MxcWriter *);
 typedef void (*ob_dealloc_fn)(MxcObject *);
-typedef void (*ob_mark_fn)(MxcObject *);
 typedef MxcValue (*ob_copy_fn)(MxcObject *);
+typedef void (*ob_visit_fn)(MxcValue *);
+typedef void (*ob_trace_fn)(MxcObject *, ob_visit_fn);
 typedef MxcValue (*iter_getitem_fn)(MxcIterable *, int64_t);
 typedef MxcValue (*iter_setitem_fn)(MxcIterable *, int64_t, MxcValue);
 
 typedef struct MxcObjImpl {
     char *type_name;
-    ob_tostring_fn tostring;
+    ob_tostring_fn tostring;    /* format into the writer */
     ob_dealloc_fn dealloc;
     ob_copy_fn copy;
-    ob_mark_fn mark;
-    ob_mark_fn guard;
-    ob_mark_fn unguard;
     iter_getitem_fn get;
     iter_setitem_fn set;
+    ob_trace_fn trace;      /* visit every slot holding a value */
 } MxcObjImpl;
 
 extern MxcObjImpl integer_objimpl;
 extern MxcObjImpl float_objimpl;
 extern MxcObjImpl string_objimpl;
-extern MxcObjImpl char_objimpl;
 extern MxcObjImpl bool_true_objimpl;
 extern MxcObjImpl bool_false_objimpl;
 extern MxcObjImpl null_objimpl;
 extern MxcObjImpl list_objimpl;
 extern MxcObjImpl userfn_objimpl;
 extern MxcObjImpl cfn_objimpl;
+extern MxcObjImpl struct_objimpl;
 
 #endif
@@ -1,24 +1,122 @@
 #ifndef MXC_STRINGOBJECT_H
 #define MXC_STRINGOBJECT_H
 
+#include <stdbool.h>
+
 #include "object/object.h"
 #include "object/iterobject.h"
 
+/*
+ *  Buffer shared by slices and by the results of repeated concatenation.
+ *  `a + b` writes b right after a when a ends where the buffer's contents
+ *  end, and the result is a longer view of the same buffer. Only views
+ *  ending at `len` are NUL-terminated; see str_cstr.
+ */
+typedef struct StrBuf {
+    size_t refs;    /* strings reading from data */
+    size_t len;
+    size_t cap;
+    char *data;
+} StrBuf;
+
+/* what the bytes of a string are; see str_enc */
+enum {
+    STR_ENC_UNKNOWN,
+    STR_ENC_ASCII,
+    STR_ENC_UTF8,
+    STR_ENC_BYTES,      /* not valid UTF-8, indexed by byte */
+};
+
+/*
+ *  Byte offsets of every STR_INDEX_STEP-th code point of a UTF-8 string,
+ *  so s[i] walks at most that many code points. The cursor is the last
+ *  one looked up, which makes walking the string in order O(1) a step.
+ */
+#define STR_INDEX_STEP  32
+
+typedef struct StrIndex {
+    size_t nchars;
+    size_t cp;      /* cursor */
+    size_t off;
+    size_t marks[];
+} StrIndex;
+
+/*
+ *  Contents of literals, stored once for the whole run. Strings made
+ *  from an entry share its bytes and its hash, so two of them are equal
+ *  exactly when they point to the same bytes.
+ */
+typedef struct InternedStr {
+    char *str;
+    size_t len;
+    uint32_t hash;
+    int lit;        /* key in the literal pool, -1 if none */
+    int enc;
+    StrIndex *index;
+} InternedStr;
+
+/*
+ *  Where the bytes of a string are. Short strings keep them in the
+ *  object, after the fields, so they need no other allocation; objects
+ *  move, so their bytes are reached with STR_PTR rather than str.
+ */
+enum {
+    STR_STATIC,     /* owned by a literal or by buf */
+    STR_DYN,        /* str is malloc'd for this string */
+    STR_INLINE,     /* in inl */
+};
+
+#define STR_INLINE_MAX  22
+
 struct MxcString {
     ITERABLE_OBJECT_HEAD;
-    char *str;
-    bool isdyn;
+    char *str;      /* unused if STR_INLINE */
+    StrBuf *buf;    /* if set, str points into buf->data */
+    uint32_t hash;  /* 0 until computed */
+    StrIndex *index;    /* UTF-8 only, built when first needed */
+    uint8_t enc;
+    uint8_t storage;
+    bool interned;  /* str is the whole of an InternedStr, index too */
+    char inl[];     /* NUL-terminated, as long as the object allows */
 };
 
+#define STR_PTR(s)  ((s)->storage == STR_INLINE ? (s)->inl : (s)->str)
+
 MxcValue new_string(char *, size_t);
 MxcValue new_string_copy(char *, size_t);
 MxcValue new_string_static(char *, size_t);
+MxcValue new_string_interned(InternedStr *);
+InternedStr *str_intern(char *, size_t);
+uint32_t str_hashof(MxcString *);
+bool str_eq(MxcValue, MxcValue);
 MxcValue str_concat(MxcValue, MxcValue);
+MxcValue str_format(MxcValue *, int);
 void str_append(MxcValue, MxcValue);
 void str_cstr_append(MxcValue, char *, size_t);
+char *str_cstr(MxcString *);
+MxcValue str_slice(MxcValue, size_t, size_t);
+MxcValue str_split(MxcValue, MxcValue);
+MxcValue str_lines(MxcValue);
+MxcValue str_trim(MxcValue);
+MxcValue str_find(MxcValue, MxcValue);
+bool str_contains(MxcValue, MxcValue);
+bool str_starts_with(MxcValue, MxcValue);
+MxcValue str_count(MxcValue, MxcValue);
+MxcValue str_replace(MxcValue, MxcValue, MxcValue);
+const char *str_search(const char *, size_t, const char *, size_t);
+size_t str_count_char(const char *, size_t, char);
+int utf8_scan(const char *, size_t, size_t *);
+uint32_t utf8_decode(const char *);
+size_t utf8_encode(char *, uint32_t);
+size_t utf8_seqlen(char);
+StrIndex *str_index_build(const char *, size_t, size_t);
+int str_enc(MxcString *);
+size_t str_nchars(MxcString *);
+size_t str_offset(MxcString *, size_t);
+size_t str_cpos(MxcString *, size_t);
 MxcValue str_index(MxcIterable *, int64_t);
 MxcValue str_index_set(MxcIterable *, int64_t, MxcValue);
 
-MxcValue string_tostring(MxcObject *);
+void string_tostring(MxcObject *, MxcWriter *);
 
 #endif
@@ -42,6 +42,9 @@ OPCODE_DEF(FGTE)
 OPCODE_DEF(JMP)
 OPCODE_DEF(JMP_EQ)
 OPCODE_DEF(JMP_NOTEQ)
+OPCODE_DEF(JUMP_TABLE)
+OPCODE_DEF(JUMP_BSEARCH)
+OPCODE_DEF(JUMP_HASH)
 OPCODE_DEF(JMP_NOTERR)
 OPCODE_DEF(INC)
 OPCODE_DEF(DEC)
@@ -57,6 +60,8 @@ OPCODE_DEF(LISTSET_SIZE)
 OPCODE_DEF(LISTLENGTH)
 OPCODE_DEF(SUBSCR)
 OPCODE_DEF(SUBSCR_STORE)
+OPCODE_DEF(LIST_GET_NOCHECK)
+OPCODE_DEF(LIST_SET_NOCHECK)
 OPCODE_DEF(STRINGSET)
 OPCODE_DEF(TUPLESET)
 OPCODE_DEF(FUNCTIONSET)
@@ -68,5 +73,11 @@ OPCODE_DEF(MEMBER_LOAD)
 OPCODE_DEF(MEMBER_STORE)
 OPCODE_DEF(ITER_NEXT)
 OPCODE_DEF(STRCAT)
+OPCODE_DEF(STRSLICE)
+OPCODE_DEF(STREQ)
+OPCODE_DEF(STRNOTEQ)
+OPCODE_DEF(FORMAT)
 OPCODE_DEF(BREAKPOINT)
 OPCODE_DEF(ASSERT)
+OPCODE_DEF(REGION_ENTER)
+OPCODE_DEF(REGION_EXIT)
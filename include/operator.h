@@ -57,6 +57,7 @@ struct MxcOperator {
 extern MxcOperator opdefs_integer[];
 extern MxcOperator opdefs_boolean[];
 extern MxcOperator opdefs_float[];
+extern MxcOperator opdefs_char[];
 extern MxcOperator opdefs_string[];
 
 MxcOperator *chk_operator_type(MxcOperator *, enum MXC_OPERATOR, int, Type *);
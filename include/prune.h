@@ -0,0 +1,8 @@
+#ifndef MXC_PRUNE_H
+#define MXC_PRUNE_H
+
+#include "util.h"
+
+void prune_unreachable(Vector *);
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef MXC_REGEX_H
+#define MXC_REGEX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ *  Regular expressions over UTF-8 bytes. A pattern compiles to a
+ *  Thompson NFA. regex_test and regex_fullmatch run it as a DFA whose
+ *  states are built as the input reaches them; regex_exec, which also
+ *  reports where the groups matched, runs it as a Pike VM.
+ *
+ *  Supported: literals, `.`, [classes], \d \w \s and their negations,
+ *  * + ? {m,n} (lazy with a trailing ?), | , (groups), (?:...), ^ and $.
+ */
+typedef struct Regex Regex;
+
+#define RE_NOPOS ((size_t)-1)
+
+Regex *regex_compile(const char *, size_t, const char **);
+void regex_free(Regex *);
+int regex_ncap(Regex *);
+bool regex_test(Regex *, const char *, size_t);
+bool regex_fullmatch(Regex *, const char *, size_t);
+bool regex_exec(Regex *, const char *, size_t, size_t, size_t *);
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef MXC_REGION_H
+#define MXC_REGION_H
+
+#include <stdbool.h>
+
+#include "mem.h"
+#include "frame.h"
+
+/*
+ *  Objects allocated while a `region { ... }` block runs, callees
+ *  included, come from pages owned by the block and are freed together
+ *  when it exits, without the GC. Sema rejects stores that let them
+ *  outlive the block; if one happens anyway, e.g. in a called function,
+ *  the store barrier notices and the pages join the heap instead.
+ *
+ *  Blocks nested deeper than REGION_NEST_MAX share the innermost region.
+ */
+#define REGION_NEST_MAX 255
+
+typedef struct Region {
+    HeapPage *pages;
+    HeapPage *cur[HEAP_NCLASS];     /* page being filled, per size class */
+    Vector *owners;                 /* objects with malloc'd buffers */
+    int depth;
+    bool escaped;
+} Region;
+
+extern int nregion;
+extern size_t region_nreleased;
+extern size_t region_nescaped;
+
+#ifdef USE_MARK_AND_SWEEP
+/* region objects are roots, so the write barrier never remembers them */
+#define GC_REGION_FLAGS (GC_REGION | GC_REMEMBERED)
+#else
+/* counted as usual, but rc_decref never queues them */
+#define GC_REGION_FLAGS (GC_REGION | GC_ZCT | GC_PURPLE)
+#endif
+
+#define REGION_OF(ob)   \
+    ((((MxcObject *)(ob))->gc_flags & GC_REGION) ? HEAP_PAGE(ob)->region : 0)
+
+/* storing a region object into anything older keeps it alive */
+#define GC_REGION_BARRIER(ob, v)                                            \
+    do {                                                                    \
+        if(nregion && isobj(v) && REGION_OF((v).obj) > REGION_OF(ob))       \
+            region_escape((v).obj);                                         \
+    } while(0)
+
+MxcObject *region_alloc(Region *, size_t);
+void region_pages_release(Region *);
+void region_pages_adopt(Region *);
+
+Region *region_current(void);
+void region_enter(void);
+void region_exit(Frame *);
+void region_unwind(int);
+void region_escape(MxcObject *);
+void region_own(MxcObject *);
+void region_visit(ob_visit_fn);
+
+#endif
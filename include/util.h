@@ -1,12 +1,13 @@
 #ifndef MXC_UTIL_H
 #define MXC_UTIL_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 typedef struct Vector {
     void **data;
-    uint16_t len;
-    uint16_t reserved;
+    int len;
+    int reserved;
 } Vector;
 
 Vector *New_Vector(void);
@@ -36,6 +37,8 @@ void string_push(String *, char);
 char string_pop(String *self);
 
 int get_digit(int);
+uint32_t str_hash(const char *);
+uint32_t str_hash_len(const char *, size_t);
 char *read_file(char *);
 
 #endif
@@ -6,6 +6,7 @@
 
 extern Vector *ltable;
 extern int error_flag;
+extern int64_t vm_fuel;
 
 int VM_run(Frame *);
 int vm_exec(Frame *);
@@ -0,0 +1,37 @@
+#ifndef MXC_WRITER_H
+#define MXC_WRITER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ *  Values are formatted straight into a writer's buffer. A writer on a
+ *  stream flushes when the buffer is full, and at each newline if the
+ *  stream is a terminal. Without a stream the buffer grows instead,
+ *  and without a buffer the writer only counts the bytes; floats count
+ *  as their longest form.
+ */
+typedef struct MxcWriter {
+    char *buf;
+    size_t len;
+    size_t cap;
+    FILE *fp;
+    bool linebuf;
+} MxcWriter;
+
+extern MxcWriter mxc_stdout;
+
+void writer_init(void);
+void writer_open_mem(MxcWriter *, size_t);
+void writer_open_count(MxcWriter *);
+void writer_open_buf(MxcWriter *, char *, size_t);
+char *writer_cstr(MxcWriter *);
+void writer_flush(MxcWriter *);
+void writer_write(MxcWriter *, const char *, size_t);
+void writer_putc(MxcWriter *, char);
+void writer_int(MxcWriter *, int64_t);
+void writer_float(MxcWriter *, double);
+
+#endif
@@ -17,11 +17,13 @@ bool Ast_isexpr(Ast *self) {
     case NDTYPE_CHAR:
     case NDTYPE_LIST:
     case NDTYPE_SUBSCR:
+    case NDTYPE_SLICE:
     case NDTYPE_TUPLE:
     case NDTYPE_FUNCCALL:
     case NDTYPE_ASSIGNMENT:
     case NDTYPE_VARIABLE:
     case NDTYPE_STRING:
+    case NDTYPE_FORMAT:
     case NDTYPE_BINARY:
     case NDTYPE_MEMBER:
     case NDTYPE_DOTEXPR:
@@ -38,6 +40,30 @@ bool node_is_number(Ast *a) {
     return a && a->type == NDTYPE_NUM;
 }
 
+/* integer or char literal used as a match pattern */
+bool pattern_int(Ast *a, int64_t *n) {
+    if(!a) return false;
+
+    switch(a->type) {
+    case NDTYPE_NUM:
+        if(((NodeNumber *)a)->isfloat) return false;
+        *n = ((NodeNumber *)a)->number;
+        return true;
+    case NDTYPE_CHAR:
+        *n = ((NodeChar *)a)->ch;
+        return true;
+    case NDTYPE_UNARY: {
+        NodeUnaop *u = (NodeUnaop *)a;
+        if(u->op != UNA_MINUS || !node_is_number(u->expr)) return false;
+        if(!pattern_int(u->expr, n)) return false;
+        *n = -*n;
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
 NodeNumber *new_node_number_int(int64_t n) {
     NodeNumber *node = (NodeNumber *)xmalloc(sizeof(NodeNumber));
 
@@ -62,7 +88,7 @@ NodeNumber *new_node_number_float(double n) {
     return node;
 }
 
-NodeChar *new_node_char(char c) {
+NodeChar *new_node_char(int32_t c) {
     NodeChar *node = xmalloc(sizeof(NodeChar));
     ((Ast *)node)->type = NDTYPE_CHAR;
     CTYPE(node) = mxcty_char;
@@ -156,6 +182,27 @@ NodeSubscript *new_node_subscript(Ast *l, Ast *i) {
     ((Ast *)node)->type = NDTYPE_SUBSCR;
     node->ls = l;
     node->index = i;
+    node->inbounds = false;
+    CTYPE(node) = NULL;
+
+    return node;
+}
+
+NodeFormat *new_node_format(Vector *pieces) {
+    NodeFormat *node = xmalloc(sizeof(NodeFormat));
+    ((Ast *)node)->type = NDTYPE_FORMAT;
+    node->pieces = pieces;
+    CTYPE(node) = mxcty_string;
+
+    return node;
+}
+
+NodeSlice *new_node_slice(Ast *l, Ast *b, Ast *e) {
+    NodeSlice *node = xmalloc(sizeof(NodeSlice));
+    ((Ast *)node)->type = NDTYPE_SLICE;
+    node->ls = l;
+    node->begin = b;
+    node->end = e;
     CTYPE(node) = NULL;
 
     return node;
@@ -183,6 +230,7 @@ NodeFunction *new_node_function(NodeVariable *n,
     node->typevars = tyvars;
     node->is_generic = tyvars ? true : false;
     node->op = -1;
+    node->callees = New_Vector();
 
     return node;
 }
@@ -299,6 +347,17 @@ NodeWhile *new_node_while(Ast *c, Ast *b) {
     return node;
 }
 
+NodeMatch *new_node_match(Ast *t, Vector *p, Vector *b, Ast *o) {
+    NodeMatch *node = xmalloc(sizeof(NodeMatch));
+    ((Ast *)node)->type = NDTYPE_MATCH;
+    node->target = t;
+    node->pats = p;
+    node->bodies = b;
+    node->otherwise = o;
+
+    return node;
+}
+
 NodeObject *new_node_object(char *name, Vector *decls) {
     NodeObject *node = xmalloc(sizeof(NodeObject));
     ((Ast *)node)->type = NDTYPE_OBJECT;
@@ -360,6 +419,15 @@ NodeAssert *new_node_assert(Ast *a) {
     return node;
 }
 
+NodeRegion *new_node_region(Ast *b) {
+    NodeRegion *node = xmalloc(sizeof(NodeRegion));
+    ((Ast *)node)->type = NDTYPE_REGION;
+    node->block = b;
+    node->vars = New_Vector();
+
+    return node;
+}
+
 NoneNode_ nonenode = {
     {
         NDTYPE_NONENODE,
@@ -40,9 +40,9 @@ void push_push(Bytecode *self, int key) {
     push_int32(self, key);
 }
 
-void push_cpush(Bytecode *self, char c) {
+void push_cpush(Bytecode *self, int32_t c) {
     push(self, OP_CPUSH);
-    push_int8(self, c);
+    push_int32(self, c);
 }
 
 void push_jmp(Bytecode *self, size_t pc) {
@@ -51,6 +51,12 @@ void push_jmp(Bytecode *self, size_t pc) {
     push_int32(self, (int32_t)pc);
 }
 
+void push_jmpeq(Bytecode *self, size_t pc) {
+    push(self, (uint8_t)OP_JMP_EQ);
+
+    push_int32(self, (int32_t)pc);
+}
+
 void push_jmpneq(Bytecode *self, size_t pc) {
     push(self, (uint8_t)OP_JMP_NOTEQ);
 
@@ -122,6 +128,12 @@ void push_call(Bytecode *self, int nargs) {
     push_int32(self, nargs);
 }
 
+void push_format(Bytecode *self, int npieces) {
+    push(self, OP_FORMAT);
+
+    push_int32(self, npieces);
+}
+
 void push_member_load(Bytecode *self, int offset) {
     push(self, (uint8_t)OP_MEMBER_LOAD);
 
@@ -142,6 +154,11 @@ void push_int32(Bytecode *self, int32_t i32) {
     push(self, (uint8_t)((i32 >> 24) & 0xff));
 }
 
+void push_int64(Bytecode *self, int64_t i64) {
+    push_int32(self, (int32_t)(i64 & 0xffffffff));
+    push_int32(self, (int32_t)(i64 >> 32));
+}
+
 void replace_int32(size_t cpos, Bytecode *dst, int32_t src) {
     dst->code[cpos + 1] = ((uint8_t)((src >> 0) & 0xff));
     dst->code[cpos + 2] = ((uint8_t)((src >> 8) & 0xff));
@@ -151,14 +168,21 @@ void replace_int32(size_t cpos, Bytecode *dst, int32_t src) {
 
 static int32_t read_int32(uint8_t self[], size_t *pc) { // for Bytecode shower
     int32_t a = (int32_t)(
-        ((uint8_t)self[(*pc) + 3] << 24) | ((uint8_t)self[(*pc) + 2] << 16) |
-        ((uint8_t)self[(*pc) + 1] << 8)  | ((uint8_t)self[(*pc)]));
+        ((uint32_t)self[(*pc) + 3] << 24) | ((uint32_t)self[(*pc) + 2] << 16) |
+        ((uint32_t)self[(*pc) + 1] << 8)  | ((uint32_t)self[(*pc)]));
 
     *pc += 4;
 
     return a;
 }
 
+static int64_t read_int64(uint8_t self[], size_t *pc) {
+    uint32_t lo = (uint32_t)read_int32(self, pc);
+    uint32_t hi = (uint32_t)read_int32(self, pc);
+
+    return (int64_t)((uint64_t)hi << 32 | lo);
+}
+
 void codedump(uint8_t a[], size_t *i, Vector *lt) {
     printf("%04ld ", *i);
 
@@ -227,14 +251,48 @@ void codedump(uint8_t a[], size_t *i, Vector *lt) {
         printf("jmp %d", i32);
         break;
     }
-    case OP_JMP_EQ:
-        printf("jmpeq");
+    case OP_JMP_EQ: {
+        int i32 = read_int32(a, i);
+        printf("jmpeq %d", i32);
         break;
+    }
     case OP_JMP_NOTEQ: {
         int i32 = read_int32(a, i);
         printf("jmpneq %d", i32);
         break;
     }
+    case OP_JUMP_TABLE: {
+        int min = read_int32(a, i);
+        int n = read_int32(a, i);
+        int dflt = read_int32(a, i);
+        printf("jump_table min %d, default %d:", min, dflt);
+        for(int k = 0; k < n; ++k) {
+            printf(" %d", read_int32(a, i));
+        }
+        break;
+    }
+    case OP_JUMP_BSEARCH: {
+        int n = read_int32(a, i);
+        int dflt = read_int32(a, i);
+        printf("jump_bsearch default %d:", dflt);
+        for(int k = 0; k < n; ++k) {
+            int64_t key = read_int64(a, i);
+            printf(" %ld->%d", key, read_int32(a, i));
+        }
+        break;
+    }
+    case OP_JUMP_HASH: {
+        int mask = read_int32(a, i);
+        int dflt = read_int32(a, i);
+        printf("jump_hash default %d:", dflt);
+        for(int k = 0; k <= mask; ++k) {
+            int lit = read_int32(a, i);
+            int dst = read_int32(a, i);
+            if(lit != -1)
+                printf(" \"%s\"->%d", ((Literal *)lt->data[lit])->str->str, dst);
+        }
+        break;
+    }
     case OP_JMP_NOTERR: {
         int i32 = read_int32(a, i);
         printf("jmpnoterr %d", i32);
@@ -265,9 +323,11 @@ void codedump(uint8_t a[], size_t *i, Vector *lt) {
     case OP_LISTLENGTH: printf("listlength"); break;
     case OP_SUBSCR: printf("subscr"); break;
     case OP_SUBSCR_STORE: printf("subscr_store"); break;
+    case OP_LIST_GET_NOCHECK: printf("list_get_nocheck"); break;
+    case OP_LIST_SET_NOCHECK: printf("list_set_nocheck"); break;
     case OP_STRINGSET: {
         int k = read_int32(a, i);
-        printf("stringset %s", ((Literal *)lt->data[k])->str);
+        printf("stringset %s", ((Literal *)lt->data[k])->str->str);
         break;
     }
     case OP_TUPLESET: printf("tupleset"); break;
@@ -275,7 +335,7 @@ void codedump(uint8_t a[], size_t *i, Vector *lt) {
         int k = read_int32(a, i);
         userfunction *f = ((Literal *)lt->data[k])->func;
 
-        printf("funcset ->\n");
+        printf("funcset %s ->\n", f->name);
 
         printf("length: %d\n", f->codesize);
 
@@ -344,8 +404,26 @@ void codedump(uint8_t a[], size_t *i, Vector *lt) {
         break;
     }
     case OP_STRCAT: printf("strcat"); break;
+    case OP_STRSLICE: printf("strslice"); break;
+    case OP_STREQ: printf("streq"); break;
+    case OP_STRNOTEQ: printf("strnoteq"); break;
+    case OP_FORMAT: {
+        int n = read_int32(a, i);
+        printf("format pieces:%d", n);
+        break;
+    }
     case OP_BREAKPOINT: printf("breakpoint"); break;
     case OP_ASSERT: printf("assert"); break;
+    case OP_REGION_ENTER: printf("region_enter"); break;
+    case OP_REGION_EXIT: {
+        int global = a[(*i)++];
+        int n = read_int32(a, i);
+        printf("region_exit %s", global ? "global" : "local");
+        for(int k = 0; k < n; ++k) {
+            printf(" %d", read_int32(a, i));
+        }
+        break;
+    }
     default:        printf("!Error!"); break;
     }
 }
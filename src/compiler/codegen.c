@@ -1,10 +1,12 @@
 #include <limits.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "maxc.h"
 #include "ast.h"
 #include "codegen.h"
 #include "bytecode.h"
+#include "ctfe.h"
 #include "error/error.h"
 #include "literalpool.h"
 #include "function.h"
@@ -20,14 +22,19 @@ static void emit_string(Ast *, Bytecode *, bool);
 static void emit_rawobject(MxcValue, Bytecode *, bool);
 static void emit_list(Ast *, Bytecode *, bool);
 static void emit_listaccess(Ast *, Bytecode *);
+static void emit_slice(Ast *, Bytecode *);
+static void emit_format(Ast *, Bytecode *, bool);
 static void emit_tuple(Ast *, Bytecode *);
 static void emit_binop(Ast *, Bytecode *, bool);
+static void emit_logical(Ast *, Bytecode *, bool);
+static void emit_branch(Ast *, Bytecode *, bool, Vector *);
 static void emit_member(Ast *, Bytecode *, bool);
 static void emit_dotexpr(Ast *, Bytecode *, bool);
 static void emit_unaop(Ast *, Bytecode *, bool);
 static void emit_if(Ast *, Bytecode *);
 static void emit_for(Ast *, Bytecode *);
 static void emit_while(Ast *, Bytecode *);
+static void emit_match(Ast *, Bytecode *);
 static void emit_return(Ast *, Bytecode *);
 static void emit_break(Ast *, Bytecode *);
 static void emit_block(Ast *, Bytecode *);
@@ -42,21 +49,28 @@ static void emit_fncall(Ast *, Bytecode *, bool);
 static void emit_vardecl(Ast *, Bytecode *);
 static void emit_namespace(Ast *, Bytecode *);
 static void emit_assert(Ast *, Bytecode *);
+static void emit_region(Ast *, Bytecode *);
 static void emit_nonenode(Ast *, Bytecode *, bool);
 static void emit_load(Ast *, Bytecode *, bool);
 static void emit_builtins(Bytecode *);
 
 Vector *ltable;
 Vector *loop_stack;
+/* the whole program has been analyzed before code generation */
+static bool whole_program;
 
 static void compiler_init() {
     ltable = New_Vector();
     loop_stack = New_Vector();
+    whole_program = true;
+    ctfe_init();
 }
 
 static void compiler_init_repl(Vector *lpool) {
     ltable = lpool;
     loop_stack = New_Vector();
+    /* objects of earlier lines are not reachable from a sandbox frame */
+    whole_program = false;
 }
 
 Bytecode *compile(Vector *ast) {
@@ -117,6 +131,12 @@ static void gen(Ast *ast, Bytecode *iseq, bool use_ret) {
     case NDTYPE_SUBSCR:
         emit_listaccess(ast, iseq);
         break;
+    case NDTYPE_SLICE:
+        emit_slice(ast, iseq);
+        break;
+    case NDTYPE_FORMAT:
+        emit_format(ast, iseq, use_ret);
+        break;
     case NDTYPE_TUPLE:
         emit_tuple(ast, iseq);
         break;
@@ -145,6 +165,9 @@ static void gen(Ast *ast, Bytecode *iseq, bool use_ret) {
     case NDTYPE_WHILE:
         emit_while(ast, iseq);
         break;
+    case NDTYPE_MATCH:
+        emit_match(ast, iseq);
+        break;
     case NDTYPE_BLOCK:
         emit_block(ast, iseq);
         break;
@@ -180,6 +203,9 @@ static void gen(Ast *ast, Bytecode *iseq, bool use_ret) {
     case NDTYPE_ASSERT:
         emit_assert(ast, iseq);
         break;
+    case NDTYPE_REGION:
+        emit_region(ast, iseq);
+        break;
     case NDTYPE_NONENODE:
         emit_nonenode(ast, iseq, use_ret);
         break;
@@ -189,7 +215,7 @@ static void gen(Ast *ast, Bytecode *iseq, bool use_ret) {
 }
 
 static void emit_builtins(Bytecode *iseq) {
-    for(size_t i = 0; i < Global_Cbltins->len; ++i) {
+    for(int i = 0; i < Global_Cbltins->len; ++i) {
         NodeVariable *v =
             ((MxcCBltin *)Global_Cbltins->data[i])->var;
         emit_rawobject(((MxcCBltin *)Global_Cbltins->data[i])->impl,
@@ -206,7 +232,7 @@ static void emit_num(Ast *ast, Bytecode *iseq, bool use_ret) {
         int key = lpool_push_float(ltable, n->fnumber);
         push_fpush(iseq, key);
     }
-    else if(n->number > INT_MAX) {
+    else if(n->number > INT_MAX || n->number < INT_MIN) {
         int key = lpool_push_long(ltable, n->number);
         push_lpush(iseq, key);
     }
@@ -301,13 +327,43 @@ static void emit_struct_init(Ast *ast, Bytecode *iseq, bool use_ret) {
         push_0arg(iseq, OP_POP);
 }
 
+static bool bounds_proven(NodeSubscript *l) {
+    if(!whole_program || !l->inbounds) return false;
+    if(l->index->type != NDTYPE_VARIABLE) return false;
+
+    return !(((NodeVariable *)l->index)->vattr & VARATTR_MAYNEG);
+}
+
 static void emit_listaccess(Ast *ast, Bytecode *iseq) {
     NodeSubscript *l = (NodeSubscript *)ast;
 
     gen(l->index, iseq, true);
     gen(l->ls, iseq, true);
 
-    push_0arg(iseq, OP_SUBSCR);
+    if(bounds_proven(l))
+        push_0arg(iseq, OP_LIST_GET_NOCHECK);
+    else
+        push_0arg(iseq, OP_SUBSCR);
+}
+
+static void emit_slice(Ast *ast, Bytecode *iseq) {
+    NodeSlice *s = (NodeSlice *)ast;
+
+    gen(s->ls, iseq, true);
+    gen(s->begin, iseq, true);
+    gen(s->end, iseq, true);
+    push_0arg(iseq, OP_STRSLICE);
+}
+
+static void emit_format(Ast *ast, Bytecode *iseq, bool use_ret) {
+    NodeFormat *f = (NodeFormat *)ast;
+
+    for(int i = 0; i < f->pieces->len; ++i)
+        gen((Ast *)f->pieces->data[i], iseq, true);
+    push_format(iseq, f->pieces->len);
+
+    if(!use_ret)
+        push_0arg(iseq, OP_POP);
 }
 
 static void emit_tuple(Ast *ast, Bytecode *iseq) {
@@ -317,9 +373,100 @@ static void emit_tuple(Ast *ast, Bytecode *iseq) {
         gen((Ast *)t->exprs->data[i], iseq, true);
 }
 
+static bool is_logical(Ast *ast) {
+    if(ast->type != NDTYPE_BINARY) return false;
+
+    enum BINOP op = ((NodeBinop *)ast)->op;
+    return op == BIN_LAND || op == BIN_LOR;
+}
+
+static void patch_jumps(Vector *fixups, Bytecode *iseq, size_t dst) {
+    for(int i = 0; i < fixups->len; ++i) {
+        replace_int32((intptr_t)fixups->data[i], iseq, dst);
+    }
+}
+
+/*
+ *  Emit jumps to the positions collected in `fixups` that are taken
+ *  when `cond` evaluates to `jump_if`; otherwise control falls through.
+ *  `and`/`or`/`not` are lowered to control flow, so the right operand is
+ *  skipped as soon as the result is known and no bool is materialised.
+ */
+static void emit_branch(Ast *cond,
+                        Bytecode *iseq,
+                        bool jump_if,
+                        Vector *fixups) {
+    if(cond->type == NDTYPE_BOOL) {
+        if(((NodeBool *)cond)->boolean == jump_if) {
+            vec_push(fixups, (void *)(intptr_t)iseq->len);
+            push_jmp(iseq, 0);
+        }
+        return;
+    }
+
+    if(cond->type == NDTYPE_UNARY &&
+       ((NodeUnaop *)cond)->op == UNA_NOT) {
+        emit_branch(((NodeUnaop *)cond)->expr, iseq, !jump_if, fixups);
+        return;
+    }
+
+    if(is_logical(cond)) {
+        NodeBinop *b = (NodeBinop *)cond;
+        /* true for `or`, false for `and`: the value that decides early */
+        bool decisive = b->op == BIN_LOR;
+
+        if(jump_if == decisive) {
+            emit_branch(b->left, iseq, jump_if, fixups);
+            emit_branch(b->right, iseq, jump_if, fixups);
+        }
+        else {
+            Vector *skip = New_Vector();
+            emit_branch(b->left, iseq, decisive, skip);
+            emit_branch(b->right, iseq, jump_if, fixups);
+            patch_jumps(skip, iseq, iseq->len);
+            Delete_Vector(skip);
+        }
+        return;
+    }
+
+    gen(cond, iseq, true);
+
+    vec_push(fixups, (void *)(intptr_t)iseq->len);
+    if(jump_if)
+        push_jmpeq(iseq, 0);
+    else
+        push_jmpneq(iseq, 0);
+}
+
+static void emit_logical(Ast *ast, Bytecode *iseq, bool use_ret) {
+    Vector *fixups = New_Vector();
+    emit_branch(ast, iseq, false, fixups);
+
+    if(use_ret) {
+        push_0arg(iseq, OP_PUSHTRUE);
+        size_t jpos = iseq->len;
+        push_jmp(iseq, 0);
+
+        patch_jumps(fixups, iseq, iseq->len);
+        push_0arg(iseq, OP_PUSHFALSE);
+
+        replace_int32(jpos, iseq, iseq->len);
+    }
+    else {
+        patch_jumps(fixups, iseq, iseq->len);
+    }
+
+    Delete_Vector(fixups);
+}
+
 static void emit_binop(Ast *ast, Bytecode *iseq, bool use_ret) {
     NodeBinop *b = (NodeBinop *)ast;
 
+    if(is_logical(ast)) {
+        emit_logical(ast, iseq, use_ret);
+        return;
+    }
+
     gen(b->left, iseq, true);
     gen(b->right, iseq, true);
 
@@ -332,8 +479,6 @@ static void emit_binop(Ast *ast, Bytecode *iseq, bool use_ret) {
         case BIN_MOD: push_0arg(iseq, OP_MOD); break;
         case BIN_EQ: push_0arg(iseq, OP_EQ); break;
         case BIN_NEQ: push_0arg(iseq, OP_NOTEQ); break;
-        case BIN_LOR: push_0arg(iseq, OP_LOGOR); break;
-        case BIN_LAND: push_0arg(iseq, OP_LOGAND); break;
         case BIN_LT: push_0arg(iseq, OP_LT); break;
         case BIN_LTE: push_0arg(iseq, OP_LTE); break;
         case BIN_GT: push_0arg(iseq, OP_GT); break;
@@ -363,18 +508,30 @@ static void emit_binop(Ast *ast, Bytecode *iseq, bool use_ret) {
     else if(type_is(b->left->ctype, CTYPE_STRING)){
         switch(b->op) {
         case BIN_ADD: push_0arg(iseq, OP_STRCAT); break;
+        case BIN_EQ: push_0arg(iseq, OP_STREQ); break;
+        case BIN_NEQ: push_0arg(iseq, OP_STRNOTEQ); break;
         default: break;
         }
     }
     else if(type_is(b->left->ctype, CTYPE_BOOL)) {
         switch(b->op) {
-        case BIN_LOR: push_0arg(iseq, OP_LOGOR); break;
-        case BIN_LAND: push_0arg(iseq, OP_LOGAND); break;
         case BIN_EQ: push_0arg(iseq, OP_EQ); break;
         case BIN_NEQ: push_0arg(iseq, OP_NOTEQ); break;
         default: break;
         }
     }
+    else if(type_is(b->left->ctype, CTYPE_CHAR)) {
+        /* code points compare as ints */
+        switch(b->op) {
+        case BIN_EQ: push_0arg(iseq, OP_EQ); break;
+        case BIN_NEQ: push_0arg(iseq, OP_NOTEQ); break;
+        case BIN_LT: push_0arg(iseq, OP_LT); break;
+        case BIN_LTE: push_0arg(iseq, OP_LTE); break;
+        case BIN_GT: push_0arg(iseq, OP_GT); break;
+        case BIN_GTE: push_0arg(iseq, OP_GTE); break;
+        default: break;
+        }
+    }
 
     if(!use_ret)
         push_0arg(iseq, OP_POP);
@@ -504,7 +661,10 @@ static void emit_listaccess_store(Ast *ast, Bytecode *iseq, bool use_ret) {
     gen(l->index, iseq, true);
     gen(l->ls, iseq, true);
 
-    push_0arg(iseq, OP_SUBSCR_STORE);
+    if(bounds_proven(l))
+        push_0arg(iseq, OP_LIST_SET_NOCHECK);
+    else
+        push_0arg(iseq, OP_SUBSCR_STORE);
 
     if(!use_ret)
         push_0arg(iseq, OP_POP);
@@ -521,7 +681,7 @@ static void emit_func_def(Ast *ast, Bytecode *iseq) {
 
     if(f->block->type == NDTYPE_BLOCK) {
         NodeBlock *b = (NodeBlock *)f->block;
-        for(size_t i = 0; i < b->cont->len; i++) {
+        for(int i = 0; i < b->cont->len; i++) {
             gen(b->cont->data[i],
                 fn_iseq,
                 false);
@@ -541,6 +701,10 @@ static void emit_func_def(Ast *ast, Bytecode *iseq) {
 
     int key = lpool_push_userfunc(ltable, fn_object);
 
+    if(whole_program && f->fnvar->isglobal) {
+        ctfe_register(f, fn_object);
+    }
+
     push_functionset(iseq, key);
 
     emit_store((Ast *)f->fnvar, iseq, false);
@@ -548,11 +712,9 @@ static void emit_func_def(Ast *ast, Bytecode *iseq) {
 
 static void emit_if(Ast *ast, Bytecode *iseq) {
     NodeIf *i = (NodeIf *)ast;
+    Vector *fixups = New_Vector();
 
-    gen(i->cond, iseq, true);
-
-    size_t cpos = iseq->len;
-    push_jmpneq(iseq, 0);
+    emit_branch(i->cond, iseq, false, fixups);
 
     gen(i->then_s, iseq, i->isexpr);
 
@@ -561,7 +723,7 @@ static void emit_if(Ast *ast, Bytecode *iseq) {
         push_jmp(iseq, 0); // goto if statement end
 
         size_t else_spos = iseq->len;
-        replace_int32(cpos, iseq, else_spos);
+        patch_jumps(fixups, iseq, else_spos);
 
         gen(i->else_s, iseq, i->isexpr);
 
@@ -570,8 +732,10 @@ static void emit_if(Ast *ast, Bytecode *iseq) {
     }
     else {
         size_t pos = iseq->len;
-        replace_int32(cpos, iseq, pos);
+        patch_jumps(fixups, iseq, pos);
     }
+
+    Delete_Vector(fixups);
 }
 
 static void emit_for(Ast *ast, Bytecode *iseq) {
@@ -601,16 +765,16 @@ static void emit_for(Ast *ast, Bytecode *iseq) {
 
 static void emit_while(Ast *ast, Bytecode *iseq) {
     NodeWhile *w = (NodeWhile *)ast;
+    Vector *exits = New_Vector();
     size_t begin = iseq->len;
-    gen(w->cond, iseq, true);
 
-    size_t pos = iseq->len;
-    push_jmpneq(iseq, 0);
+    emit_branch(w->cond, iseq, false, exits);
     gen(w->body, iseq, false);
     push_jmp(iseq, begin);
 
     size_t end = iseq->len;
-    replace_int32(pos, iseq, end);
+    patch_jumps(exits, iseq, end);
+    Delete_Vector(exits);
 
     if(loop_stack->len != 0) {
         int breakp = (intptr_t)vec_pop(loop_stack);
@@ -618,6 +782,184 @@ static void emit_while(Ast *ast, Bytecode *iseq) {
     }
 }
 
+/*
+ *  match dispatches through a table that follows the opcode:
+ *
+ *    JUMP_TABLE    min n default target*n          dense int/char
+ *    JUMP_BSEARCH  n default (key:i64 target)*n    sparse int/char, sorted
+ *    JUMP_HASH     mask default (lit target)*(mask+1)
+ *                                                  string, open addressing
+ */
+
+typedef struct MatchCase {
+    int64_t key;
+    char *str;
+    int arm;
+} MatchCase;
+
+typedef struct MatchSlot {
+    size_t pos;
+    int arm;    /* -1: default */
+} MatchSlot;
+
+static int case_cmp(const void *a, const void *b) {
+    int64_t x = ((MatchCase *)a)->key;
+    int64_t y = ((MatchCase *)b)->key;
+
+    return (x > y) - (x < y);
+}
+
+static bool is_dense(MatchCase *cases, int ncase) {
+    int64_t min = cases[0].key;
+    int64_t max = cases[ncase - 1].key;
+
+    if(min < INT32_MIN || max > INT32_MAX) return false;
+
+    int64_t range = max - min + 1;
+
+    return range <= 1024 && range <= (int64_t)ncase * 2 + 4;
+}
+
+static void patch_slot(Bytecode *iseq, size_t pos, int32_t dst) {
+    replace_int32(pos - 1, iseq, dst);
+}
+
+static void emit_match(Ast *ast, Bytecode *iseq) {
+    NodeMatch *m = (NodeMatch *)ast;
+    bool isstr = type_is(m->target->ctype, CTYPE_STRING);
+    int ncase = 0;
+
+    for(int i = 0; i < m->pats->len; ++i) {
+        ncase += ((Vector *)m->pats->data[i])->len;
+    }
+
+    MatchCase *cases = malloc(sizeof(MatchCase) * (ncase + 1));
+    int n = 0;
+    for(int i = 0; i < m->pats->len; ++i) {
+        Vector *arm = (Vector *)m->pats->data[i];
+
+        for(int j = 0; j < arm->len; ++j) {
+            Ast *p = arm->data[j];
+            cases[n].arm = i;
+            cases[n].str = NULL;
+            cases[n].key = 0;
+
+            if(isstr)
+                cases[n].str = ((NodeString *)p)->string;
+            else
+                pattern_int(p, &cases[n].key);
+            ++n;
+        }
+    }
+
+    gen(m->target, iseq, true);
+
+    MatchSlot *slots;
+    int nslot;
+    size_t default_pos;
+
+    if(isstr) {
+        int cap = 1;
+        while(cap < ncase * 2) cap <<= 1;
+
+        int *lit = malloc(sizeof(int) * cap);
+        int *arm = malloc(sizeof(int) * cap);
+        for(int i = 0; i < cap; ++i) lit[i] = -1;
+
+        for(int i = 0; i < ncase; ++i) {
+            uint32_t h = str_hash(cases[i].str) & (cap - 1);
+            while(lit[h] != -1) h = (h + 1) & (cap - 1);
+
+            lit[h] = lpool_push_str(ltable, cases[i].str);
+            arm[h] = cases[i].arm;
+        }
+
+        push_0arg(iseq, OP_JUMP_HASH);
+        push_int32(iseq, cap - 1);
+        default_pos = iseq->len;
+        push_int32(iseq, 0);
+
+        nslot = 0;
+        slots = malloc(sizeof(MatchSlot) * cap);
+        for(int i = 0; i < cap; ++i) {
+            push_int32(iseq, lit[i]);
+            if(lit[i] != -1) {
+                slots[nslot++] = (MatchSlot){iseq->len, arm[i]};
+            }
+            push_int32(iseq, 0);
+        }
+
+        free(lit);
+        free(arm);
+    }
+    else {
+        qsort(cases, ncase, sizeof(MatchCase), case_cmp);
+
+        if(ncase != 0 && is_dense(cases, ncase)) {
+            int64_t min = cases[0].key;
+            int range = (int)(cases[ncase - 1].key - min + 1);
+
+            push_0arg(iseq, OP_JUMP_TABLE);
+            push_int32(iseq, (int32_t)min);
+            push_int32(iseq, range);
+            default_pos = iseq->len;
+            push_int32(iseq, 0);
+
+            nslot = range;
+            slots = malloc(sizeof(MatchSlot) * range);
+            for(int i = 0; i < range; ++i) {
+                slots[i] = (MatchSlot){iseq->len, -1};
+                push_int32(iseq, 0);
+            }
+            for(int i = 0; i < ncase; ++i) {
+                slots[cases[i].key - min].arm = cases[i].arm;
+            }
+        }
+        else {
+            push_0arg(iseq, OP_JUMP_BSEARCH);
+            push_int32(iseq, ncase);
+            default_pos = iseq->len;
+            push_int32(iseq, 0);
+
+            nslot = ncase;
+            slots = malloc(sizeof(MatchSlot) * (ncase + 1));
+            for(int i = 0; i < ncase; ++i) {
+                push_int64(iseq, cases[i].key);
+                slots[i] = (MatchSlot){iseq->len, cases[i].arm};
+                push_int32(iseq, 0);
+            }
+        }
+    }
+
+    size_t *arm_pos = malloc(sizeof(size_t) * (m->bodies->len + 1));
+    Vector *exits = New_Vector();
+
+    for(int i = 0; i < m->bodies->len; ++i) {
+        arm_pos[i] = iseq->len;
+        gen(m->bodies->data[i], iseq, false);
+
+        vec_push(exits, (void *)(intptr_t)iseq->len);
+        push_jmp(iseq, 0);
+    }
+
+    size_t otherwise = iseq->len;
+    gen(m->otherwise, iseq, false);
+
+    size_t end = iseq->len;
+    patch_jumps(exits, iseq, end);
+
+    patch_slot(iseq, default_pos, otherwise);
+    for(int i = 0; i < nslot; ++i) {
+        int a = slots[i].arm;
+        patch_slot(iseq, slots[i].pos, a < 0 ? otherwise : arm_pos[a]);
+    }
+
+    Delete_Vector(exits);
+    free(arm_pos);
+    free(slots);
+    free(cases);
+}
+
 static void emit_return(Ast *ast, Bytecode *iseq) {
     gen(((NodeReturn *)ast)->cont, iseq, true);
     push_0arg(iseq, OP_RET);
@@ -633,6 +975,14 @@ static void emit_break(Ast *ast, Bytecode *iseq) {
 static void emit_fncall(Ast *ast, Bytecode *iseq, bool use_ret) {
     NodeFnCall *f = (NodeFnCall *)ast;
 
+    if(whole_program) {
+        Ast *folded = ctfe_fold_call(f);
+        if(folded) {
+            gen(folded, iseq, use_ret);
+            return;
+        }
+    }
+
     for(int i = f->args->len - 1; i >= 0; --i)
         gen((Ast *)f->args->data[i], iseq, true);
     gen(f->func, iseq, true);
@@ -693,6 +1043,13 @@ static void emit_vardecl(Ast *ast, Bytecode *iseq) {
 
 static void emit_namespace(Ast *ast, Bytecode *iseq) {
     NodeNameSpace *n = (NodeNameSpace *)ast;
+    MxcModule *mod = search_cmodule(n->name);
+
+    for(int i = 0; mod && i < mod->cbltins->len; ++i) {
+        MxcCBltin *b = (MxcCBltin *)mod->cbltins->data[i];
+        emit_rawobject(b->impl, iseq, true);
+        emit_store((Ast *)b->var, iseq, false);
+    }
     gen((Ast *)n->block, iseq, false);
 }
 
@@ -710,6 +1067,28 @@ static void emit_assert(Ast *ast, Bytecode *iseq) {
     push_0arg(iseq, OP_ASSERT);
 }
 
+/*
+ *  REGION_EXIT  global:i8 n vid*n
+ *
+ *  names the variables declared inside the block, which still refer to
+ *  region objects when it exits.
+ */
+static void emit_region(Ast *ast, Bytecode *iseq) {
+    NodeRegion *r = (NodeRegion *)ast;
+    bool global = r->vars->len > 0 &&
+                  ((NodeVariable *)r->vars->data[0])->isglobal;
+
+    push_0arg(iseq, OP_REGION_ENTER);
+    gen(r->block, iseq, false);
+
+    push_0arg(iseq, OP_REGION_EXIT);
+    push_int8(iseq, global);
+    push_int32(iseq, r->vars->len);
+    for(int i = 0; i < r->vars->len; ++i) {
+        push_int32(iseq, ((NodeVariable *)r->vars->data[i])->vid);
+    }
+}
+
 static void emit_nonenode(Ast *ast, Bytecode *iseq, bool use_ret) {
     INTERN_UNUSE(ast);
     push_0arg(iseq, OP_PUSHNULL);
@@ -0,0 +1,276 @@
+/* compile-time evaluation of pure function calls */
+#include <stdlib.h>
+#include <string.h>
+
+#include "ctfe.h"
+#include "bytecode.h"
+#include "frame.h"
+#include "gc.h"
+#include "module.h"
+#include "vm.h"
+#include "object/object.h"
+#include "object/charobject.h"
+#include "object/funcobject.h"
+#include "object/strobject.h"
+
+/* upper bound of jumps and calls executed for one folded call */
+#define CTFE_FUEL 5000000
+/* longer string results are left to run time, not put in the literal table */
+#define CTFE_MAX_STRLEN 4096
+
+typedef struct CtfeEntry {
+    NodeFunction *def;
+    userfunction *func;
+    /* ran out of fuel once; do not pay for it again */
+    bool exhausted;
+} CtfeEntry;
+
+static Vector *entries;
+
+void ctfe_init() {
+    entries = New_Vector();
+}
+
+void ctfe_register(NodeFunction *def, userfunction *func) {
+    CtfeEntry *e = malloc(sizeof(CtfeEntry));
+    e->def = def;
+    e->func = func;
+    e->exhausted = false;
+
+    vec_push(entries, e);
+}
+
+static CtfeEntry *search_entry(NodeVariable *v) {
+    for(int i = 0; i < entries->len; ++i) {
+        CtfeEntry *e = (CtfeEntry *)entries->data[i];
+        if(e->def->fnvar == v) return e;
+    }
+
+    return NULL;
+}
+
+static bool is_foldable_type(Type *t) {
+    return type_is(t, CTYPE_INT) ||
+           type_is(t, CTYPE_DOUBLE) ||
+           type_is(t, CTYPE_BOOL) ||
+           type_is(t, CTYPE_CHAR) ||
+           type_is(t, CTYPE_STRING);
+}
+
+/*
+ *  Every global function reachable from `v` must already be compiled,
+ *  otherwise the sandbox would call an uninitialized variable.
+ */
+static bool callees_ready(NodeVariable *v, Vector *visited) {
+    if(!(v->vattr & VARATTR_PURE)) return false;
+    if(!v->isglobal) return true;   /* nested definition, set up at runtime */
+
+    for(int i = 0; i < visited->len; ++i) {
+        if(visited->data[i] == v) return true;
+    }
+    vec_push(visited, v);
+
+    CtfeEntry *e = search_entry(v);
+    if(!e) return false;
+
+    for(int i = 0; i < e->def->callees->len; ++i) {
+        if(!callees_ready(e->def->callees->data[i], visited))
+            return false;
+    }
+
+    return true;
+}
+
+static Ast *constant_arg(Ast *a) {
+    switch(a->type) {
+    case NDTYPE_NUM:
+    case NDTYPE_BOOL:
+    case NDTYPE_CHAR:
+    case NDTYPE_STRING:
+        return a;
+    case NDTYPE_UNARY: {
+        NodeUnaop *u = (NodeUnaop *)a;
+        if(u->op != UNA_MINUS || u->expr->type != NDTYPE_NUM)
+            return NULL;
+
+        NodeNumber *n = (NodeNumber *)u->expr;
+        if(n->isfloat)
+            return (Ast *)new_node_number_float(-n->fnumber);
+        else
+            return (Ast *)new_node_number_int(-n->number);
+    }
+    case NDTYPE_FUNCCALL:
+        return ctfe_fold_call((NodeFnCall *)a);
+    case NDTYPE_DOTEXPR: {
+        NodeDotExpr *d = (NodeDotExpr *)a;
+        if(!d->t.fncall) return NULL;
+        return ctfe_fold_call(d->call);
+    }
+    default:
+        return NULL;
+    }
+}
+
+static MxcValue lit2val(Ast *a) {
+    switch(a->type) {
+    case NDTYPE_NUM: {
+        NodeNumber *n = (NodeNumber *)a;
+        return n->isfloat ? mval_float(n->fnumber) : mval_int(n->number);
+    }
+    case NDTYPE_BOOL:
+        return ((NodeBool *)a)->boolean ? mval_true : mval_false;
+    case NDTYPE_CHAR:
+        return mval_char(((NodeChar *)a)->ch);
+    case NDTYPE_STRING: {
+        char *s = ((NodeString *)a)->string;
+        return new_string_interned(str_intern(s, strlen(s)));
+    }
+    default:
+        return mval_invalid;
+    }
+}
+
+static Ast *val2lit(MxcValue v, Type *ty) {
+    Ast *lit;
+
+    if(type_is(ty, CTYPE_INT) && v.t == VAL_INT) {
+        lit = (Ast *)new_node_number_int(v.num);
+    }
+    else if(type_is(ty, CTYPE_DOUBLE) && v.t == VAL_FLO) {
+        lit = (Ast *)new_node_number_float(v.fnum);
+    }
+    else if(type_is(ty, CTYPE_BOOL) &&
+            (v.t == VAL_TRUE || v.t == VAL_FALSE)) {
+        lit = (Ast *)new_node_bool(v.t == VAL_TRUE);
+    }
+    else if(type_is(ty, CTYPE_CHAR) && v.t == VAL_CHAR) {
+        lit = (Ast *)new_node_char((int32_t)v.num);
+    }
+    else if(type_is(ty, CTYPE_STRING) && isobj(v) &&
+            ITERABLE(ostr(v))->length <= CTFE_MAX_STRLEN) {
+        MxcString *s = ostr(v);
+        size_t len = ITERABLE(s)->length;
+        char *buf = malloc(len + 1);
+        memcpy(buf, STR_PTR(s), len);
+        buf[len] = '\0';
+        lit = (Ast *)new_node_string(buf);
+    }
+    else {
+        return NULL;
+    }
+
+    CTYPE(lit) = ty;
+    return lit;
+}
+
+static int sandbox_ngvars() {
+    size_t n = 0;
+
+    for(int i = 0; i < Global_Cbltins->len; ++i) {
+        NodeVariable *v = ((MxcCBltin *)Global_Cbltins->data[i])->var;
+        if(v->vid + 1 > n) n = v->vid + 1;
+    }
+    for(int i = 0; i < entries->len; ++i) {
+        NodeVariable *v = ((CtfeEntry *)entries->data[i])->def->fnvar;
+        if(v->vid + 1 > n) n = v->vid + 1;
+    }
+
+    return (int)n;
+}
+
+static bool run_sandbox(MxcValue callee,
+                        Vector *args,
+                        MxcValue *result,
+                        bool *exhausted) {
+    Bytecode *code = New_Bytecode();
+    push_call(code, args->len);
+    push_0arg(code, OP_END);
+
+    Frame *frame = new_global_frame(code, sandbox_ngvars());
+
+    for(int i = 0; i < Global_Cbltins->len; ++i) {
+        MxcCBltin *b = (MxcCBltin *)Global_Cbltins->data[i];
+        frame->gvars[b->var->vid] = b->impl;
+    }
+    for(int i = 0; i < entries->len; ++i) {
+        CtfeEntry *e = (CtfeEntry *)entries->data[i];
+        frame->gvars[e->def->fnvar->vid] = new_function(e->func);
+    }
+    gc_globals_dirty = 1;
+
+    for(int i = args->len - 1; i >= 0; --i) {
+        Push(lit2val((Ast *)args->data[i]));
+    }
+    Push(callee);
+
+    Frame *saved = cur_frame;
+    vm_fuel = CTFE_FUEL;
+    int err = vm_exec(frame);
+    *exhausted = vm_fuel == 0;
+    vm_fuel = -1;
+    cur_frame = saved;
+
+    if(!err) {
+        *result = Top();
+    }
+
+    free(frame->stackbase);
+    free(frame->gvars);
+    free(frame);
+    free(code->code);
+    free(code);
+
+    return err == 0;
+}
+
+Ast *ctfe_fold_call(NodeFnCall *call) {
+    if(call->failure_block) return NULL;
+    if(call->func->type != NDTYPE_VARIABLE) return NULL;
+    if(!is_foldable_type(CTYPE(call))) return NULL;
+
+    NodeVariable *fn = (NodeVariable *)call->func;
+    CtfeEntry *entry = NULL;
+    MxcValue callee;
+
+    if(fn->isbuiltin) {
+        if(!(fn->vattr & VARATTR_PURE)) return NULL;
+
+        callee = mval_invalid;
+        for(int i = 0; i < Global_Cbltins->len; ++i) {
+            MxcCBltin *b = (MxcCBltin *)Global_Cbltins->data[i];
+            if(b->var == fn) callee = b->impl;
+        }
+        if(Invalid_val(callee)) return NULL;
+    }
+    else {
+        if(!fn->isglobal) return NULL;
+
+        Vector *visited = New_Vector();
+        bool ready = callees_ready(fn, visited);
+        Delete_Vector(visited);
+        if(!ready) return NULL;
+
+        entry = search_entry(fn);
+        if(entry->exhausted) return NULL;
+        callee = new_function(entry->func);
+    }
+
+    Vector *args = New_Vector();
+    for(int i = 0; i < call->args->len; ++i) {
+        Ast *a = constant_arg((Ast *)call->args->data[i]);
+        if(!a) return NULL;
+
+        vec_push(args, a);
+    }
+
+    MxcValue result;
+    bool exhausted;
+    if(!run_sandbox(callee, args, &result, &exhausted)) {
+        if(entry && exhausted) {
+            entry->exhausted = true;
+        }
+        return NULL;
+    }
+
+    return val2lit(result, CTYPE(call));
+}
@@ -9,6 +9,7 @@
 #include "maxc.h"
 #include "util.h"
 #include "token.h"
+#include "object/strobject.h"
 
 #define STEP()                                                                 \
     do {                                                                       \
@@ -24,6 +25,7 @@
 #define TWOCHARS(c1, c2) (src[i] == c1 && src[i + 1] == c2)
 
 static void scan(Vector *, const char *, const char *);
+static SrcPos scan_src(Vector *, const char *, const char *, int, int);
 
 Vector *lexer_run(const char *src, const char *fname) {
     Vector *tokens = New_Vector();
@@ -60,9 +62,66 @@ static char scan_char(const char *src, size_t *idx, int *col) {
     }
 }
 
+/*
+ *  The '}' closing an interpolation whose expression starts at src[i],
+ *  or 0. Quoted strings and chars inside it are skipped.
+ */
+static size_t interp_end(const char *src, size_t i) {
+    int depth = 0;
+
+    for(; src[i] && src[i] != '\n'; ++i) {
+        if(src[i] == '\"' || src[i] == '\'') {
+            char q = src[i];
+            for(++i; src[i] != q; ++i) {
+                if(!src[i] || src[i] == '\n') return 0;
+                if(src[i] == '\\' && src[i + 1]) ++i;
+            }
+        }
+        else if(src[i] == '{') {
+            depth++;
+        }
+        else if(src[i] == '}' && depth-- == 0) {
+            return i;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ *  "a{x}b" becomes FString, "a", {, x, }, "b", FStringEnd. "{{" and
+ *  "}}" stand for braces, and "{}" is kept as it is for format().
+ */
+static size_t scan_interp(Vector *tk, const char *src, size_t i,
+                          const char *fname, int line, int col) {
+    size_t end = interp_end(src, i + 1);
+    if(!end) {
+        error("missing character:`}`");
+        exit(1);
+    }
+
+    size_t len = end - i - 1;
+    char *expr = xmalloc(len + 1);
+    memcpy(expr, src + i + 1, len);
+    expr[len] = '\0';
+
+    SrcPos s = New_SrcPos(fname, line, col);
+    SrcPos e = New_SrcPos(fname, line, col + len + 1);
+    token_push_symbol(tk, TKIND_Lbrace, 1, s, s);
+    scan_src(tk, expr, fname, line, col + 1);
+    token_push_symbol(tk, TKIND_Rbrace, 1, e, e);
+
+    return end;
+}
+
 static void scan(Vector *tk, const char *src, const char *fname) {
-    int line = 1;
-    int col = 1;
+    SrcPos eof = scan_src(tk, src, fname, 1, 1);
+    token_push_end(tk, eof, eof);
+}
+
+/* returns the position after the end */
+static SrcPos scan_src(Vector *tk, const char *src, const char *fname,
+                       int line, int col) {
     size_t src_len = strlen(src);
 
     for(size_t i = 0; i < src_len; ++i, ++col) {
@@ -72,6 +131,10 @@ static void scan(Vector *tk, const char *src, const char *fname) {
             bool isdot = false;
 
             for(; isdigit(src[i]) || src[i] == '.'; ++i, ++col) {
+                /* s[1..3] */
+                if(src[i] == '.' && src[i + 1] == '.') {
+                    break;
+                }
                 string_push(value_num, src[i]);
 
                 if(src[i] == '.') {
@@ -151,17 +214,39 @@ static void scan(Vector *tk, const char *src, const char *fname) {
         else if(src[i] == '\"') {
             SrcPos s = New_SrcPos(fname, line, col);
             String *cont = New_String();
+            bool interp = false;
             STEP();
             for(; src[i] != '\"'; ++i, ++col) {
-                if(src[i] == '\n') {
+                if(src[i] == '\n' || src[i] == '\0') {
                     error("missing character:`\"`");
                     exit(1);
                 }
-                string_push(cont, scan_char(src, &i, &col));
+                if(TWOCHARS('{', '{') || TWOCHARS('}', '}')) {
+                    STEP();
+                    string_push(cont, src[i]);
+                }
+                else if(src[i] == '{' && src[i + 1] != '}') {
+                    if(!interp) {
+                        token_push_symbol(tk, TKIND_FString, 1, s, s);
+                        interp = true;
+                    }
+                    token_push_string(tk, cont, s, s);
+                    cont = New_String();
+
+                    size_t end = scan_interp(tk, src, i, fname, line, col);
+                    col += end - i;
+                    i = end;
+                }
+                else {
+                    string_push(cont, scan_char(src, &i, &col));
+                }
             }
             SrcPos e = New_SrcPos(fname, line, col);
 
             token_push_string(tk, cont, s, e);
+            if(interp) {
+                token_push_symbol(tk, TKIND_FStringEnd, 1, e, e);
+            }
         }
         else if(src[i] == '\'') {
             SrcPos s = New_SrcPos(fname, line, col);
@@ -170,7 +255,19 @@ static void scan(Vector *tk, const char *src, const char *fname) {
                 error("missing character:`\'`");
                 exit(1);
             }
-            char res = scan_char(src, &i, &col);
+            int32_t res;
+            if((unsigned char)src[i] >= 0x80) {
+                size_t n = utf8_seqlen(src[i]);
+                if(utf8_scan(src + i, n, NULL) != STR_ENC_UTF8) {
+                    error("invalid UTF-8 character");
+                    exit(1);
+                }
+                res = utf8_decode(src + i);
+                i += n - 1;
+            }
+            else {
+                res = scan_char(src, &i, &col);
+            }
             STEP();
             if(src[i] != '\'') {
                 error("too long character");
@@ -212,6 +309,5 @@ static void scan(Vector *tk, const char *src, const char *fname) {
         }
     }
 
-    SrcPos eof = New_SrcPos(fname, ++line, col);
-    token_push_end(tk, eof, eof);
+    return New_SrcPos(fname, line + 1, col);
 }
@@ -27,7 +27,7 @@ Varlist *Search_Namespace(char *name) {
         return NULL;
     }
 
-    for(size_t i = 0; i < namespace_table->len; ++i) {
+    for(int i = 0; i < namespace_table->len; ++i) {
         Namespace *cur = (Namespace *)namespace_table->data[i];
         if(strcmp(cur->name, name) == 0) {
             return cur->vars;
@@ -53,9 +53,22 @@ MxcOperator opdefs_float[] = {
     {-1, -1, NULL, NULL, NULL, NULL}
 };
 
+MxcOperator opdefs_char[] = {
+    /* kind */  /* ope */   /* ope2 */  /* ret */   /* fn *//* opname */
+    {OPE_BINARY, BIN_EQ,    mxcty_char, mxcty_bool, NULL,   "=="},
+    {OPE_BINARY, BIN_NEQ,   mxcty_char, mxcty_bool, NULL,   "!="},
+    {OPE_BINARY, BIN_LT,    mxcty_char, mxcty_bool, NULL,   "<"},
+    {OPE_BINARY, BIN_LTE,   mxcty_char, mxcty_bool, NULL,   "<="},
+    {OPE_BINARY, BIN_GT,    mxcty_char, mxcty_bool, NULL,   ">"},
+    {OPE_BINARY, BIN_GTE,   mxcty_char, mxcty_bool, NULL,   ">="},
+    {-1, -1, NULL, NULL, NULL, NULL}
+};
+
 MxcOperator opdefs_string[] = {
     /* kind */  /* ope */   /* ope2 */    /* ret */    /* fn */ /* opname */
     {OPE_BINARY, BIN_ADD,   mxcty_string, mxcty_string, NULL,   "+"},
+    {OPE_BINARY, BIN_EQ,    mxcty_string, mxcty_bool,   NULL,   "=="},
+    {OPE_BINARY, BIN_NEQ,   mxcty_string, mxcty_bool,   NULL,   "!="},
     {-1, -1, NULL, NULL, NULL, NULL}
 };
 
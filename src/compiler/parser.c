@@ -7,6 +7,7 @@
 #include "ast.h"
 #include "error/error.h"
 #include "lexer.h"
+#include "module.h"
 
 static Vector *parser_main(void);
 static Ast *statement(void);
@@ -16,6 +17,7 @@ static Ast *make_block(void);
 static Ast *make_if(bool);
 static Ast *make_for(void);
 static Ast *make_while(void);
+static Ast *make_match(void);
 static Ast *make_return(void);
 static Ast *make_break(void);
 static Ast *make_skip(void);
@@ -23,6 +25,7 @@ static Ast *make_object(void);
 static Ast *make_import(void);
 static Ast *make_breakpoint(void);
 static Ast *make_assert(void);
+static Ast *make_region(void);
 static void make_typedef(void);
 static Ast *expr_assign(void);
 static Ast *expr_equality(void);
@@ -177,6 +180,9 @@ static Ast *statement() {
     else if(skip(TKIND_If)) {
         return make_if(false);
     }
+    else if(skip(TKIND_Match)) {
+        return make_match();
+    }
     else if(skip(TKIND_Return)) {
         return make_return();
     }
@@ -207,6 +213,9 @@ static Ast *statement() {
     else if(skip(TKIND_Assert)) {
         return make_assert();
     }
+    else if(skip(TKIND_Region)) {
+        return make_region();
+    }
     else if(skip(TKIND_Typedef)) {
         make_typedef();
         return NULL;
@@ -463,7 +472,7 @@ static Ast *make_object() {
     return (Ast *)new_node_object(tag, decls);
 }
 
-static int make_ast_from_mod(Vector *s, char *name) {
+static int make_ast_from_mod(Vector *s, char *name, bool required) {
     char path[512];
     sprintf(path, "./lib/%s.mxc", name);
     char *src = read_file(path);
@@ -473,6 +482,7 @@ static int make_ast_from_mod(Vector *s, char *name) {
 
         src = read_file(path);
         if(!src) {
+            if(!required) return 0;
             error_at(see(-1)->start, see(-1)->end, "lib %s: not found", name);
             return 1;
         }
@@ -492,7 +502,7 @@ static Ast *make_import() {
     Vector *statements = New_Vector();
     char *mod = Get_Step_Token()->value;
 
-    if(make_ast_from_mod(statements, mod)) {
+    if(make_ast_from_mod(statements, mod, !search_cmodule(mod))) {
         return NULL;
     }
 
@@ -517,6 +527,12 @@ static Ast *make_assert() {
     return (Ast *)ass;
 }
 
+static Ast *make_region() {
+    Ast *block = make_block();
+
+    return (Ast *)new_node_region(block);
+}
+
 static Type *eval_type() {
     Type *ty;
 
@@ -689,6 +705,54 @@ static Ast *make_while() {
     return (Ast *)new_node_while(cond, body);
 }
 
+static Ast *make_match() {
+    /*
+     *  match x {
+     *      1, 2 => { ... }
+     *      _ => { ... }
+     *  }
+     */
+    Ast *target = expr();
+    Vector *pats = New_Vector();
+    Vector *bodies = New_Vector();
+    Ast *otherwise = NULL;
+
+    expect(TKIND_Lbrace);
+
+    while(!skip(TKIND_Rbrace)) {
+        if(Cur_Token_Is(TKIND_End)) {
+            expect(TKIND_Rbrace);
+            return NULL;
+        }
+
+        if(Cur_Token_Is(TKIND_Identifer) &&
+           strcmp(Cur_Token()->value, "_") == 0) {
+            if(otherwise) {
+                error_at(see(0)->start, see(0)->end,
+                         "duplicate `_` arm in match");
+            }
+            Step();
+            expect(TKIND_FatArrow);
+            otherwise = make_block();
+            continue;
+        }
+
+        Vector *arm = New_Vector();
+        do {
+            Ast *p = expr_unary();
+            if(!p) return NULL;
+            vec_push(arm, p);
+        } while(skip(TKIND_Comma));
+
+        expect(TKIND_FatArrow);
+
+        vec_push(pats, arm);
+        vec_push(bodies, make_block());
+    }
+
+    return (Ast *)new_node_match(target, pats, bodies, otherwise);
+}
+
 static Ast *make_return() {
     Ast *e = expr();
     NodeReturn *ret = new_node_return(e);
@@ -738,6 +802,31 @@ static Ast *expr_num(Token *tk) {
 
 static Ast *expr_string(Token *tk) { return (Ast *)new_node_string(tk->value); }
 
+static Ast *expr_interpolation() {
+    Vector *pieces = New_Vector();
+
+    while(!skip(TKIND_FStringEnd) && !Cur_Token_Is(TKIND_End)) {
+        if(Cur_Token_Is(TKIND_String)) {
+            Token *t = Get_Step_Token();
+            if(*t->value) {
+                vec_push(pieces, expr_string(t));
+            }
+            continue;
+        }
+
+        if(!expect(TKIND_Lbrace)) {
+            skip_to(TKIND_FStringEnd);
+            continue;
+        }
+        vec_push(pieces, expr());
+        if(!expect(TKIND_Rbrace)) {
+            skip_to(TKIND_FStringEnd);
+        }
+    }
+
+    return (Ast *)new_node_format(pieces);
+}
+
 static Ast *expr_var() {
     char *name = eat_identifer();
     if(!name) return NULL;
@@ -979,6 +1068,14 @@ static Ast *expr_unary_postfix() {
         else if(Cur_Token_Is(TKIND_Lboxbracket)) {
             Step();
             Ast *index = expr();
+
+            if(skip(TKIND_DotDot)) {
+                Ast *end = expr();
+                expect(TKIND_Rboxbracket);
+
+                left = (Ast *)new_node_slice(left, index, end);
+                continue;
+            }
             expect(TKIND_Rboxbracket);
 
             left = (Ast *)new_node_subscript(left, index);
@@ -1053,6 +1150,9 @@ static Ast *expr_primary() {
     else if(Cur_Token_Is(TKIND_String)) {
         return expr_string(Get_Step_Token());
     }
+    else if(skip(TKIND_FString)) {
+        return expr_interpolation();
+    }
     else if(Cur_Token_Is(TKIND_Char)) {
         return expr_char();
     }
@@ -0,0 +1,278 @@
+/* whole-program removal of unused definitions from imported modules */
+#include <stdlib.h>
+
+#include "prune.h"
+#include "ast.h"
+
+typedef struct Def {
+    NodeVariable *var;
+    Ast *node;
+    bool live;
+} Def;
+
+static Vector *defs;
+
+static void walk(Ast *);
+
+static void walk_vec(Vector *v) {
+    if(!v) return;
+
+    for(int i = 0; i < v->len; ++i) {
+        walk(v->data[i]);
+    }
+}
+
+static void reach(NodeVariable *v) {
+    /* a function loaded as a value may resolve to any overload */
+    for(; v; v = v->next) {
+        for(int i = 0; i < defs->len; ++i) {
+            Def *d = (Def *)defs->data[i];
+
+            if(d->var == v && !d->live) {
+                d->live = true;
+                walk(d->node);
+            }
+        }
+    }
+}
+
+static void walk(Ast *ast) {
+    if(!ast) return;
+
+    switch(ast->type) {
+    case NDTYPE_VARIABLE:
+        reach((NodeVariable *)ast);
+        break;
+    case NDTYPE_LIST: {
+        NodeList *l = (NodeList *)ast;
+        walk_vec(l->elem);
+        walk(l->nelem);
+        walk(l->init);
+        break;
+    }
+    case NDTYPE_TUPLE:
+        walk_vec(((NodeTuple *)ast)->exprs);
+        break;
+    case NDTYPE_STRUCTINIT:
+        walk_vec(((NodeStructInit *)ast)->inits);
+        break;
+    case NDTYPE_SUBSCR:
+        walk(((NodeSubscript *)ast)->ls);
+        walk(((NodeSubscript *)ast)->index);
+        break;
+    case NDTYPE_FORMAT:
+        walk_vec(((NodeFormat *)ast)->pieces);
+        break;
+    case NDTYPE_SLICE:
+        walk(((NodeSlice *)ast)->ls);
+        walk(((NodeSlice *)ast)->begin);
+        walk(((NodeSlice *)ast)->end);
+        break;
+    case NDTYPE_BINARY:
+        walk(((NodeBinop *)ast)->left);
+        walk(((NodeBinop *)ast)->right);
+        walk((Ast *)((NodeBinop *)ast)->impl);
+        break;
+    case NDTYPE_MEMBER:
+        walk(((NodeMember *)ast)->left);
+        break;
+    case NDTYPE_DOTEXPR: {
+        NodeDotExpr *d = (NodeDotExpr *)ast;
+        if(d->t.member)
+            walk((Ast *)d->memb);
+        else if(d->t.fncall)
+            walk((Ast *)d->call);
+        break;
+    }
+    case NDTYPE_UNARY:
+        walk(((NodeUnaop *)ast)->expr);
+        break;
+    case NDTYPE_ASSIGNMENT:
+        walk(((NodeAssignment *)ast)->dst);
+        walk(((NodeAssignment *)ast)->src);
+        break;
+    case NDTYPE_IF:
+    case NDTYPE_EXPRIF: {
+        NodeIf *i = (NodeIf *)ast;
+        walk(i->cond);
+        walk(i->then_s);
+        walk(i->else_s);
+        break;
+    }
+    case NDTYPE_FOR:
+        walk(((NodeFor *)ast)->iter);
+        walk(((NodeFor *)ast)->body);
+        break;
+    case NDTYPE_WHILE:
+        walk(((NodeWhile *)ast)->cond);
+        walk(((NodeWhile *)ast)->body);
+        break;
+    case NDTYPE_MATCH:
+        walk(((NodeMatch *)ast)->target);
+        walk_vec(((NodeMatch *)ast)->bodies);
+        walk(((NodeMatch *)ast)->otherwise);
+        break;
+    case NDTYPE_BLOCK:
+    case NDTYPE_TYPEDBLOCK:
+        walk_vec(((NodeBlock *)ast)->cont);
+        break;
+    case NDTYPE_RETURN:
+        walk(((NodeReturn *)ast)->cont);
+        break;
+    case NDTYPE_FUNCCALL:
+        walk(((NodeFnCall *)ast)->func);
+        walk_vec(((NodeFnCall *)ast)->args);
+        walk(((NodeFnCall *)ast)->failure_block);
+        break;
+    case NDTYPE_FUNCDEF:
+        walk(((NodeFunction *)ast)->block);
+        break;
+    case NDTYPE_VARDECL: {
+        NodeVardecl *v = (NodeVardecl *)ast;
+        if(v->is_block)
+            walk_vec(v->block);
+        else
+            walk(v->init);
+        break;
+    }
+    case NDTYPE_NAMESPACE:
+        walk((Ast *)((NodeNameSpace *)ast)->block);
+        break;
+    case NDTYPE_ASSERT:
+        walk(((NodeAssert *)ast)->cond);
+        break;
+    case NDTYPE_REGION:
+        walk(((NodeRegion *)ast)->block);
+        break;
+    default:
+        break;
+    }
+}
+
+/* evaluating `a` cannot call anything, store, or raise */
+static bool is_inert(Ast *a) {
+    if(!a) return true;
+
+    switch(a->type) {
+    case NDTYPE_NUM:
+    case NDTYPE_BOOL:
+    case NDTYPE_NULL:
+    case NDTYPE_CHAR:
+    case NDTYPE_STRING:
+    case NDTYPE_VARIABLE:
+    case NDTYPE_NONENODE:
+        return true;
+    case NDTYPE_UNARY:
+        return is_inert(((NodeUnaop *)a)->expr);
+    case NDTYPE_BINARY: {
+        NodeBinop *b = (NodeBinop *)a;
+        if(b->impl || b->op == BIN_DIV || b->op == BIN_MOD) return false;
+        return is_inert(b->left) && is_inert(b->right);
+    }
+    case NDTYPE_LIST: {
+        NodeList *l = (NodeList *)a;
+        if(l->nelem || l->init) return false;
+        for(int i = 0; i < l->elem->len; ++i) {
+            if(!is_inert(l->elem->data[i])) return false;
+        }
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+static void push_def(NodeVariable *var, Ast *node) {
+    Def *d = malloc(sizeof(Def));
+    d->var = var;
+    d->node = node;
+    d->live = false;
+
+    vec_push(defs, d);
+}
+
+/*
+ *  Definitions of a module are removable; any other statement of the
+ *  module runs on import and is a root.
+ */
+static void collect(NodeNameSpace *ns, Vector *roots) {
+    Vector *cont = ns->block->cont;
+
+    for(int i = 0; i < cont->len; ++i) {
+        Ast *st = cont->data[i];
+        if(!st) continue;
+
+        if(st->type == NDTYPE_NAMESPACE) {
+            collect((NodeNameSpace *)st, roots);
+        }
+        else if(st->type == NDTYPE_FUNCDEF &&
+                !((NodeFunction *)st)->is_generic &&
+                ((NodeFunction *)st)->op == -1) {
+            push_def(((NodeFunction *)st)->fnvar, st);
+        }
+        else if(st->type == NDTYPE_VARDECL &&
+                !((NodeVardecl *)st)->is_block &&
+                is_inert(((NodeVardecl *)st)->init)) {
+            push_def(((NodeVardecl *)st)->var, st);
+        }
+        else {
+            vec_push(roots, st);
+        }
+    }
+}
+
+static bool is_live(Ast *st) {
+    for(int i = 0; i < defs->len; ++i) {
+        Def *d = (Def *)defs->data[i];
+        if(d->node == st) return d->live;
+    }
+
+    return true;
+}
+
+static void sweep(NodeNameSpace *ns) {
+    Vector *cont = ns->block->cont;
+    Vector *kept = New_Vector();
+
+    for(int i = 0; i < cont->len; ++i) {
+        Ast *st = cont->data[i];
+        if(st && st->type == NDTYPE_NAMESPACE) {
+            sweep((NodeNameSpace *)st);
+        }
+        if(is_live(st)) {
+            vec_push(kept, st);
+        }
+    }
+
+    ns->block->cont = kept;
+    Delete_Vector(cont);
+}
+
+void prune_unreachable(Vector *program) {
+    Vector *roots = New_Vector();
+    defs = New_Vector();
+
+    for(int i = 0; i < program->len; ++i) {
+        Ast *st = program->data[i];
+
+        if(st && st->type == NDTYPE_NAMESPACE)
+            collect((NodeNameSpace *)st, roots);
+        else
+            vec_push(roots, st);
+    }
+
+    walk_vec(roots);
+
+    for(int i = 0; i < program->len; ++i) {
+        Ast *st = program->data[i];
+
+        if(st && st->type == NDTYPE_NAMESPACE)
+            sweep((NodeNameSpace *)st);
+    }
+
+    for(int i = 0; i < defs->len; ++i) {
+        free(defs->data[i]);
+    }
+    Delete_Vector(defs);
+    Delete_Vector(roots);
+}
@@ -1,3 +1,4 @@
+#include <stdlib.h>
 #include <string.h>
 
 #include "sema.h"
@@ -16,6 +17,8 @@ static Ast *visit_unary(Ast *);
 static Ast *visit_assign(Ast *);
 static Ast *visit_dotexpr(Ast *);
 static Ast *visit_subscr(Ast *);
+static Ast *visit_slice(Ast *);
+static Ast *visit_format(Ast *);
 static Ast *visit_object(Ast *);
 static Ast *visit_struct_init(Ast *);
 static Ast *visit_block(Ast *);
@@ -25,6 +28,7 @@ static Ast *visit_if(Ast *);
 static Ast *visit_for(Ast *);
 static Ast *visit_exprif(Ast *);
 static Ast *visit_while(Ast *);
+static Ast *visit_match(Ast *);
 static Ast *visit_return(Ast *);
 static Ast *visit_vardecl(Ast *);
 static Ast *visit_load(Ast *);
@@ -37,6 +41,7 @@ static Ast *visit_bltinfn_call(Ast *, Ast **, Vector *);
 static Ast *visit_namespace(Ast *);
 static Ast *visit_namesolver(Ast *);
 static Ast *visit_assert(Ast *);
+static Ast *visit_region(Ast *);
 
 static NodeVariable *determine_variable(char *, Scope);
 static NodeVariable *determine_overload(NodeVariable *, Vector *);
@@ -47,7 +52,14 @@ static Type *checktype_optional(Type *, Type *);
 Scope scope;
 FuncEnv fnenv;
 Vector *fn_saver;
+static Vector *fn_defs;
+static Vector *bound_guards;
 static int loop_nest = 0;
+/* innermost region block of the function being analyzed */
+static NodeRegion *cur_region;
+/* fnenv variables from this index on are declared inside it */
+static int region_base;
+static int region_loop;
 
 int ngvar = 0;
 
@@ -55,6 +67,8 @@ void sema_init() {
     scope.current = New_Env_Global();
     fnenv.current = New_Env_Global();
     fn_saver = New_Vector();
+    fn_defs = New_Vector();
+    bound_guards = New_Vector();
 
     setup_bltin();
 }
@@ -79,11 +93,55 @@ SemaResult sema_analysis_repl(Vector *ast) {
     return (SemaResult){ isexpr, typestr };
 }
 
+static bool is_userfn(NodeVariable *v) {
+    for(int i = 0; i < fn_defs->len; ++i) {
+        if(((NodeFunction *)fn_defs->data[i])->fnvar == v)
+            return true;
+    }
+
+    return false;
+}
+
+/*
+ *  A function stays pure only if every user function it calls is pure.
+ *  Recursive calls are assumed pure until proven otherwise.
+ */
+static void propagate_purity() {
+    bool changed;
+
+    do {
+        changed = false;
+
+        for(int i = 0; i < fn_defs->len; ++i) {
+            NodeFunction *fn = (NodeFunction *)fn_defs->data[i];
+            if(!(fn->fnvar->vattr & VARATTR_PURE)) continue;
+
+            for(int j = 0; j < fn->callees->len; ++j) {
+                NodeVariable *c = (NodeVariable *)fn->callees->data[j];
+
+                if(!(c->vattr & VARATTR_PURE) || !is_userfn(c)) {
+                    fn->fnvar->vattr &= ~VARATTR_PURE;
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    } while(changed);
+}
+
+static void mark_impure() {
+    if(fn_saver->len == 0) return;
+
+    ((NodeFunction *)vec_last(fn_saver))->fnvar->vattr &= ~VARATTR_PURE;
+}
+
 int sema_analysis(Vector *ast) {
     for(int i = 0; i < ast->len; ++i) {
         ast->data[i] = visit((Ast *)ast->data[i]);
     }
 
+    propagate_purity();
+
     ngvar += var_set_number(fnenv.current->vars);
 
     scope_escape(&scope);
@@ -91,6 +149,11 @@ int sema_analysis(Vector *ast) {
     return ngvar;
 }
 
+static bool is_pure_bltin(NodeVariable *v) {
+    return strcmp(v->name, "len") == 0 ||
+           strcmp(v->name, "tofloat") == 0;
+}
+
 void setup_bltin() {
     Varlist *bltfns = New_Varlist();
     for(int i = 0; i < Global_Cbltins->len; ++i) {
@@ -99,6 +162,9 @@ void setup_bltin() {
         a->isglobal = true;
         a->isbuiltin = true;
         a->is_overload = false;
+        if(is_pure_bltin(a)) {
+            a->vattr |= VARATTR_PURE;
+        }
 
         varlist_push(bltfns, a);
     }
@@ -107,6 +173,270 @@ void setup_bltin() {
     varlist_mulpush(scope.current->vars, bltfns);
 }
 
+/*
+ *  Bounds check elimination.
+ *
+ *  A condition `i < ls.len` (or `ls.len - k`) guards the body of a while
+ *  or an if.  Within the body, `ls[i]` is proven in bounds until `i` or
+ *  `ls` may have been reassigned; list lengths never change.  Codegen
+ *  additionally requires `i` to be non-negative (no VARATTR_MAYNEG).
+ */
+
+typedef struct BoundGuard {
+    NodeVariable *index;
+    NodeVariable *list;
+    bool valid;
+    Vector *proven;     /* NodeSubscript */
+} BoundGuard;
+
+static bool is_list_len(Ast *a, NodeVariable **list) {
+    if(!a || a->type != NDTYPE_DOTEXPR) return false;
+
+    NodeDotExpr *d = (NodeDotExpr *)a;
+    if(!d->t.member) return false;
+
+    Ast *ls = d->memb->left;
+    if(ls->type != NDTYPE_VARIABLE || !type_is(ls->ctype, CTYPE_LIST))
+        return false;
+
+    if(list) *list = (NodeVariable *)ls;
+    return true;
+}
+
+static bool is_nonneg_literal(Ast *a) {
+    return a && a->type == NDTYPE_NUM &&
+           !((NodeNumber *)a)->isfloat &&
+           ((NodeNumber *)a)->number >= 0;
+}
+
+/* `ls.len - k` => k, otherwise -1 */
+static int64_t len_offset(Ast *a, NodeVariable **list) {
+    if(is_list_len(a, list)) return 0;
+
+    if(a && a->type == NDTYPE_BINARY) {
+        NodeBinop *b = (NodeBinop *)a;
+        if(b->op == BIN_SUB &&
+           is_list_len(b->left, list) &&
+           is_nonneg_literal(b->right)) {
+            return ((NodeNumber *)b->right)->number;
+        }
+    }
+
+    return -1;
+}
+
+/* `e` cannot make `self` negative, given that `self` is non-negative */
+static bool is_nonneg_expr(Ast *e, NodeVariable *self) {
+    if(!e) return false;
+
+    switch(e->type) {
+    case NDTYPE_NUM:
+        return is_nonneg_literal(e);
+    case NDTYPE_VARIABLE:
+        return (NodeVariable *)e == self;
+    case NDTYPE_DOTEXPR:
+        return is_list_len(e, NULL);
+    case NDTYPE_BINARY: {
+        NodeBinop *b = (NodeBinop *)e;
+        if(b->op != BIN_ADD) return false;
+
+        return (is_nonneg_literal(b->left) && is_nonneg_expr(b->right, self)) ||
+               (is_nonneg_literal(b->right) && is_nonneg_expr(b->left, self));
+    }
+    default:
+        return false;
+    }
+}
+
+static bool is_effect_free(Ast *a) {
+    if(!a) return false;
+
+    switch(a->type) {
+    case NDTYPE_NUM:
+    case NDTYPE_BOOL:
+    case NDTYPE_CHAR:
+    case NDTYPE_VARIABLE:
+        return true;
+    case NDTYPE_BINARY:
+        return is_effect_free(((NodeBinop *)a)->left) &&
+               is_effect_free(((NodeBinop *)a)->right);
+    case NDTYPE_UNARY:
+        return is_effect_free(((NodeUnaop *)a)->expr);
+    case NDTYPE_SUBSCR:
+        return is_effect_free(((NodeSubscript *)a)->ls) &&
+               is_effect_free(((NodeSubscript *)a)->index);
+    case NDTYPE_DOTEXPR:
+        return is_list_len(a, NULL);
+    default:
+        return false;
+    }
+}
+
+static BoundGuard *new_bound_guard(Ast *cond) {
+    if(!cond || cond->type != NDTYPE_BINARY) return NULL;
+
+    NodeBinop *b = (NodeBinop *)cond;
+    Ast *idx, *bound;
+    bool strict;
+
+    switch(b->op) {
+    case BIN_LT:  idx = b->left;  bound = b->right; strict = true;  break;
+    case BIN_LTE: idx = b->left;  bound = b->right; strict = false; break;
+    case BIN_GT:  idx = b->right; bound = b->left;  strict = true;  break;
+    case BIN_GTE: idx = b->right; bound = b->left;  strict = false; break;
+    default:      return NULL;
+    }
+
+    if(!idx || idx->type != NDTYPE_VARIABLE) return NULL;
+
+    NodeVariable *list;
+    int64_t k = len_offset(bound, &list);
+    if(k < 0 || (!strict && k == 0)) return NULL;
+
+    BoundGuard *g = xmalloc(sizeof(BoundGuard));
+    g->index = (NodeVariable *)idx;
+    g->list = list;
+    g->valid = true;
+    g->proven = New_Vector();
+
+    return g;
+}
+
+static void prove_in(Ast *a, BoundGuard *g) {
+    if(!a) return;
+
+    switch(a->type) {
+    case NDTYPE_BINARY:
+        prove_in(((NodeBinop *)a)->left, g);
+        prove_in(((NodeBinop *)a)->right, g);
+        break;
+    case NDTYPE_UNARY:
+        prove_in(((NodeUnaop *)a)->expr, g);
+        break;
+    case NDTYPE_SUBSCR: {
+        NodeSubscript *s = (NodeSubscript *)a;
+        prove_in(s->index, g);
+        if(s->ls == (Ast *)g->list && s->index == (Ast *)g->index)
+            s->inbounds = true;
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+static void collect_conjuncts(Ast *a, Vector *out) {
+    if(a && a->type == NDTYPE_BINARY && ((NodeBinop *)a)->op == BIN_LAND) {
+        collect_conjuncts(((NodeBinop *)a)->left, out);
+        collect_conjuncts(((NodeBinop *)a)->right, out);
+    }
+    else {
+        vec_push(out, a);
+    }
+}
+
+/* returns the number of guards pushed for `cond` */
+static int bce_enter(Ast *cond) {
+    Vector *conj = New_Vector();
+    int n = 0;
+    collect_conjuncts(cond, conj);
+
+    for(int i = 0; i < conj->len; ++i) {
+        BoundGuard *g = new_bound_guard(conj->data[i]);
+        if(!g) continue;
+
+        bool effect_free = true;
+        for(int j = i + 1; j < conj->len; ++j) {
+            if(!is_effect_free(conj->data[j])) effect_free = false;
+        }
+        if(!effect_free) continue;
+
+        /* `i < ls.len and ls[i] > 0`: `and` evaluates the rest only
+         * after the guard held */
+        for(int j = i + 1; j < conj->len; ++j) {
+            prove_in(conj->data[j], g);
+        }
+
+        vec_push(bound_guards, g);
+        ++n;
+    }
+
+    Delete_Vector(conj);
+
+    return n;
+}
+
+static void bce_leave(int n) {
+    while(n--) {
+        BoundGuard *g = vec_pop(bound_guards);
+        Delete_Vector(g->proven);
+        free(g);
+    }
+}
+
+static void bce_invalidate(NodeVariable *v) {
+    for(int i = 0; i < bound_guards->len; ++i) {
+        BoundGuard *g = (BoundGuard *)bound_guards->data[i];
+        if(g->index == v || g->list == v)
+            g->valid = false;
+    }
+}
+
+/* a called function may assign any global */
+static void bce_invalidate_globals() {
+    for(int i = 0; i < bound_guards->len; ++i) {
+        BoundGuard *g = (BoundGuard *)bound_guards->data[i];
+        if(g->index->isglobal || g->list->isglobal)
+            g->valid = false;
+    }
+}
+
+static void bce_prove(NodeSubscript *s) {
+    s->inbounds = false;
+
+    if(!s->ls || !s->index) return;
+
+    for(int i = bound_guards->len - 1; i >= 0; --i) {
+        BoundGuard *g = (BoundGuard *)bound_guards->data[i];
+
+        if(g->valid &&
+           s->ls == (Ast *)g->list &&
+           s->index == (Ast *)g->index) {
+            s->inbounds = true;
+            vec_push(g->proven, s);
+            return;
+        }
+    }
+}
+
+/*
+ *  A nested loop runs its body repeatedly, so an access proven before a
+ *  reassignment inside it is not safe on the next iteration.
+ */
+static int *bce_loop_enter() {
+    int *snap = xmalloc(sizeof(int) * (bound_guards->len + 1));
+
+    for(int i = 0; i < bound_guards->len; ++i) {
+        BoundGuard *g = (BoundGuard *)bound_guards->data[i];
+        snap[i] = g->valid ? g->proven->len : -1;
+    }
+
+    return snap;
+}
+
+static void bce_loop_leave(int *snap, int nguard) {
+    for(int i = 0; i < nguard; ++i) {
+        BoundGuard *g = (BoundGuard *)bound_guards->data[i];
+        if(snap[i] < 0 || g->valid) continue;
+
+        for(int j = snap[i]; j < g->proven->len; ++j) {
+            ((NodeSubscript *)g->proven->data[j])->inbounds = false;
+        }
+    }
+
+    free(snap);
+}
+
 static Ast *visit(Ast *ast) {
     if(!ast) return NULL;
 
@@ -119,6 +449,8 @@ static Ast *visit(Ast *ast) {
         break;
     case NDTYPE_LIST: return visit_list(ast);
     case NDTYPE_SUBSCR: return visit_subscr(ast);
+    case NDTYPE_SLICE:  return visit_slice(ast);
+    case NDTYPE_FORMAT: return visit_format(ast);
     case NDTYPE_TUPLE:
         mxc_unimplemented("tuple");
         return ast;
@@ -132,12 +464,13 @@ static Ast *visit(Ast *ast) {
     case NDTYPE_EXPRIF: return visit_exprif(ast);
     case NDTYPE_FOR: return visit_for(ast);
     case NDTYPE_WHILE: return visit_while(ast);
+    case NDTYPE_MATCH: return visit_match(ast);
     case NDTYPE_BLOCK: return visit_block(ast);
     case NDTYPE_TYPEDBLOCK: return visit_typed_block(ast);
     case NDTYPE_RETURN: return visit_return(ast);
     case NDTYPE_BREAK: return visit_break(ast);
     case NDTYPE_SKIP: return visit_skip(ast);
-    case NDTYPE_BREAKPOINT: break;
+    case NDTYPE_BREAKPOINT: mark_impure(); break;
     case NDTYPE_VARIABLE: return visit_load(ast);
     case NDTYPE_FUNCCALL: return visit_fncall(ast);
     case NDTYPE_FUNCDEF: return visit_funcdef(ast);
@@ -145,6 +478,7 @@ static Ast *visit(Ast *ast) {
     case NDTYPE_NAMESPACE: return visit_namespace(ast);
     case NDTYPE_NAMESOLVER: return visit_namesolver(ast);
     case NDTYPE_ASSERT: return visit_assert(ast);
+    case NDTYPE_REGION: return visit_region(ast);
     case NDTYPE_NONENODE: break;
     default: mxc_assert(0, "unimplemented node");
     }
@@ -186,9 +520,10 @@ static Ast *visit_list(Ast *ast) {
         base = CTYPE(l->elem->data[0]);
 
         for(size_t i = 1; i < l->nsize; ++i) {
-            Ast *el = (Ast *)l->elem->data[i];
+            Ast *el = visit((Ast *)l->elem->data[i]);
+            if(!el) return NULL;
 
-            el = visit(el);
+            l->elem->data[i] = el;
 
             if(!checktype(base, el->ctype)) {
                 if(!base || !el->ctype)
@@ -292,6 +627,72 @@ static Ast *visit_unary(Ast *ast) {
     return CAST_AST(u);
 }
 
+/* values of these types are not heap objects */
+static bool is_unboxed(Type *ty) {
+    if(!ty) return true;
+
+    switch(ty->type) {
+    case CTYPE_NONE:
+    case CTYPE_BOOL:
+    case CTYPE_CHAR:
+    case CTYPE_INT:
+    case CTYPE_UINT:
+    case CTYPE_INT64:
+    case CTYPE_UINT64:
+    case CTYPE_DOUBLE:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool declared_in_region(NodeVariable *v) {
+    Vector *vars = fnenv.current->vars->vars;
+
+    for(int i = region_base; i < vars->len; ++i) {
+        if(vars->data[i] == v) return true;
+    }
+
+    return false;
+}
+
+/* the variable an lvalue-like expression reads from, if any */
+static NodeVariable *root_variable(Ast *ast) {
+    for(;;) {
+        switch(ast->type) {
+        case NDTYPE_VARIABLE:
+            return (NodeVariable *)ast;
+        case NDTYPE_SUBSCR:
+            ast = ((NodeSubscript *)ast)->ls;
+            break;
+        case NDTYPE_DOTEXPR:
+            if(!((NodeDotExpr *)ast)->t.member) return NULL;
+            ast = ((NodeDotExpr *)ast)->memb->left;
+            break;
+        case NDTYPE_MEMBER:
+            ast = ((NodeMember *)ast)->left;
+            break;
+        default:
+            return NULL;
+        }
+    }
+}
+
+/*
+ *  Objects allocated inside a region are freed when it exits, so they
+ *  must not be stored where code after the region can reach them.
+ *  Values read from outside the region were allocated outside.
+ */
+static bool region_escapes(Ast *dst, Ast *src) {
+    if(!cur_region || is_unboxed(src->ctype)) return false;
+
+    NodeVariable *from = root_variable(src);
+    if(from && !declared_in_region(from)) return false;
+
+    NodeVariable *to = root_variable(dst);
+    return !to || !declared_in_region(to);
+}
+
 static Ast *visit_var_assign(NodeAssignment *a) {
     NodeVariable *v = (NodeVariable *)a->dst;
 
@@ -301,6 +702,18 @@ static Ast *visit_var_assign(NodeAssignment *a) {
     }
     v->vattr &= ~(VARATTR_UNINIT);
 
+    if(v->isglobal) {
+        mark_impure();
+    }
+    bce_invalidate(v);
+    if(!is_nonneg_expr(a->src, v)) {
+        v->vattr |= VARATTR_MAYNEG;
+    }
+    if(type_is(a->dst->ctype, CTYPE_FUNCTION)) {
+        /* callers can no longer rely on the original definition */
+        v->vattr &= ~VARATTR_PURE;
+    }
+
     if(!checktype(a->dst->ctype, a->src->ctype)) {
         if(!a->dst->ctype || !a->src->ctype) return NULL;
 
@@ -316,6 +729,15 @@ static Ast *visit_var_assign(NodeAssignment *a) {
 }
 
 static Ast *visit_subscr_assign(NodeAssignment *a) {
+    NodeSubscript *s = (NodeSubscript *)a->dst;
+
+    /* strings passed as arguments may be shared with the caller */
+    if(type_is(s->ls->ctype, CTYPE_STRING)) {
+        mark_impure();
+    }
+    /* the source is evaluated before the index */
+    bce_prove(s);
+
     if(!checktype(a->dst->ctype, a->src->ctype)) {
         if(!a->dst->ctype || !a->src->ctype)
             return NULL;
@@ -332,6 +754,10 @@ static Ast *visit_subscr_assign(NodeAssignment *a) {
 }
 
 static Ast *visit_member_assign(NodeAssignment *a) {
+    if(is_list_len(a->dst, NULL)) {
+        error("assignment of read-only member: len");
+        return NULL;
+    }
     if(!checktype(a->dst->ctype, a->src->ctype)) {
         if(!a->dst->ctype || !a->src->ctype)
             return NULL;
@@ -353,6 +779,11 @@ static Ast *visit_assign(Ast *ast) {
     a->src = visit(a->src);
     if(!a->dst || !a->src) return NULL;
 
+    if(region_escapes(a->dst, a->src)) {
+        error("value allocated in a region escapes by assignment");
+        return NULL;
+    }
+
     switch(a->dst->type) {
     case NDTYPE_VARIABLE:   return visit_var_assign(a);
     case NDTYPE_SUBSCR:     return visit_subscr_assign(a);
@@ -383,12 +814,48 @@ static Ast *visit_subscr(Ast *ast) {
     }
     CTYPE(s)= s->ls->ctype->ptr;
 
+    if(type_is(s->ls->ctype, CTYPE_LIST)) {
+        bce_prove(s);
+    }
+
+    return (Ast *)s;
+}
+
+static Ast *visit_slice(Ast *ast) {
+    NodeSlice *s = (NodeSlice *)ast;
+
+    s->ls = visit(s->ls);
+    s->begin = visit(s->begin);
+    s->end = visit(s->end);
+
+    if(!s->ls || !s->begin || !s->end) return NULL;
+    if(!CTYPE(s->ls)) return NULL;
+
+    if(!type_is(s->ls->ctype, CTYPE_STRING)) {
+        error("cannot slice a value of type `%s`",
+              s->ls->ctype->tostring(s->ls->ctype));
+        return NULL;
+    }
+    if(!type_is(s->begin->ctype, CTYPE_INT) ||
+       !type_is(s->end->ctype, CTYPE_INT)) {
+        error("slice bounds must be int");
+        return NULL;
+    }
+    CTYPE(s) = mxcty_string;
+
     return (Ast *)s;
 }
 
 static Ast *visit_member_impl(Ast *self, Ast **left, Ast **right) {
     if(!*left || !(*left)->ctype) return NULL;
 
+    if(type_is((*left)->ctype, CTYPE_LIST) &&
+       (*right)->type == NDTYPE_VARIABLE &&
+       strcmp(((NodeVariable *)*right)->name, "len") == 0) {
+        self->ctype = mxcty_int;
+        return self;
+    }
+
     if(!is_struct((*left)->ctype)) {
         return NULL;
     }
@@ -502,7 +969,11 @@ static Ast *visit_typed_block(Ast *ast) {
 static Ast *visit_if(Ast *ast) {
     NodeIf *i = (NodeIf *)ast;
     i->cond = visit(i->cond);
+
+    int nguard = bce_enter(i->cond);
     i->then_s = visit(i->then_s);
+    bce_leave(nguard);
+
     i->else_s = visit(i->else_s);
 
     CTYPE(i)= mxcty_none;
@@ -543,6 +1014,7 @@ static Ast *visit_for(Ast *ast) {
     for(int i = 0; i < f->vars->len; i++) {
         CTYPE(f->vars->data[i])= f->iter->ctype->ptr;
         ((NodeVariable *)f->vars->data[i])->isglobal = isglobal;
+        ((NodeVariable *)f->vars->data[i])->vattr |= VARATTR_MAYNEG;
 
         varlist_push(fnenv.current->vars, f->vars->data[i]);
         varlist_push(scope.current->vars, f->vars->data[i]);
@@ -550,7 +1022,10 @@ static Ast *visit_for(Ast *ast) {
         f->vars->data[i] = visit(f->vars->data[i]);
     }
 
+    int nouter = bound_guards->len;
+    int *snap = bce_loop_enter();
     f->body = visit(f->body);
+    bce_loop_leave(snap, nouter);
 
     scope_escape(&scope);
 
@@ -559,15 +1034,97 @@ static Ast *visit_for(Ast *ast) {
 
 static Ast *visit_while(Ast *ast) {
     NodeWhile *w = (NodeWhile *)ast;
+    int nouter = bound_guards->len;
+    int *snap = bce_loop_enter();
+
     w->cond = visit(w->cond);
+    int nguard = bce_enter(w->cond);
 
     loop_nest++;
     w->body = visit(w->body);
     loop_nest--;
 
+    bce_leave(nguard);
+    bce_loop_leave(snap, nouter);
+
     return CAST_AST(w);
 }
 
+static bool pattern_equal(Ast *a, Ast *b) {
+    if(a->type == NDTYPE_STRING) {
+        return strcmp(((NodeString *)a)->string,
+                      ((NodeString *)b)->string) == 0;
+    }
+
+    int64_t x, y;
+    pattern_int(a, &x);
+    pattern_int(b, &y);
+
+    return x == y;
+}
+
+static bool pattern_ok(Ast *p, Type *ty) {
+    int64_t n;
+
+    switch(ty->type) {
+    case CTYPE_INT:
+        return p->type != NDTYPE_CHAR && pattern_int(p, &n);
+    case CTYPE_CHAR:
+        return p->type == NDTYPE_CHAR;
+    case CTYPE_STRING:
+        return p->type == NDTYPE_STRING;
+    default:
+        return false;
+    }
+}
+
+static Ast *visit_match(Ast *ast) {
+    NodeMatch *m = (NodeMatch *)ast;
+    m->target = visit(m->target);
+    if(!m->target || !m->target->ctype) return NULL;
+
+    Type *ty = m->target->ctype;
+    if(!type_is(ty, CTYPE_INT) &&
+       !type_is(ty, CTYPE_CHAR) &&
+       !type_is(ty, CTYPE_STRING)) {
+        error("cannot match on a value of type `%s`", ty->tostring(ty));
+        return NULL;
+    }
+
+    Vector *seen = New_Vector();
+
+    for(int i = 0; i < m->pats->len; ++i) {
+        Vector *arm = (Vector *)m->pats->data[i];
+
+        for(int j = 0; j < arm->len; ++j) {
+            Ast *p = arm->data[j];
+
+            if(!pattern_ok(p, ty)) {
+                error("match pattern must be a literal of type `%s`",
+                      ty->tostring(ty));
+                return NULL;
+            }
+            for(int k = 0; k < seen->len; ++k) {
+                if(pattern_equal(p, seen->data[k])) {
+                    error("duplicate pattern in match");
+                    return NULL;
+                }
+            }
+            vec_push(seen, p);
+        }
+
+        m->bodies->data[i] = visit(m->bodies->data[i]);
+    }
+
+    Delete_Vector(seen);
+
+    m->otherwise = visit(m->otherwise);
+
+    CTYPE(m) = mxcty_none;
+
+    return CAST_AST(m);
+}
+
 static Ast *visit_return(Ast *ast) {
     NodeReturn *r = (NodeReturn *)ast;
     r->cont = visit(r->cont);
@@ -577,6 +1134,10 @@ static Ast *visit_return(Ast *ast) {
         error("use of return statement outside function or block");
         return NULL;
     }
+    if(cur_region) {
+        error("return statement inside region");
+        return NULL;
+    }
 
     Type *cur_fn_retty =
         CTYPE(((NodeFunction *)vec_last(fn_saver))->fnvar)->fnret;
@@ -609,6 +1170,10 @@ static Ast *visit_break(Ast *ast) {
         error("break statement must be inside loop statement");
         return NULL;
     }
+    if(cur_region && loop_nest == region_loop) {
+        error("break statement cannot leave a region");
+        return NULL;
+    }
 
     return (Ast *)b;
 }
@@ -619,6 +1184,10 @@ static Ast *visit_skip(Ast *ast) {
         error("skip statement must be inside loop statement");
         return NULL;
     }
+    if(cur_region && loop_nest == region_loop) {
+        error("skip statement cannot leave a region");
+        return NULL;
+    }
 
     return (Ast *)s;
 }
@@ -643,6 +1212,10 @@ static Ast *visit_vardecl(Ast *ast) {
         v->init = visit(v->init);
         if(!v->init) return NULL;
 
+        if(!is_nonneg_expr(v->init, v->var)) {
+            v->var->vattr |= VARATTR_MAYNEG;
+        }
+
         if(type_is(CTYPE(v->var), CTYPE_UNINFERRED)) {
             CTYPE(v->var) = v->init->ctype;
         }
@@ -706,21 +1279,70 @@ static Ast *visit_fncall_impl(Ast *self, Ast **ast, Vector *arg) {
 
     NodeVariable *fn = (NodeVariable *)*ast;
     if(fn->isbuiltin) {
+        if(!(fn->vattr & VARATTR_PURE)) {
+            mark_impure();
+        }
         return visit_bltinfn_call(self, ast, argtys);
     }
+    if(fn_saver->len != 0) {
+        vec_push(((NodeFunction *)vec_last(fn_saver))->callees, fn);
+    }
+    bce_invalidate_globals();
     self->ctype = CTYPE(fn)->fnret;
 
     return self;
 }
 
+static bool is_format_call(NodeFnCall *f) {
+    NodeVariable *fn = (NodeVariable *)f->func;
+
+    return fn->isbuiltin && strcmp(fn->name, "format") == 0 &&
+           ((Ast *)f->args->data[0])->type == NDTYPE_STRING;
+}
+
+/* format("a{}b", x) with a literal is compiled like "a{x}b" */
+static Ast *format_to_node(NodeFnCall *f) {
+    char *fmt = ((NodeString *)f->args->data[0])->string;
+    Vector *pieces = New_Vector();
+    int narg = 1;
+    char *p = fmt;
+
+    for(char *q; (q = strstr(p, "{}")); p = q + 2) {
+        if(q > p) {
+            char *text = xmalloc(q - p + 1);
+            memcpy(text, p, q - p);
+            text[q - p] = '\0';
+            vec_push(pieces, new_node_string(text));
+        }
+        if(narg == f->args->len) {
+            error("too few arguments for format string \"%s\"", fmt);
+            return NULL;
+        }
+        vec_push(pieces, f->args->data[narg++]);
+    }
+    if(*p) {
+        vec_push(pieces, new_node_string(p));
+    }
+    if(narg != f->args->len) {
+        error("too many arguments for format string \"%s\"", fmt);
+        return NULL;
+    }
+
+    return (Ast *)new_node_format(pieces);
+}
+
 static Ast *visit_fncall(Ast *ast) {
     NodeFnCall *f = (NodeFnCall *)ast;
     f->func = visit(f->func);
-    for(size_t i = 0; i < f->args->len; ++i) {
+    for(int i = 0; i < f->args->len; ++i) {
         f->args->data[i] = visit((Ast *)f->args->data[i]);
     }
     f = (NodeFnCall *)visit_fncall_impl((Ast *)f, &f->func, f->args);
 
+    if(f && is_format_call(f)) {
+        return format_to_node(f);
+    }
+
     return (Ast *)f;
 }
 
@@ -728,6 +1350,7 @@ static Ast *visit_funcdef(Ast *ast) {
     NodeFunction *fn = (NodeFunction *)ast;
 
     vec_push(fn_saver, fn);
+    vec_push(fn_defs, fn);
     fn->fnvar->isglobal = funcenv_isglobal(fnenv);
     NodeVariable *registerd_var = determine_variable(fn->fnvar->name, scope);
 
@@ -748,8 +1371,14 @@ static Ast *visit_funcdef(Ast *ast) {
 
     funcenv_make(&fnenv);
     scope_make(&scope);
-
-    fn->fnvar->vattr = 0;
+    /* guards of the enclosing code do not hold inside the body */
+    Vector *outer_guards = bound_guards;
+    bound_guards = New_Vector();
+    /* the body is not inside the regions around the definition */
+    NodeRegion *outer_region = cur_region;
+    cur_region = NULL;
+
+    fn->fnvar->vattr = VARATTR_PURE;
     if(fn->is_generic) {
         for(int i = 0; i < fn->typevars->len; i++) {
             vec_push(scope.current->userdef_type,
@@ -761,6 +1390,7 @@ static Ast *visit_funcdef(Ast *ast) {
     for(int i = 0; i < fn->args->vars->len; ++i) {
         NodeVariable *cur = (NodeVariable *)fn->args->vars->data[i];
         cur->isglobal = false;
+        cur->vattr |= VARATTR_MAYNEG;
 
         CTYPE(fn->fnvar)->fnarg->data[i] =
                 solve_type(CTYPE(fn->fnvar)->fnarg->data[i]);
@@ -791,6 +1421,9 @@ static Ast *visit_funcdef(Ast *ast) {
 
     funcenv_escape(&fnenv);
     scope_escape(&scope);
+    Delete_Vector(bound_guards);
+    bound_guards = outer_guards;
+    cur_region = outer_region;
 
     vec_pop(fn_saver);
 
@@ -822,12 +1455,36 @@ static Ast *visit_bltinfn_call(Ast *self, Ast **func, Vector *argtys) {
        strcmp(fn->name, "println") == 0) {
         print_arg_check(argtys);
     }
+    else if(strcmp(fn->name, "format") == 0) {
+        if(argtys->len == 0 ||
+           !type_is((Type *)argtys->data[0], CTYPE_STRING)) {
+            error("format expects a format string");
+            return NULL;
+        }
+        if(!print_arg_check(argtys)) return NULL;
+    }
 
     self->ctype = CTYPE(fn)->fnret;
 
     return self;
 }
 
+static Ast *visit_format(Ast *ast) {
+    NodeFormat *f = (NodeFormat *)ast;
+    Vector *tys = New_Vector();
+
+    for(int i = 0; i < f->pieces->len; ++i) {
+        Ast *p = visit((Ast *)f->pieces->data[i]);
+        if(!p || !CTYPE(p)) return NULL;
+
+        f->pieces->data[i] = p;
+        vec_push(tys, CTYPE(p));
+    }
+    if(!print_arg_check(tys)) return NULL;
+
+    return ast;
+}
+
 static Ast *visit_load(Ast *ast) {
     NodeVariable *v = (NodeVariable *)ast;
     NodeVariable *res = determine_variable(v->name, scope);
@@ -844,15 +1501,36 @@ static Ast *visit_load(Ast *ast) {
         return NULL;
     }
 
+    if(v->isglobal && !type_is(CTYPE(v), CTYPE_FUNCTION)) {
+        mark_impure();
+    }
+
     v->used = true;
 
     return CAST_AST(v);
 }
 
+static void import_cmodule(MxcModule *mod) {
+    for(int i = 0; i < mod->cbltins->len; ++i) {
+        NodeVariable *v = ((MxcCBltin *)mod->cbltins->data[i])->var;
+        v->isglobal = true;
+        v->isbuiltin = true;
+        v->is_overload = false;
+
+        varlist_push(scope.current->vars, v);
+        varlist_push(fnenv.current->vars, v);
+    }
+}
+
 static Ast *visit_namespace(Ast *ast) {
     NodeNameSpace *s = (NodeNameSpace *)ast;
     scope_make(&scope);
 
+    MxcModule *mod = search_cmodule(s->name);
+    if(mod) {
+        import_cmodule(mod);
+    }
+
     for(int i = 0; i < s->block->cont->len; ++i) {
         s->block->cont->data[i] = visit(s->block->cont->data[i]);
     }
@@ -880,6 +1558,31 @@ static Ast *visit_assert(Ast *ast) {
     return (Ast *)a;
 }
 
+static Ast *visit_region(Ast *ast) {
+    NodeRegion *r = (NodeRegion *)ast;
+    NodeRegion *outer = cur_region;
+    int outer_base = region_base;
+    int outer_loop = region_loop;
+    Vector *vars = fnenv.current->vars->vars;
+    int base = vars->len;
+
+    cur_region = r;
+    region_base = base;
+    region_loop = loop_nest;
+    r->block = visit(r->block);
+    cur_region = outer;
+    region_base = outer_base;
+    region_loop = outer_loop;
+    if(!r->block) return NULL;
+
+    /* the VM clears them on exit */
+    for(int i = base; i < vars->len; ++i) {
+        vec_push(r->vars, vars->data[i]);
+    }
+
+    return (Ast *)r;
+}
+
 static Ast *visit_namesolver(Ast *ast) {
     NodeNameSolver *v = (NodeNameSolver *)ast;
     NodeVariable *ns_name = (NodeVariable *)v->name;
@@ -890,10 +1593,13 @@ static Ast *visit_namesolver(Ast *ast) {
     }
     NodeVariable *id = (NodeVariable *)v->ident;
 
-    for(size_t i = 0; i < vars->vars->len; ++i) {
+    for(int i = 0; i < vars->vars->len; ++i) {
         NodeVariable *cur = (NodeVariable *)vars->vars->data[i];
 
         if(strcmp(id->name, cur->name) == 0) {
+            if(!type_is(CTYPE(cur), CTYPE_FUNCTION)) {
+                mark_impure();
+            }
             return (Ast *)cur;
         }
     }
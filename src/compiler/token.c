@@ -27,6 +27,7 @@ struct KeyWordMap {
     {"new", TKIND_New},        {"in", TKIND_In},
     {"null", TKIND_Null},      {"breakpoint", TKIND_BreakPoint},
     {"xor", TKIND_Xor},        {"assert", TKIND_Assert},
+    {"match", TKIND_Match},    {"region", TKIND_Region},
 };
 
 Map *keywordmap;
@@ -129,6 +130,13 @@ enum TKIND tk_char2(int c1, int c2) {
         case '=':
             return TKIND_ModAs;
         }
+    case '.':
+        switch(c2) {
+        case '.':
+            return TKIND_DotDot;
+        }
+        error("internal error: %c%c", c1, c2);
+        return -1;
     default:
         error("internal error: %c%c", c1, c2);
         return -1;
@@ -141,6 +149,8 @@ const char *tk2str(enum TKIND tk) {
     case TKIND_Num: return "Number";
     case TKIND_String: return "String";
     case TKIND_Char: return "Char";
+    case TKIND_FString: return "String";
+    case TKIND_FStringEnd: return "end of string";
     case TKIND_Identifer: return "Identifer";
     case TKIND_TInt: return "int";
     case TKIND_TUint: return "uint";
@@ -178,6 +188,8 @@ const char *tk2str(enum TKIND tk) {
     case TKIND_BreakPoint: return "breakpoint";
     case TKIND_Xor: return "xor";
     case TKIND_Assert: return "assert";
+    case TKIND_Match: return "match";
+    case TKIND_Region: return "region";
     case TKIND_Lparen: return "(";
     case TKIND_Rparen: return ")";
     case TKIND_Lbrace: return "{";
@@ -243,7 +255,7 @@ static Token *New_Token(enum TKIND kind,
     return self;
 }
 
-static Token *New_Token_Char(char c, SrcPos s, SrcPos e) {
+static Token *New_Token_Char(int32_t c, SrcPos s, SrcPos e) {
     Token *self = malloc(sizeof(Token));
     self->kind = TKIND_Char;
     self->cont = c;
@@ -328,7 +340,7 @@ void token_push_string(Vector *self, String *str, SrcPos s, SrcPos e) {
     vec_push(self, tk);
 }
 
-void token_push_char(Vector *self, char c, SrcPos s, SrcPos e) {
+void token_push_char(Vector *self, int32_t c, SrcPos s, SrcPos e) {
     vec_push(self, New_Token_Char(c, s, e));
 }
 
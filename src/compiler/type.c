@@ -214,7 +214,7 @@ char *functy_tostring(Type *ty) {
         return "";
     }
 
-    for(size_t i = 0; i < ty->fnarg->len; ++i) {
+    for(int i = 0; i < ty->fnarg->len; ++i) {
         Type *c = (Type *)ty->fnarg->data[i];
         sum_len += strlen(c->tostring(c));
     }
@@ -231,7 +231,7 @@ char *functy_tostring(Type *ty) {
      *  (int,int,int):int
      */
     strcpy(name, "(");
-    for(size_t i = 0; i < ty->fnarg->len; ++i) {
+    for(int i = 0; i < ty->fnarg->len; ++i) {
         if(i > 0) {
             strcat(name, ",");
         }
@@ -276,7 +276,7 @@ Type TypeChar = {
     .tostring = charty_tostring,
     .optional = false,
     .isprimitive = true,
-    .defop = NULL,
+    .defop = opdefs_char,
     {{0}},
 };
 
@@ -3,6 +3,8 @@
 #include "frame.h"
 #include "object/object.h"
 #include "object/intobject.h"
+#include "object/strobject.h"
+#include "writer.h"
 
 extern char *filename;
 
@@ -19,7 +21,26 @@ void raise_outofrange(Frame *f,
     f->occurred_rterr.argc = 2;
 }
 
+void raise_badslice(Frame *f,
+                    MxcValue begin,
+                    MxcValue end) {
+    f->occurred_rterr.type = RTERR_BADSLICE;
+    f->occurred_rterr.args[0] = begin;
+    f->occurred_rterr.args[1] = end;
+    f->occurred_rterr.argc = 2;
+}
+
+void raise_badpattern(Frame *f,
+                      MxcValue pattern,
+                      const char *why) {
+    f->occurred_rterr.type = RTERR_BADPATTERN;
+    f->occurred_rterr.args[0] = pattern;
+    f->occurred_rterr.argc = 1;
+    f->occurred_rterr.msg = why;
+}
+
 void runtime_error(Frame *f) {
+    writer_flush(&mxc_stdout);
     switch(f->occurred_rterr.type) {
     case RTERR_NONEERR:
         /* unreachable */
@@ -42,6 +63,24 @@ void runtime_error(Frame *f) {
         log_error("\e[31;1m[runtime error] \e[0m"
                 "sorry. unimplemented");
         break;
+    case RTERR_OUT_OF_FUEL:
+        log_error("\e[31;1m[runtime error] \e[0m"
+                "evaluation step limit exceeded");
+        break;
+    case RTERR_BADSLICE:
+        log_error("\e[31;1m[runtime error] \e[0m"
+                "invalid slice: %ld..%ld",
+                f->occurred_rterr.args[0].num,
+                f->occurred_rterr.args[1].num);
+        break;
+    case RTERR_BADPATTERN: {
+        MxcString *pat = ostr(f->occurred_rterr.args[0]);
+        log_error("\e[31;1m[runtime error] \e[0m"
+                "invalid pattern \"%.*s\": %s",
+                (int)ITERABLE(pat)->length, STR_PTR(pat),
+                f->occurred_rterr.msg);
+        break;
+    }
     }
 
     if(filename) {
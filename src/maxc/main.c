@@ -1,3 +1,5 @@
+#include <string.h>
+
 #include "maxc.h"
 #include "ast.h"
 #include "bytecode.h"
@@ -5,13 +7,17 @@
 #include "error/error.h"
 #include "lexer.h"
 #include "parser.h"
+#include "prune.h"
 #include "sema.h"
 #include "token.h"
 #include "type.h"
 #include "vm.h"
+#include "gc.h"
+#include "heapprof.h"
 #include "object/object.h"
 #include "literalpool.h"
 #include "module.h"
+#include "writer.h"
 
 char *filename = NULL;
 char *code;
@@ -20,18 +26,36 @@ MxcArg mxc_args;
 extern int errcnt;
 extern MxcObject **stackptr;
 
+static bool dump_code = false;
+
 static void mxc_init();
 static void mxc_destructor();
 
-void show_usage() { error("./maxc <Filename>"); }
+void show_usage() {
+    error("./maxc [--gc-<option>=<value>...] [--heap-profile[=<prefix>]] "
+          "[--dump-code] <Filename>");
+}
 
 int main(int argc, char **argv) {
     mxc_init(argc, argv);
 
-    if(argc == 1) {
+    int i = 1;
+    for(; i < argc && strncmp(argv[i], "--", 2) == 0; ++i) {
+        if(strcmp(argv[i], "--dump-code") == 0) {
+            dump_code = true;
+            continue;
+        }
+        if(!gc_option(argv[i]) && !heapprof_option(argv[i])) {
+            error("unknown option: %s", argv[i]);
+            show_usage();
+            return 1;
+        }
+    }
+
+    if(i == argc) {
         return mxc_main_repl();
     }
-    filename = argv[1];
+    filename = argv[i];
 
     code = read_file(filename);
     if(!code) {
@@ -45,8 +69,12 @@ int main(int argc, char **argv) {
 static void mxc_init(int argc, char **argv) {
     mxc_args = (MxcArg){argc, argv};
 
+    gc_init();
+    writer_init();
     setup_token();
     builtin_Init();
+    strmod_Init();
+    remod_Init();
     sema_init();
 }
 
@@ -80,6 +108,8 @@ int mxc_main(const char *src, const char *fname) {
         return 1;
     }
 
+    prune_unreachable(AST);
+
     Bytecode *iseq = compile(AST);
 
 #ifdef MXC_DEBUG
@@ -107,6 +137,14 @@ int mxc_main(const char *src, const char *fname) {
     puts(BOLD("--- exec result ---"));
 #endif
 
+    if(dump_code) {
+        for(size_t i = 0; i < iseq->len;) {
+            codedump(iseq->code, &i, ltable);
+            puts("");
+        }
+        return 0;
+    }
+
     Frame *global_frame = new_global_frame(iseq, ngvars);
     int exitcode = VM_run(global_frame);
 
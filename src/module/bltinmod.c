@@ -9,37 +9,68 @@
 #include "mem.h"
 #include "frame.h"
 #include "gc.h"
+#include "heapprof.h"
+#include "writer.h"
 
 Vector *Global_Cbltins;
 
-MxcValue print_core(Frame *f, MxcValue *sp, size_t narg) {
-    INTERN_UNUSE(f);
+static void print_values(MxcValue *sp, size_t narg) {
     for(int i = narg - 1; i >= 0; --i) {
-        MxcValue ob = sp[i];
-        MxcString *strob = ostr(mval2str(ob));
-        printf("%s", strob->str);
+        mval_write(&mxc_stdout, sp[i]);
     }
+}
+
+MxcValue print_core(Frame *f, MxcValue *sp, size_t narg) {
+    INTERN_UNUSE(f);
+    print_values(sp, narg);
 
     return mval_null;
 }
 
 MxcValue println_core(Frame *f, MxcValue *sp, size_t narg) {
     INTERN_UNUSE(f);
-    for(int i = narg - 1; i >= 0; --i) {
-        MxcValue ob = sp[i];
-        MxcString *strob = ostr(mval2str(ob));
-        printf("%s", strob->str);
-    }
-    putchar('\n');
+    print_values(sp, narg);
+    writer_putc(&mxc_stdout, '\n');
 
     return mval_null;
 }
 
+/* fills each "{}" of fmt with the next argument */
+static void format_values(MxcWriter *w, MxcString *fmt, MxcValue *sp, int narg) {
+    const char *s = STR_PTR(fmt);
+    size_t len = ITERABLE(fmt)->length;
+    int a = narg - 2;
+    size_t start = 0;
+
+    for(size_t i = 0; i + 1 < len; ++i) {
+        if(s[i] == '{' && s[i + 1] == '}' && a >= 0) {
+            writer_write(w, s + start, i - start);
+            mval_write(w, sp[a--]);
+            start = ++i + 1;
+        }
+    }
+    writer_write(w, s + start, len - start);
+}
+
+MxcValue format_core(Frame *f, MxcValue *sp, size_t narg) {
+    INTERN_UNUSE(f);
+    MxcString *fmt = ostr(sp[narg - 1]);
+    MxcWriter w;
+
+    writer_open_count(&w);
+    format_values(&w, fmt, sp, narg);
+
+    writer_open_mem(&w, w.len + 1);
+    format_values(&w, fmt, sp, narg);
+
+    return new_string(writer_cstr(&w), w.len);
+}
+
 MxcValue strlen_core(Frame *f, MxcValue *sp, size_t narg) {
     INTERN_UNUSE(f);
     INTERN_UNUSE(narg);
     MxcString *ob = ostr(sp[0]);
-    int len = ITERABLE(ob)->length;
+    int64_t len = str_nchars(ob);
     return mval_int(len);
 }
 
@@ -76,6 +107,7 @@ MxcValue readline_core(Frame *f, MxcValue *sp, size_t narg) {
     INTERN_UNUSE(sp);
     INTERN_UNUSE(narg);
     size_t cur;
+    writer_flush(&mxc_stdout);
     ReadStatus rs = intern_readline(1024, &cur, "", 0); 
     if(rs.err.eof) {
         // TODO
@@ -109,17 +141,28 @@ MxcValue gc_run_core(Frame *f, MxcValue *sp, size_t narg) {
     return mval_null;
 }
 
+MxcValue heap_snapshot_core(Frame *f, MxcValue *sp, size_t narg) {
+    INTERN_UNUSE(f);
+    INTERN_UNUSE(sp);
+    INTERN_UNUSE(narg);
+    heapprof_snapshot();
+
+    return mval_null;
+}
+
 void builtin_Init() {
     Global_Cbltins = New_Vector();
 
     define_cmethod(Global_Cbltins, "print", print_core, mxcty_none, mxcty_any_vararg, NULL);
     define_cmethod(Global_Cbltins, "println", println_core, mxcty_none, mxcty_any_vararg, NULL);
     define_cmethod(Global_Cbltins, "echo", println_core, mxcty_none, mxcty_any_vararg, NULL);
+    define_cmethod(Global_Cbltins, "format", format_core, mxcty_string, mxcty_any_vararg, NULL);
     define_cmethod(Global_Cbltins, "len", strlen_core, mxcty_int, mxcty_string, NULL);
     define_cmethod(Global_Cbltins, "tofloat", int_tofloat_core, mxcty_float, mxcty_int, NULL);
     define_cmethod(Global_Cbltins, "objectid", object_id_core, mxcty_int, mxcty_any, NULL);
     define_cmethod(Global_Cbltins, "exit", sys_exit_core, mxcty_none, mxcty_int, NULL);
     define_cmethod(Global_Cbltins, "readline", readline_core, mxcty_string, NULL);
     define_cmethod(Global_Cbltins, "gc_run", gc_run_core, mxcty_none, NULL);
+    define_cmethod(Global_Cbltins, "heap_snapshot", heap_snapshot_core, mxcty_none, NULL);
 }
 
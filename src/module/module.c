@@ -1,10 +1,48 @@
 #include <stdarg.h>
+#include <string.h>
 
 #include "module.h"
 #include "util.h"
 #include "internal.h"
 #include "object/funcobject.h"
 
+Vector *Global_Cmodules;
+
+MxcModule *new_cmodule(char *name) {
+    MxcModule *mod = xmalloc(sizeof(MxcModule));
+    mod->name = name;
+    mod->cbltins = New_Vector();
+
+    if(!Global_Cmodules) {
+        Global_Cmodules = New_Vector();
+    }
+    vec_push(Global_Cmodules, mod);
+
+    return mod;
+}
+
+MxcModule *search_cmodule(char *name) {
+    for(int i = 0; Global_Cmodules && i < Global_Cmodules->len; ++i) {
+        MxcModule *mod = (MxcModule *)Global_Cmodules->data[i];
+        if(strcmp(mod->name, name) == 0) {
+            return mod;
+        }
+    }
+
+    return NULL;
+}
+
+/* their functions are roots whether imported or not */
+void cmodule_visit(ob_visit_fn visit) {
+    for(int i = 0; Global_Cmodules && i < Global_Cmodules->len; ++i) {
+        Vector *fns = ((MxcModule *)Global_Cmodules->data[i])->cbltins;
+
+        for(int j = 0; j < fns->len; ++j) {
+            visit(&((MxcCBltin *)fns->data[j])->impl);
+        }
+    }
+}
+
 void define_cmethod(Vector *self,
                     char *name,
                     CFunction impl,
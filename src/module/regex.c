@@ -0,0 +1,1028 @@
+/* regular expression compiler, lazy DFA and Pike VM */
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "regex.h"
+#include "object/strobject.h"
+
+#define RE_MAX_INST     20000
+#define RE_MAX_REPEAT   1000
+#define RE_MAX_DEPTH    500
+#define DFA_MAX_STATES  1024
+
+typedef struct ByteSet {
+    uint32_t w[8];
+} ByteSet;
+
+#define SET_HAS(s, c)   ((s)->w[(uint8_t)(c) >> 5] >> ((uint8_t)(c) & 31) & 1)
+#define SET_ADD(s, c)   ((s)->w[(uint8_t)(c) >> 5] |= 1u << ((uint8_t)(c) & 31))
+
+enum {
+    I_BYTE,     /* a byte in set x */
+    I_SPLIT,    /* x, or else y */
+    I_JMP,
+    I_SAVE,     /* the position into capture slot x */
+    I_BOL,
+    I_EOL,
+    I_MATCH,
+};
+
+typedef struct ReInst {
+    uint8_t op;
+    int x;
+    int y;
+} ReInst;
+
+typedef struct DState {
+    int *pcs;       /* sorted BYTE, EOL and MATCH instructions */
+    int n;
+    uint32_t hash;
+    bool accept;
+    int8_t eol;     /* accepts at the end of input, -1 until known */
+    int next[256];  /* -1 until known */
+} DState;
+
+typedef struct Dfa {
+    bool anchored;
+    DState **states;
+    int nstates;
+    int *table;     /* state indices by hash, -1 if empty */
+    int start;
+} Dfa;
+
+struct Regex {
+    ReInst *prog;
+    int ninst;
+    ByteSet *sets;
+    int nsets;
+    int ncap;
+    Dfa dfa[2];     /* anchored, unanchored */
+    /* scratch space */
+    unsigned *seen;
+    unsigned gen;
+    int *stack;
+    int *buf;
+    int *threads[2];
+    size_t *caps[2];
+};
+
+/* parser */
+
+enum {
+    N_EMPTY,
+    N_SET,
+    N_CAT,
+    N_ALT,
+    N_STAR,
+    N_PLUS,
+    N_QUEST,
+    N_GROUP,
+    N_BOL,
+    N_EOL,
+};
+
+typedef struct Node {
+    uint8_t kind;
+    bool greedy;
+    int a;          /* child, or set */
+    int b;          /* child, or group */
+} Node;
+
+typedef struct Parser {
+    const char *p;
+    const char *end;
+    Node *nodes;
+    int nnodes;
+    int nodecap;
+    ByteSet *sets;
+    int nsets;
+    int setcap;
+    int ngroups;
+    int depth;
+    const char *err;
+} Parser;
+
+static int node(Parser *p, int kind, int a, int b) {
+    if(p->nnodes == p->nodecap) {
+        p->nodecap = p->nodecap ? p->nodecap * 2 : 64;
+        p->nodes = realloc(p->nodes, sizeof(Node) * p->nodecap);
+    }
+    Node *n = &p->nodes[p->nnodes];
+    n->kind = kind;
+    n->greedy = true;
+    n->a = a;
+    n->b = b;
+
+    return p->nnodes++;
+}
+
+static int new_set(Parser *p, ByteSet *s) {
+    if(p->nsets == p->setcap) {
+        p->setcap = p->setcap ? p->setcap * 2 : 16;
+        p->sets = realloc(p->sets, sizeof(ByteSet) * p->setcap);
+    }
+    p->sets[p->nsets] = *s;
+
+    return node(p, N_SET, p->nsets++, 0);
+}
+
+static int byte_range(Parser *p, int lo, int hi) {
+    ByteSet s = {{0}};
+    for(int c = lo; c <= hi; ++c) {
+        SET_ADD(&s, c);
+    }
+
+    return new_set(p, &s);
+}
+
+static int cat(Parser *p, int a, int b) {
+    if(a < 0) return b;
+    if(b < 0) return a;
+    return node(p, N_CAT, a, b);
+}
+
+static int alt(Parser *p, int a, int b) {
+    if(a < 0) return b;
+    if(b < 0) return a;
+    return node(p, N_ALT, a, b);
+}
+
+/* the bytes of c, one after another */
+static int literal(Parser *p, uint32_t c) {
+    char enc[4];
+    size_t n = utf8_encode(enc, c);
+    int res = -1;
+
+    for(size_t i = 0; i < n; ++i) {
+        res = cat(p, res, byte_range(p, (uint8_t)enc[i], (uint8_t)enc[i]));
+    }
+
+    return res;
+}
+
+typedef struct CpRange {
+    uint32_t lo;
+    uint32_t hi;
+} CpRange;
+
+/* code points of a class, as ranges */
+typedef struct CpSet {
+    CpRange *r;
+    int n;
+    int cap;
+} CpSet;
+
+#define CP_MAX  0x10ffff
+
+static void cp_add(CpSet *s, uint32_t lo, uint32_t hi) {
+    if(s->n == s->cap) {
+        s->cap = s->cap ? s->cap * 2 : 8;
+        s->r = realloc(s->r, sizeof(CpRange) * s->cap);
+    }
+    s->r[s->n++] = (CpRange){ lo, hi };
+}
+
+static int cmp_range(const void *a, const void *b) {
+    uint32_t x = ((const CpRange *)a)->lo;
+    uint32_t y = ((const CpRange *)b)->lo;
+    return (x > y) - (x < y);
+}
+
+/* sorted, with overlapping and adjacent ranges merged */
+static void cp_normalize(CpSet *s) {
+    int n = 0;
+
+    qsort(s->r, s->n, sizeof(CpRange), cmp_range);
+    for(int i = 0; i < s->n; ++i) {
+        if(n > 0 && s->r[i].lo <= s->r[n - 1].hi + 1) {
+            if(s->r[i].hi > s->r[n - 1].hi) s->r[n - 1].hi = s->r[i].hi;
+        }
+        else {
+            s->r[n++] = s->r[i];
+        }
+    }
+    s->n = n;
+}
+
+static void cp_negate(CpSet *s) {
+    CpSet neg = {0};
+    uint32_t next = 0;
+
+    cp_normalize(s);
+    for(int i = 0; i < s->n; ++i) {
+        if(s->r[i].lo > next) cp_add(&neg, next, s->r[i].lo - 1);
+        next = s->r[i].hi + 1;
+    }
+    if(next <= CP_MAX) cp_add(&neg, next, CP_MAX);
+
+    free(s->r);
+    *s = neg;
+}
+
+/*
+ *  The UTF-8 sequences of the code points lo..hi, as alternatives of
+ *  byte ranges. The range is split until every byte of the sequences
+ *  of lo and hi bounds a range of its own.
+ */
+static int seq_range(Parser *p, uint32_t lo, uint32_t hi) {
+    static const uint32_t maxs[] = { 0x7f, 0x7ff, 0xffff };
+
+    if(lo > hi) return -1;
+    if(lo <= 0xdfff && hi >= 0xd800) {     /* no surrogates */
+        int a = lo < 0xd800 ? seq_range(p, lo, 0xd7ff) : -1;
+        int b = hi > 0xdfff ? seq_range(p, 0xe000, hi) : -1;
+        return alt(p, a, b);
+    }
+    for(int i = 0; i < 3; ++i) {
+        if(lo <= maxs[i] && hi > maxs[i]) {
+            return alt(p, seq_range(p, lo, maxs[i]),
+                          seq_range(p, maxs[i] + 1, hi));
+        }
+    }
+    for(int i = 1; i < 4; ++i) {
+        uint32_t m = (1u << (6 * i)) - 1;
+        if((lo & ~m) == (hi & ~m)) continue;
+        if(lo & m) {
+            return alt(p, seq_range(p, lo, lo | m),
+                          seq_range(p, (lo | m) + 1, hi));
+        }
+        if((hi & m) != m) {
+            return alt(p, seq_range(p, lo, (hi & ~m) - 1),
+                          seq_range(p, hi & ~m, hi));
+        }
+    }
+
+    char a[4], b[4];
+    size_t n = utf8_encode(a, lo);
+    utf8_encode(b, hi);
+    int res = -1;
+    for(size_t i = 0; i < n; ++i) {
+        res = cat(p, res, byte_range(p, (uint8_t)a[i], (uint8_t)b[i]));
+    }
+
+    return res;
+}
+
+/* ASCII members share one byte set; the rest are byte sequences */
+static int class_node(Parser *p, CpSet *s) {
+    ByteSet ascii = {{0}};
+    bool hasascii = false;
+    int res = -1;
+
+    cp_normalize(s);
+    for(int i = 0; i < s->n; ++i) {
+        uint32_t lo = s->r[i].lo;
+        for(; lo <= s->r[i].hi && lo < 0x80; ++lo) {
+            SET_ADD(&ascii, lo);
+            hasascii = true;
+        }
+        if(lo <= s->r[i].hi) {
+            res = alt(p, res, seq_range(p, lo, s->r[i].hi));
+        }
+    }
+    if(hasascii) res = alt(p, new_set(p, &ascii), res);
+    free(s->r);
+
+    /* matches nothing */
+    if(res < 0) {
+        ByteSet none = {{0}};
+        res = new_set(p, &none);
+    }
+
+    return res;
+}
+
+static bool is_word(int c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+           (c >= '0' && c <= '9') || c == '_';
+}
+
+/* \d \w \s are ASCII; their negations take every non-ASCII char */
+static bool escape_class(char e, CpSet *set) {
+    bool neg = e == 'D' || e == 'W' || e == 'S';
+    CpSet s = {0};
+
+    switch(neg ? e - 'A' + 'a' : e) {
+    case 'd':
+        cp_add(&s, '0', '9');
+        break;
+    case 'w':
+        cp_add(&s, '0', '9');
+        cp_add(&s, 'A', 'Z');
+        cp_add(&s, '_', '_');
+        cp_add(&s, 'a', 'z');
+        break;
+    case 's':
+        cp_add(&s, '\t', '\r');
+        cp_add(&s, ' ', ' ');
+        break;
+    default:
+        return false;
+    }
+
+    if(neg) cp_negate(&s);
+    for(int i = 0; i < s.n; ++i) {
+        cp_add(set, s.r[i].lo, s.r[i].hi);
+    }
+    free(s.r);
+
+    return true;
+}
+
+static bool escape_char(Parser *p, char e, uint32_t *c) {
+    switch(e) {
+    case 'n': *c = '\n'; return true;
+    case 't': *c = '\t'; return true;
+    case 'r': *c = '\r'; return true;
+    case 'f': *c = '\f'; return true;
+    case 'v': *c = '\v'; return true;
+    case '0': *c = '\0'; return true;
+    }
+    if(is_word(e)) {
+        p->err = "unknown escape";
+        return false;
+    }
+    *c = (uint8_t)e;
+
+    return true;
+}
+
+static bool read_char(Parser *p, uint32_t *c) {
+    size_t n = utf8_seqlen(*p->p);
+
+    if((size_t)(p->end - p->p) < n ||
+       utf8_scan(p->p, n, NULL) == STR_ENC_BYTES) {
+        p->err = "invalid UTF-8";
+        return false;
+    }
+    *c = utf8_decode(p->p);
+    p->p += n;
+
+    return true;
+}
+
+/* one member of a class, escaped or not */
+static bool class_char(Parser *p, uint32_t *c) {
+    if(*p->p != '\\') return read_char(p, c);
+
+    if(++p->p == p->end) {
+        p->err = "trailing backslash";
+        return false;
+    }
+    return escape_char(p, *p->p++, c);
+}
+
+static int parse_class(Parser *p) {
+    CpSet set = {0};
+    bool neg = false;
+
+    if(p->p < p->end && *p->p == '^') {
+        neg = true;
+        p->p++;
+    }
+
+    for(bool first = true; p->p < p->end && (*p->p != ']' || first);
+        first = false) {
+        if(*p->p == '\\' && p->p + 1 < p->end &&
+           escape_class(p->p[1], &set)) {
+            p->p += 2;
+            continue;
+        }
+
+        uint32_t lo, hi;
+        if(!class_char(p, &lo)) goto err;
+        hi = lo;
+        if(p->p + 1 < p->end && *p->p == '-' && p->p[1] != ']') {
+            p->p++;
+            if(!class_char(p, &hi)) goto err;
+            if(hi < lo) {
+                p->err = "bad range in class";
+                goto err;
+            }
+        }
+        cp_add(&set, lo, hi);
+    }
+
+    if(p->p == p->end) {
+        p->err = "missing ]";
+        goto err;
+    }
+    p->p++;
+
+    if(neg) cp_negate(&set);
+    return class_node(p, &set);
+
+err:
+    free(set.r);
+    return -1;
+}
+
+static int parse_alt(Parser *);
+
+static int parse_atom(Parser *p) {
+    char c = *p->p++;
+    uint32_t ch;
+
+    switch(c) {
+    case '(': {
+        int group = 0;
+        if(p->end - p->p >= 2 && p->p[0] == '?' && p->p[1] == ':') {
+            p->p += 2;
+        }
+        else {
+            group = ++p->ngroups;
+        }
+        if(++p->depth > RE_MAX_DEPTH) {
+            p->err = "too deeply nested";
+            return -1;
+        }
+        int a = parse_alt(p);
+        p->depth--;
+        if(p->err) return -1;
+        if(p->p == p->end || *p->p != ')') {
+            p->err = "missing )";
+            return -1;
+        }
+        p->p++;
+        return group ? node(p, N_GROUP, a, group) : a;
+    }
+    case '[':
+        return parse_class(p);
+    case '.': {
+        CpSet set = {0};
+        cp_add(&set, '\n', '\n');
+        cp_negate(&set);
+        return class_node(p, &set);
+    }
+    case '^':
+        return node(p, N_BOL, 0, 0);
+    case '$':
+        return node(p, N_EOL, 0, 0);
+    case '*': case '+': case '?': case '{':
+        p->err = "nothing to repeat";
+        return -1;
+    case '\\': {
+        if(p->p == p->end) {
+            p->err = "trailing backslash";
+            return -1;
+        }
+        CpSet set = {0};
+        char e = *p->p++;
+        if(escape_class(e, &set)) {
+            return class_node(p, &set);
+        }
+        if(!escape_char(p, e, &ch)) return -1;
+        return literal(p, ch);
+    }
+    default:
+        p->p--;
+        if(!read_char(p, &ch)) return -1;
+        return literal(p, ch);
+    }
+}
+
+static bool read_count(Parser *p, int *n) {
+    if(p->p == p->end || *p->p < '0' || *p->p > '9') return false;
+
+    *n = 0;
+    while(p->p < p->end && *p->p >= '0' && *p->p <= '9') {
+        *n = *n * 10 + (*p->p++ - '0');
+        if(*n > RE_MAX_REPEAT) return false;
+    }
+
+    return true;
+}
+
+/* a{m}, a{m,} and a{m,n}, spelled out with copies of a */
+static int parse_count(Parser *p, int a) {
+    int min, max;
+
+    p->p++;
+    if(!read_count(p, &min)) goto bad;
+    max = min;
+    if(p->p < p->end && *p->p == ',') {
+        p->p++;
+        max = -1;
+        if(p->p < p->end && *p->p != '}' && !read_count(p, &max)) goto bad;
+    }
+    if(p->p == p->end || *p->p != '}' || (max >= 0 && max < min)) goto bad;
+    p->p++;
+
+    bool greedy = true;
+    if(p->p < p->end && *p->p == '?') {
+        greedy = false;
+        p->p++;
+    }
+
+    int res = -1;
+    for(int i = 0; i < min; ++i) {
+        res = cat(p, res, a);
+    }
+    if(max < 0) {
+        int star = node(p, N_STAR, a, 0);
+        p->nodes[star].greedy = greedy;
+        res = cat(p, res, star);
+    }
+    else {
+        int opt = -1;
+        for(int i = min; i < max; ++i) {
+            opt = node(p, N_QUEST, cat(p, a, opt), 0);
+            p->nodes[opt].greedy = greedy;
+        }
+        res = cat(p, res, opt);
+    }
+
+    return res < 0 ? node(p, N_EMPTY, 0, 0) : res;
+
+bad:
+    p->err = "bad repetition";
+    return -1;
+}
+
+static int parse_repeat(Parser *p) {
+    int a = parse_atom(p);
+
+    while(!p->err && p->p < p->end) {
+        int kind;
+        switch(*p->p) {
+        case '*': kind = N_STAR; break;
+        case '+': kind = N_PLUS; break;
+        case '?': kind = N_QUEST; break;
+        case '{':
+            a = parse_count(p, a);
+            continue;
+        default:
+            return a;
+        }
+        p->p++;
+        a = node(p, kind, a, 0);
+        if(p->p < p->end && *p->p == '?') {
+            p->nodes[a].greedy = false;
+            p->p++;
+        }
+    }
+
+    return a;
+}
+
+static int parse_cat(Parser *p) {
+    int res = -1;
+
+    while(!p->err && p->p < p->end && *p->p != '|' && *p->p != ')') {
+        res = cat(p, res, parse_repeat(p));
+    }
+
+    return res < 0 ? node(p, N_EMPTY, 0, 0) : res;
+}
+
+static int parse_alt(Parser *p) {
+    int res = parse_cat(p);
+
+    while(!p->err && p->p < p->end && *p->p == '|') {
+        p->p++;
+        res = node(p, N_ALT, res, parse_cat(p));
+    }
+
+    return res;
+}
+
+/* code generation */
+
+static int emit(Regex *re, int op, int x, int y) {
+    if(re->ninst >= RE_MAX_INST) return re->ninst;
+
+    re->prog[re->ninst] = (ReInst){ op, x, y };
+    return re->ninst++;
+}
+
+static void gen(Regex *re, Parser *p, int ni) {
+    Node *n = &p->nodes[ni];
+    int l1, l2;
+
+    if(re->ninst >= RE_MAX_INST) return;
+
+    switch(n->kind) {
+    case N_EMPTY:
+        break;
+    case N_SET:
+        emit(re, I_BYTE, n->a, 0);
+        break;
+    case N_CAT:
+        gen(re, p, n->a);
+        gen(re, p, n->b);
+        break;
+    case N_ALT:
+        l1 = emit(re, I_SPLIT, 0, 0);
+        re->prog[l1].x = re->ninst;
+        gen(re, p, n->a);
+        l2 = emit(re, I_JMP, 0, 0);
+        re->prog[l1].y = re->ninst;
+        gen(re, p, n->b);
+        re->prog[l2].x = re->ninst;
+        break;
+    case N_STAR:
+        l1 = emit(re, I_SPLIT, 0, 0);
+        gen(re, p, n->a);
+        emit(re, I_JMP, l1, 0);
+        re->prog[l1].x = n->greedy ? l1 + 1 : re->ninst;
+        re->prog[l1].y = n->greedy ? re->ninst : l1 + 1;
+        break;
+    case N_PLUS:
+        l1 = re->ninst;
+        gen(re, p, n->a);
+        emit(re, I_SPLIT, n->greedy ? l1 : re->ninst + 1,
+                          n->greedy ? re->ninst + 1 : l1);
+        break;
+    case N_QUEST:
+        l1 = emit(re, I_SPLIT, 0, 0);
+        gen(re, p, n->a);
+        re->prog[l1].x = n->greedy ? l1 + 1 : re->ninst;
+        re->prog[l1].y = n->greedy ? re->ninst : l1 + 1;
+        break;
+    case N_GROUP:
+        emit(re, I_SAVE, n->b * 2, 0);
+        gen(re, p, n->a);
+        emit(re, I_SAVE, n->b * 2 + 1, 0);
+        break;
+    case N_BOL:
+        emit(re, I_BOL, 0, 0);
+        break;
+    case N_EOL:
+        emit(re, I_EOL, 0, 0);
+        break;
+    }
+}
+
+Regex *regex_compile(const char *pat, size_t len, const char **err) {
+    Parser p = {0};
+    p.p = pat;
+    p.end = pat + len;
+
+    int root = parse_alt(&p);
+    if(!p.err && p.p < p.end) {
+        p.err = "unmatched )";
+    }
+    if(p.err) {
+        *err = p.err;
+        free(p.nodes);
+        free(p.sets);
+        return NULL;
+    }
+
+    Regex *re = calloc(1, sizeof(Regex));
+    re->prog = malloc(sizeof(ReInst) * (RE_MAX_INST + 1));  /* + the overflow */
+    re->ncap = (p.ngroups + 1) * 2;
+    emit(re, I_SAVE, 0, 0);
+    gen(re, &p, root);
+    emit(re, I_SAVE, 1, 0);
+    emit(re, I_MATCH, 0, 0);
+    free(p.nodes);
+
+    if(re->ninst >= RE_MAX_INST) {
+        *err = "pattern too large";
+        free(p.sets);
+        free(re->prog);
+        free(re);
+        return NULL;
+    }
+
+    re->prog = realloc(re->prog, sizeof(ReInst) * re->ninst);
+    re->sets = p.sets;
+    re->nsets = p.nsets;
+    re->seen = calloc(re->ninst, sizeof(unsigned));
+    re->stack = malloc(sizeof(int) * (re->ninst * 2 + 1));
+    re->buf = malloc(sizeof(int) * re->ninst);
+    for(int i = 0; i < 2; ++i) {
+        re->dfa[i].anchored = i == 0;
+        re->dfa[i].start = -1;
+    }
+
+    return re;
+}
+
+static void dfa_reset(Dfa *d) {
+    for(int i = 0; i < d->nstates; ++i) {
+        free(d->states[i]->pcs);
+        free(d->states[i]);
+    }
+    d->nstates = 0;
+    d->start = -1;
+    if(d->table) {
+        memset(d->table, -1, sizeof(int) * DFA_MAX_STATES * 2);
+    }
+}
+
+void regex_free(Regex *re) {
+    for(int i = 0; i < 2; ++i) {
+        dfa_reset(&re->dfa[i]);
+        free(re->dfa[i].states);
+        free(re->dfa[i].table);
+        free(re->threads[i]);
+        free(re->caps[i]);
+    }
+    free(re->prog);
+    free(re->sets);
+    free(re->seen);
+    free(re->stack);
+    free(re->buf);
+    free(re);
+}
+
+int regex_ncap(Regex *re) {
+    return re->ncap;
+}
+
+static void next_gen(Regex *re) {
+    if(++re->gen == 0) {
+        memset(re->seen, 0, sizeof(unsigned) * re->ninst);
+        re->gen = 1;
+    }
+}
+
+/*
+ *  Adds to out the instructions reachable from pc without reading a
+ *  byte. Each is added once per generation.
+ */
+static void closure(Regex *re, int pc, bool bol, bool eol, int *out, int *n) {
+    int top = 0;
+    re->stack[top++] = pc;
+
+    while(top) {
+        pc = re->stack[--top];
+        if(re->seen[pc] == re->gen) continue;
+        re->seen[pc] = re->gen;
+
+        ReInst *in = &re->prog[pc];
+        switch(in->op) {
+        case I_JMP:
+            re->stack[top++] = in->x;
+            break;
+        case I_SPLIT:
+            re->stack[top++] = in->y;
+            re->stack[top++] = in->x;
+            break;
+        case I_SAVE:
+            re->stack[top++] = pc + 1;
+            break;
+        case I_BOL:
+            if(bol) re->stack[top++] = pc + 1;
+            break;
+        case I_EOL:
+            if(eol) re->stack[top++] = pc + 1;
+            else out[(*n)++] = pc;
+            break;
+        default:
+            out[(*n)++] = pc;
+            break;
+        }
+    }
+}
+
+/* DFA */
+
+static int cmp_pc(const void *a, const void *b) {
+    return *(const int *)a - *(const int *)b;
+}
+
+static uint32_t hash_pcs(int *pcs, int n) {
+    uint32_t h = 2166136261u;
+    for(int i = 0; i < n; ++i) {
+        h = (h ^ (uint32_t)pcs[i]) * 16777619u;
+    }
+
+    return h;
+}
+
+/* the state for the set of instructions pcs, made if new */
+static int dfa_state(Regex *re, Dfa *d, int *pcs, int n) {
+    const size_t mask = DFA_MAX_STATES * 2 - 1;
+
+    qsort(pcs, n, sizeof(int), cmp_pc);
+    uint32_t h = hash_pcs(pcs, n);
+
+    if(!d->table) {
+        d->table = malloc(sizeof(int) * DFA_MAX_STATES * 2);
+        memset(d->table, -1, sizeof(int) * DFA_MAX_STATES * 2);
+        d->states = malloc(sizeof(DState *) * DFA_MAX_STATES);
+    }
+
+    size_t i = h & mask;
+    for(int si; (si = d->table[i]) >= 0; i = (i + 1) & mask) {
+        DState *s = d->states[si];
+        if(s->hash == h && s->n == n &&
+           memcmp(s->pcs, pcs, sizeof(int) * n) == 0)
+            return si;
+    }
+
+    DState *s = malloc(sizeof(DState));
+    s->pcs = malloc(sizeof(int) * (n ? n : 1));
+    memcpy(s->pcs, pcs, sizeof(int) * n);
+    s->n = n;
+    s->hash = h;
+    s->accept = false;
+    s->eol = -1;
+    memset(s->next, -1, sizeof(s->next));
+    for(int k = 0; k < n; ++k) {
+        if(re->prog[pcs[k]].op == I_MATCH) s->accept = true;
+    }
+
+    d->states[d->nstates] = s;
+    d->table[i] = d->nstates;
+
+    return d->nstates++;
+}
+
+static int dfa_start(Regex *re, Dfa *d) {
+    if(d->start < 0) {
+        int n = 0;
+        next_gen(re);
+        closure(re, 0, true, false, re->buf, &n);
+        d->start = dfa_state(re, d, re->buf, n);
+    }
+
+    return d->start;
+}
+
+/*
+ *  The state after reading c in state si. A search also starts a new
+ *  attempt at every byte. When the cache is full it is emptied.
+ */
+static int dfa_step(Regex *re, Dfa *d, int si, uint8_t c) {
+    DState *s = d->states[si];
+    int n = 0;
+
+    next_gen(re);
+    for(int i = 0; i < s->n; ++i) {
+        ReInst *in = &re->prog[s->pcs[i]];
+        if(in->op == I_BYTE && SET_HAS(&re->sets[in->x], c)) {
+            closure(re, s->pcs[i] + 1, false, false, re->buf, &n);
+        }
+    }
+    if(!d->anchored) {
+        closure(re, 0, false, false, re->buf, &n);
+    }
+
+    if(d->nstates == DFA_MAX_STATES) {
+        dfa_reset(d);
+        return dfa_state(re, d, re->buf, n);
+    }
+
+    int next = dfa_state(re, d, re->buf, n);
+    s->next[c] = next;
+
+    return next;
+}
+
+/* whether s matches at the end of input, where $ holds */
+static bool dfa_accepts_end(Regex *re, DState *s, bool bol) {
+    if(s->accept) return true;
+
+    if(s->eol < 0 || bol) {
+        int n = 0;
+        bool acc = false;
+
+        next_gen(re);
+        for(int i = 0; i < s->n; ++i) {
+            if(re->prog[s->pcs[i]].op == I_EOL) {
+                closure(re, s->pcs[i] + 1, bol, true, re->buf, &n);
+            }
+        }
+        for(int i = 0; i < n; ++i) {
+            if(re->prog[re->buf[i]].op == I_MATCH) acc = true;
+        }
+
+        /* ^ holds only for the empty input, which is not cached */
+        if(bol) return acc;
+        s->eol = acc;
+    }
+
+    return s->eol;
+}
+
+static bool dfa_run(Regex *re, Dfa *d, const uint8_t *str, size_t len) {
+    int si = dfa_start(re, d);
+
+    for(size_t i = 0; i < len; ++i) {
+        DState *s = d->states[si];
+        if(s->accept && !d->anchored) return true;
+        if(s->n == 0) return false;
+
+        int next = s->next[str[i]];
+        si = next >= 0 ? next : dfa_step(re, d, si, str[i]);
+    }
+
+    return dfa_accepts_end(re, d->states[si], len == 0);
+}
+
+/* whether s contains a match */
+bool regex_test(Regex *re, const char *s, size_t len) {
+    return dfa_run(re, &re->dfa[1], (const uint8_t *)s, len);
+}
+
+/* whether all of s matches */
+bool regex_fullmatch(Regex *re, const char *s, size_t len) {
+    return dfa_run(re, &re->dfa[0], (const uint8_t *)s, len);
+}
+
+/* Pike VM */
+
+typedef struct Threads {
+    int *pcs;
+    size_t *caps;   /* ncap slots for each instruction */
+    int n;
+} Threads;
+
+static void add_thread(Regex *re, Threads *l, int pc, size_t *caps,
+                       size_t pos, size_t len) {
+    if(re->seen[pc] == re->gen) return;
+    re->seen[pc] = re->gen;
+
+    ReInst *in = &re->prog[pc];
+    switch(in->op) {
+    case I_JMP:
+        add_thread(re, l, in->x, caps, pos, len);
+        break;
+    case I_SPLIT:
+        add_thread(re, l, in->x, caps, pos, len);
+        add_thread(re, l, in->y, caps, pos, len);
+        break;
+    case I_SAVE: {
+        size_t old = caps[in->x];
+        caps[in->x] = pos;
+        add_thread(re, l, pc + 1, caps, pos, len);
+        caps[in->x] = old;
+        break;
+    }
+    case I_BOL:
+        if(pos == 0) add_thread(re, l, pc + 1, caps, pos, len);
+        break;
+    case I_EOL:
+        if(pos == len) add_thread(re, l, pc + 1, caps, pos, len);
+        break;
+    default:
+        l->pcs[l->n++] = pc;
+        memcpy(l->caps + (size_t)pc * re->ncap, caps,
+               sizeof(size_t) * re->ncap);
+        break;
+    }
+}
+
+/*
+ *  The leftmost match starting at or after start, preferring the
+ *  alternatives and repetitions the way Perl does. On success caps
+ *  holds the offsets of the groups, RE_NOPOS for the unset ones.
+ */
+bool regex_exec(Regex *re, const char *s, size_t len, size_t start,
+                size_t *caps) {
+    size_t init[re->ncap];
+    Threads cur, next;
+    bool matched = false;
+
+    if(!re->threads[0]) {
+        for(int i = 0; i < 2; ++i) {
+            re->threads[i] = malloc(sizeof(int) * re->ninst);
+            re->caps[i] = malloc(sizeof(size_t) * re->ninst * re->ncap);
+        }
+    }
+    cur = (Threads){ re->threads[0], re->caps[0], 0 };
+    next = (Threads){ re->threads[1], re->caps[1], 0 };
+
+    for(int i = 0; i < re->ncap; ++i) {
+        init[i] = RE_NOPOS;
+    }
+    next_gen(re);
+    add_thread(re, &cur, 0, init, start, len);
+
+    for(size_t pos = start; ; ++pos) {
+        next_gen(re);
+        next.n = 0;
+
+        for(int i = 0; i < cur.n; ++i) {
+            int pc = cur.pcs[i];
+            ReInst *in = &re->prog[pc];
+            size_t *tc = cur.caps + (size_t)pc * re->ncap;
+
+            if(in->op == I_MATCH) {
+                memcpy(caps, tc, sizeof(size_t) * re->ncap);
+                matched = true;
+                break;      /* the threads after it are worse */
+            }
+            if(pos < len && SET_HAS(&re->sets[in->x], s[pos])) {
+                add_thread(re, &next, pc + 1, tc, pos + 1, len);
+            }
+        }
+
+        if(pos >= len) break;
+        if(!matched) {
+            add_thread(re, &next, 0, init, pos + 1, len);
+        }
+
+        Threads t = cur;
+        cur = next;
+        next = t;
+        if(cur.n == 0 && matched) break;
+    }
+
+    return matched;
+}
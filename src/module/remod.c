@@ -0,0 +1,225 @@
+/* native re module: regular expressions over strings */
+#include <stdlib.h>
+#include <string.h>
+
+#include "module.h"
+#include "internal.h"
+#include "regex.h"
+#include "object/strobject.h"
+#include "object/listobject.h"
+#include "error/runtime-err.h"
+#include "vm.h"
+#include "mem.h"
+#include "gc.h"
+#include "frame.h"
+
+/* arguments are pushed last first */
+
+/*
+ *  Literal patterns are compiled once. Their strings share the interned
+ *  bytes, so the address names the literal. Any other pattern is
+ *  compiled again unless it repeats the previous one.
+ */
+typedef struct LitPattern {
+    const char *str;
+    Regex *re;
+} LitPattern;
+
+static LitPattern *lits;
+static size_t nlits;
+static size_t litcap;
+
+static char *last_src;
+static size_t last_len;
+static Regex *last_re;
+
+static size_t lit_slot(LitPattern *t, size_t cap, const char *s) {
+    size_t i = ((uintptr_t)s >> 3) & (cap - 1);
+    while(t[i].str && t[i].str != s) i = (i + 1) & (cap - 1);
+
+    return i;
+}
+
+static void lits_grow() {
+    size_t cap = litcap ? litcap * 2 : 64;
+    LitPattern *t = calloc(cap, sizeof(LitPattern));
+
+    for(size_t i = 0; i < litcap; ++i) {
+        if(lits[i].str) t[lit_slot(t, cap, lits[i].str)] = lits[i];
+    }
+
+    free(lits);
+    lits = t;
+    litcap = cap;
+}
+
+static Regex *compile(Frame *f, MxcValue pat) {
+    MxcString *p = ostr(pat);
+    size_t len = ITERABLE(p)->length;
+    LitPattern *lit = NULL;
+    const char *err;
+
+    if(p->interned) {
+        if(nlits * 2 >= litcap) lits_grow();
+        lit = &lits[lit_slot(lits, litcap, p->str)];
+        if(lit->str) return lit->re;
+    }
+    else if(last_re && last_len == len && memcmp(last_src, STR_PTR(p), len) == 0) {
+        return last_re;
+    }
+
+    Regex *re = regex_compile(STR_PTR(p), len, &err);
+    if(!re) {
+        raise_badpattern(f, pat, err);
+        return NULL;
+    }
+
+    if(lit) {
+        lit->str = p->str;
+        lit->re = re;
+        nlits++;
+    }
+    else {
+        if(last_re) {
+            regex_free(last_re);
+            free(last_src);
+        }
+        last_src = malloc(len + 1);
+        memcpy(last_src, STR_PTR(p), len);
+        last_len = len;
+        last_re = re;
+    }
+
+    return re;
+}
+
+MxcValue re_test_core(Frame *f, MxcValue *sp, size_t narg) {
+    INTERN_UNUSE(narg);
+    MxcString *s = ostr(sp[1]);
+    Regex *re = compile(f, sp[0]);
+    if(!re) return mval_null;
+
+    return regex_test(re, STR_PTR(s), ITERABLE(s)->length) ? mval_true
+                                                       : mval_false;
+}
+
+MxcValue re_fullmatch_core(Frame *f, MxcValue *sp, size_t narg) {
+    INTERN_UNUSE(narg);
+    MxcString *s = ostr(sp[1]);
+    Regex *re = compile(f, sp[0]);
+    if(!re) return mval_null;
+
+    return regex_fullmatch(re, STR_PTR(s), ITERABLE(s)->length) ? mval_true
+                                                            : mval_false;
+}
+
+MxcValue re_find_core(Frame *f, MxcValue *sp, size_t narg) {
+    INTERN_UNUSE(narg);
+    MxcString *s = ostr(sp[1]);
+    size_t len = ITERABLE(s)->length;
+    Regex *re = compile(f, sp[0]);
+    if(!re) return mval_null;
+
+    /* the DFA turns most non-matching strings away first */
+    if(!regex_test(re, STR_PTR(s), len)) return mval_int(-1);
+
+    size_t caps[regex_ncap(re)];
+    regex_exec(re, STR_PTR(s), len, 0, caps);
+
+    return mval_int(str_cpos(s, caps[0]));
+}
+
+static MxcValue new_str_list(size_t n) {
+    MxcValue list = new_list(n);
+    for(size_t i = 0; i < n; ++i) {
+        olist(list)->elem[i] = mval_null;
+    }
+
+    return list;
+}
+
+/* the pieces are slices of str, given as byte offsets begin, end, ... */
+static MxcValue slice_list(MxcValue str, size_t *offs, size_t n) {
+    HandleScope scope = GC_SCOPE_OPEN();
+    MxcValue *s = gc_handle(str);
+    MxcValue *list = gc_handle(new_str_list(n));
+
+    for(size_t i = 0; i < n; ++i) {
+        size_t b = offs[i * 2];
+        size_t e = offs[i * 2 + 1];
+        MxcValue piece = b == RE_NOPOS ? new_string_static("", 0)
+                                       : str_slice(*s, b, e - b);
+        olist(*list)->elem[i] = piece;
+        GC_WRITE_BARRIER(olist(*list), piece);
+    }
+
+    MxcValue res = *list;
+    GC_SCOPE_CLOSE(scope);
+    return res;
+}
+
+/* the whole match, then each group; an empty list without a match */
+MxcValue re_captures_core(Frame *f, MxcValue *sp, size_t narg) {
+    INTERN_UNUSE(narg);
+    MxcString *s = ostr(sp[1]);
+    size_t len = ITERABLE(s)->length;
+    Regex *re = compile(f, sp[0]);
+    if(!re) return mval_null;
+
+    int ncap = regex_ncap(re);
+    size_t caps[ncap];
+    if(!regex_test(re, STR_PTR(s), len) ||
+       !regex_exec(re, STR_PTR(s), len, 0, caps)) {
+        return new_str_list(0);
+    }
+
+    return slice_list(sp[1], caps, ncap / 2);
+}
+
+/* every non-overlapping match, left to right */
+MxcValue re_findall_core(Frame *f, MxcValue *sp, size_t narg) {
+    INTERN_UNUSE(narg);
+    MxcString *s = ostr(sp[1]);
+    size_t len = ITERABLE(s)->length;
+    Regex *re = compile(f, sp[0]);
+    if(!re) return mval_null;
+
+    if(!regex_test(re, STR_PTR(s), len)) return new_str_list(0);
+
+    size_t caps[regex_ncap(re)];
+    size_t *offs = NULL;
+    size_t n = 0;
+    size_t cap = 0;
+    size_t pos = 0;
+
+    while(pos <= len && regex_exec(re, STR_PTR(s), len, pos, caps)) {
+        if(n == cap) {
+            cap = cap ? cap * 2 : 8;
+            offs = realloc(offs, sizeof(size_t) * cap * 2);
+        }
+        offs[n * 2] = caps[0];
+        offs[n * 2 + 1] = caps[1];
+        n++;
+
+        /* an empty match moves on by a char */
+        pos = caps[1];
+        if(caps[1] == caps[0]) {
+            pos += pos < len ? utf8_seqlen(STR_PTR(s)[pos]) : 1;
+        }
+    }
+
+    MxcValue res = slice_list(sp[1], offs, n);
+    free(offs);
+    return res;
+}
+
+void remod_Init() {
+    Vector *re = new_cmodule("re")->cbltins;
+    Type *strlist = New_Type_With_Ptr(mxcty_string);
+
+    define_cmethod(re, "test", re_test_core, mxcty_bool, mxcty_string, mxcty_string, NULL);
+    define_cmethod(re, "fullmatch", re_fullmatch_core, mxcty_bool, mxcty_string, mxcty_string, NULL);
+    define_cmethod(re, "find", re_find_core, mxcty_int, mxcty_string, mxcty_string, NULL);
+    define_cmethod(re, "captures", re_captures_core, strlist, mxcty_string, mxcty_string, NULL);
+    define_cmethod(re, "findall", re_findall_core, strlist, mxcty_string, mxcty_string, NULL);
+}
@@ -0,0 +1,71 @@
+/* native part of the str module: search, replace and slicing */
+#include "module.h"
+#include "internal.h"
+#include "object/strobject.h"
+#include "vm.h"
+#include "mem.h"
+#include "frame.h"
+
+/* arguments are pushed last first */
+
+MxcValue find_core(Frame *f, MxcValue *sp, size_t narg) {
+    INTERN_UNUSE(f);
+    INTERN_UNUSE(narg);
+    return str_find(sp[1], sp[0]);
+}
+
+MxcValue count_core(Frame *f, MxcValue *sp, size_t narg) {
+    INTERN_UNUSE(f);
+    INTERN_UNUSE(narg);
+    return str_count(sp[1], sp[0]);
+}
+
+MxcValue contains_core(Frame *f, MxcValue *sp, size_t narg) {
+    INTERN_UNUSE(f);
+    INTERN_UNUSE(narg);
+    return str_contains(sp[1], sp[0]) ? mval_true : mval_false;
+}
+
+MxcValue starts_with_core(Frame *f, MxcValue *sp, size_t narg) {
+    INTERN_UNUSE(f);
+    INTERN_UNUSE(narg);
+    return str_starts_with(sp[1], sp[0]) ? mval_true : mval_false;
+}
+
+MxcValue replace_core(Frame *f, MxcValue *sp, size_t narg) {
+    INTERN_UNUSE(f);
+    INTERN_UNUSE(narg);
+    return str_replace(sp[2], sp[1], sp[0]);
+}
+
+MxcValue split_core(Frame *f, MxcValue *sp, size_t narg) {
+    INTERN_UNUSE(f);
+    INTERN_UNUSE(narg);
+    return str_split(sp[1], sp[0]);
+}
+
+MxcValue lines_core(Frame *f, MxcValue *sp, size_t narg) {
+    INTERN_UNUSE(f);
+    INTERN_UNUSE(narg);
+    return str_lines(sp[0]);
+}
+
+MxcValue trim_core(Frame *f, MxcValue *sp, size_t narg) {
+    INTERN_UNUSE(f);
+    INTERN_UNUSE(narg);
+    return str_trim(sp[0]);
+}
+
+void strmod_Init() {
+    Vector *str = new_cmodule("str")->cbltins;
+    Type *strlist = New_Type_With_Ptr(mxcty_string);
+
+    define_cmethod(str, "find", find_core, mxcty_int, mxcty_string, mxcty_string, NULL);
+    define_cmethod(str, "count", count_core, mxcty_int, mxcty_string, mxcty_string, NULL);
+    define_cmethod(str, "contains", contains_core, mxcty_bool, mxcty_string, mxcty_string, NULL);
+    define_cmethod(str, "starts_with", starts_with_core, mxcty_bool, mxcty_string, mxcty_string, NULL);
+    define_cmethod(str, "replace", replace_core, mxcty_string, mxcty_string, mxcty_string, mxcty_string, NULL);
+    define_cmethod(str, "split", split_core, strlist, mxcty_string, mxcty_string, NULL);
+    define_cmethod(str, "lines", lines_core, strlist, mxcty_string, NULL);
+    define_cmethod(str, "trim", trim_core, mxcty_string, mxcty_string, NULL);
+}
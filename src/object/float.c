@@ -8,6 +8,7 @@
 #include "error/error.h"
 #include "mem.h"
 #include "vm.h"
+#include "writer.h"
 
 MxcValue float_copy(MxcValue v) {
     return v;
@@ -49,12 +50,7 @@ MxcValue float_div(MxcValue l, MxcValue r) {
     return mval_float(l.fnum / r.fnum);
 }
 
-MxcValue float_tostring(MxcValue val) {
-    double f = val.fnum;
-    size_t len = get_digit((int)f) + 10;
-    char *str = malloc(sizeof(char) * len);
-    sprintf(str, "%.8lf", f);
-
-    return new_string(str, len);
-} 
+void float_tostring(MxcValue val, MxcWriter *w) {
+    writer_float(w, val.fnum);
+}
 
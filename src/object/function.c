@@ -8,6 +8,7 @@
 #include "mem.h"
 #include "gc.h"
 #include "vm.h"
+#include "writer.h"
 
 int userfn_call(MxcCallable *self,
                 Frame *f,
@@ -49,21 +50,8 @@ MxcValue userfn_copy(MxcObject *u) {
     return mval_obj(n);
 }
 
-void userfn_mark(MxcObject *ob) {
-    if(ob->marked) return;
-    ob->marked = 1;
-}
-
-void userfn_guard(MxcObject *ob) {
-    ob->gc_guard = 1;
-}
-
-void userfn_unguard(MxcObject *ob) {
-    ob->gc_guard = 0;
-}
-
 void userfn_dealloc(MxcObject *ob) {
-    free(((MxcFunction *)ob)->func);
+    /* userfunction is owned by the literal pool */
     Mxc_free(ob);
 }
 
@@ -76,7 +64,8 @@ int cfn_call(MxcCallable *self,
     frame->stackptr = args;
     Push(ret);
 
-    return 0;
+    /* a native function reports errors the way the VM does */
+    return frame->occurred_rterr.type != RTERR_NONEERR;
 }
 
 MxcValue new_cfunc(CFunction cf) {
@@ -102,30 +91,17 @@ void cfn_dealloc(MxcObject *ob) {
     Mxc_free(ob);
 }
 
-void cfn_mark(MxcObject *ob) {
-    if(ob->marked) return;
-    ob->marked = 1;
-}
-
-void cfn_guard(MxcObject *ob) {
-    ob->gc_guard = 1;
-}
+void userfn_tostring(MxcObject *ob, MxcWriter *w) {
+    char s[64];
+    int len = snprintf(s, sizeof(s), "<user-def function at %p>", (void *)ob);
 
-void cfn_unguard(MxcObject *ob) {
-    ob->gc_guard = 0;
+    writer_write(w, s, (size_t)len);
 }
 
-MxcValue userfn_tostring(MxcObject *ob) {
-    char *s = malloc(sizeof(char *) * 64);
-    int len = sprintf(s, "<user-def function at %p>", ob);
-
-    return new_string(s, (size_t)len);
-}
-
-MxcValue cfn_tostring(MxcObject *ob) {
+void cfn_tostring(MxcObject *ob, MxcWriter *w) {
     (void)ob;
     char *str = "<builtin function>";
-    return new_string_static(str, strlen(str));
+    writer_write(w, str, strlen(str));
 }
 
 MxcObjImpl userfn_objimpl = {
@@ -133,9 +109,7 @@ MxcObjImpl userfn_objimpl = {
     userfn_tostring,
     userfn_dealloc,
     userfn_copy,
-    userfn_mark,
-    userfn_guard,
-    userfn_unguard,
+    0,
     0,
     0,
 };
@@ -145,9 +119,7 @@ MxcObjImpl cfn_objimpl = {
     cfn_tostring,
     cfn_dealloc,
     cfn_copy,
-    cfn_mark,
-    cfn_guard,
-    cfn_unguard,
+    0,
     0,
     0,
 };
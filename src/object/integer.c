@@ -8,6 +8,7 @@
 #include "error/error.h"
 #include "mem.h"
 #include "vm.h"
+#include "writer.h"
 
 MxcValue int_copy(MxcValue v) {
     return v;
@@ -106,6 +107,6 @@ MxcValue int2str(MxcValue val, int base) {
     return new_string_copy(cur, end - cur);
 }
 
-MxcValue int_tostring(MxcValue val) {
-    return int2str(val, 10);
+void int_tostring(MxcValue val, MxcWriter *w) {
+    writer_int(w, val.num);
 }
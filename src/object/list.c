@@ -6,50 +6,59 @@
 #include "object/listobject.h"
 #include "error/error.h"
 #include "mem.h"
+#include "gc.h"
 #include "vm.h"
+#include "writer.h"
 
 MxcValue new_list(size_t size) {
-    MxcList *ob = (MxcList *)Mxc_malloc(sizeof(MxcList));
+    MxcList *ob = (MxcList *)Mxc_malloc_fin(sizeof(MxcList));
     ITERABLE(ob)->index = 0;
     ITERABLE(ob)->next = mval_invalid;
     OBJIMPL(ob) = &list_objimpl;
 
     ob->elem = malloc(sizeof(MxcValue) * size);
     ITERABLE(ob)->length = size;
+    Mxc_set_extsize((MxcObject *)ob, sizeof(MxcValue) * size);
 
     return mval_obj(ob);
 }
 
 MxcValue list_copy(MxcObject *l) {
-    MxcList *ob = (MxcList *)Mxc_malloc(sizeof(MxcList));
+    MxcList *ob = (MxcList *)Mxc_malloc_fin(sizeof(MxcList));
+    MxcObject head = *(MxcObject *)ob;
     memcpy(ob, l, sizeof(MxcList));
+    *(MxcObject *)ob = head;
 
     MxcValue *old = ob->elem;
     ob->elem = malloc(sizeof(MxcValue) * ITERABLE(ob)->length);
+    Mxc_set_extsize((MxcObject *)ob, sizeof(MxcValue) * ITERABLE(ob)->length);
     for(size_t i = 0; i < ITERABLE(ob)->length; ++i) {
         ob->elem[i] = mval_copy(old[i]);
+        RC_INCREF(ob->elem[i]);
     }
 
     return mval_obj(ob);
 }
 
 MxcValue new_list_with_size(MxcValue size, MxcValue init) {
-    MxcList *ob = (MxcList *)Mxc_malloc(sizeof(MxcList));
     int64_t len = size.num;
-    ITERABLE(ob)->index = 0;
-    ITERABLE(ob)->next = mval_invalid;
-    ITERABLE(ob)->length = len;
-    OBJIMPL(ob) = &list_objimpl;
-
     if(len < 0) {
         // error
         return mval_invalid;
     }
 
+    MxcList *ob = (MxcList *)Mxc_malloc_fin(sizeof(MxcList));
+    ITERABLE(ob)->index = 0;
+    ITERABLE(ob)->next = mval_invalid;
+    ITERABLE(ob)->length = len;
+    OBJIMPL(ob) = &list_objimpl;
+
     ob->elem = malloc(sizeof(MxcValue) * len);
+    Mxc_set_extsize((MxcObject *)ob, sizeof(MxcValue) * len);
     MxcValue *ptr = ob->elem;
     while(len--) {
         *ptr++ = init;
+        RC_INCREF(init);
     }
 
     return mval_obj(ob);
@@ -67,7 +76,9 @@ MxcValue list_set(MxcIterable *self, int64_t idx, MxcValue a) {
     MxcList *list = (MxcList *)self;
     if(ITERABLE(list)->length <= idx)
         return mval_invalid;
+    GC_SATB_BARRIER(list->elem[idx]);
     list->elem[idx] = a;
+    GC_WRITE_BARRIER(list, a);
 
     return a;
 }
@@ -82,55 +93,25 @@ void list_dealloc(MxcObject *ob) {
     Mxc_free(ob);
 }
 
-void list_gc_mark(MxcObject *ob) {
-    if(ob->marked) return;
-    MxcList *l = (MxcList *)ob;
-
-    ob->marked = 1;
-    for(size_t i = 0; i < ITERABLE(l)->length; ++i) {
-        mgc_mark(l->elem[i]);
-    }
-}
-
-void list_guard(MxcObject *ob) {
+void list_trace(MxcObject *ob, ob_visit_fn visit) {
     MxcList *l = (MxcList *)ob;
 
-    ob->gc_guard = 1;
     for(size_t i = 0; i < ITERABLE(l)->length; ++i) {
-        mgc_guard(l->elem[i]);
+        visit(&l->elem[i]);
     }
 }
 
-void list_unguard(MxcObject *ob) {
+void list_tostring(MxcObject *ob, MxcWriter *w) {
     MxcList *l = (MxcList *)ob;
 
-    ob->gc_guard = 0;
-    for(size_t i = 0; i < ITERABLE(l)->length; ++i) {
-        mgc_unguard(l->elem[i]);
-    }
-}
-
-MxcValue list_tostring(MxcObject *ob) {
-    MxcList *l = (MxcList *)ob;
-    if(ITERABLE(l)->length == 0) {
-        return new_string_static("[]", 2);
-    }
-    GC_GUARD(l);
-    MxcValue res = new_string_static("[", 1);
-    mgc_guard(res);
+    writer_putc(w, '[');
     for(size_t i = 0; i < ITERABLE(l)->length; ++i) {
         if(i > 0) {
-            str_cstr_append(res, ", ", 2);
+            writer_write(w, ", ", 2);
         }
-
-        MxcValue elemstr = mval2str(l->elem[i]);
-        str_append(res, elemstr);
+        mval_write(w, l->elem[i]);
     }
-    GC_UNGUARD(l);
-    str_cstr_append(res, "]", 1);
-
-    mgc_unguard(res);
-    return res;
+    writer_putc(w, ']');
 }
 
 MxcObjImpl list_objimpl = {
@@ -138,9 +119,7 @@ MxcObjImpl list_objimpl = {
     list_tostring,
     list_dealloc,
     list_copy,
-    list_gc_mark,
-    list_guard,
-    list_unguard,
     list_get,
     list_set,
+    list_trace,
 };
@@ -4,26 +4,42 @@
 #include "error/error.h"
 #include "mem.h"
 #include "vm.h"
+#include "writer.h"
 
-MxcValue mval2str(MxcValue val) {
+void mval_write(MxcWriter *w, MxcValue val) {
     switch(val.t) {
     case VAL_OBJ:
-        return OBJIMPL(val.obj)->tostring(val.obj);
+        OBJIMPL(val.obj)->tostring(val.obj, w);
+        break;
     case VAL_INT:
-        return int_tostring(val);
+        int_tostring(val, w);
+        break;
     case VAL_FLO:
-        return float_tostring(val);
+        float_tostring(val, w);
+        break;
     case VAL_TRUE:
-        return new_string_static("true", 4);
+        writer_write(w, "true", 4);
+        break;
     case VAL_FALSE:
-        return new_string_static("false", 5);
+        writer_write(w, "false", 5);
+        break;
     case VAL_NULL:
-        return new_string_static("null", 4);
+        writer_write(w, "null", 4);
+        break;
+    case VAL_CHAR:
+        char_tostring(val, w);
+        break;
     default:
         error("unreachable");
     }
+}
+
+MxcValue mval2str(MxcValue val) {
+    if(isobj(val) && OBJIMPL(val.obj) == &string_objimpl) {
+        return val;
+    }
 
-    return mval_invalid;
+    return str_format(&val, 1);
 }
 
 MxcValue mval_copy(MxcValue val) {
@@ -33,37 +49,63 @@ MxcValue mval_copy(MxcValue val) {
     }
 }
 
-void mgc_mark(MxcValue val) {
-    switch(val.t) {
-    case VAL_OBJ:   OBJIMPL(val.obj)->mark(val.obj); break;
-    default:        break;
-    }
+MxcValue new_error(const char *msg) {
+    MxcError *ob = (MxcError *)Mxc_malloc(sizeof(MxcError));
+    ob->errmsg = msg;
+
+    return mval_obj(ob);
 }
 
-void mgc_guard(MxcValue val) {
-    switch(val.t) {
-    case VAL_OBJ:   OBJIMPL(optr(val))->guard(optr(val)); break;
-    default:        break;
+MxcValue new_struct(int nfield) {
+    MxcIStruct *ob = (MxcIStruct *)Mxc_malloc_fin(sizeof(MxcIStruct));
+    OBJIMPL(ob) = &struct_objimpl;
+    ob->nfield = nfield;
+    ob->field = malloc(sizeof(MxcValue) * nfield);
+    Mxc_set_extsize((MxcObject *)ob, sizeof(MxcValue) * nfield);
+    for(int i = 0; i < nfield; ++i) {
+        ob->field[i] = mval_null;
     }
+
+    return mval_obj(ob);
 }
 
-void mgc_unguard(MxcValue val) {
-    switch(val.t) {
-    case VAL_OBJ:   OBJIMPL(optr(val))->unguard(optr(val)); break;
-    default:        break;
+MxcValue struct_copy(MxcObject *ob) {
+    MxcIStruct *s = (MxcIStruct *)ob;
+    MxcValue n = new_struct(s->nfield);
+
+    for(int i = 0; i < s->nfield; ++i) {
+        ostrct(n)->field[i] = mval_copy(s->field[i]);
+        RC_INCREF(ostrct(n)->field[i]);
     }
+
+    return n;
 }
 
-MxcValue new_error(const char *msg) {
-    MxcError *ob = (MxcError *)Mxc_malloc(sizeof(MxcError));
-    ob->errmsg = msg;
+void struct_dealloc(MxcObject *ob) {
+    free(((MxcIStruct *)ob)->field);
+    Mxc_free(ob);
+}
 
-    return mval_obj(ob);
+void struct_trace(MxcObject *ob, ob_visit_fn visit) {
+    MxcIStruct *s = (MxcIStruct *)ob;
+
+    for(int i = 0; i < s->nfield; ++i) {
+        visit(&s->field[i]);
+    }
 }
 
-MxcValue new_struct(int nfield) {
-    MxcIStruct *ob = (MxcIStruct *)Mxc_malloc(sizeof(MxcIStruct));
-    ob->field = malloc(sizeof(MxcValue) * nfield);
-    return mval_obj(ob);
+void struct_tostring(MxcObject *ob, MxcWriter *w) {
+    INTERN_UNUSE(ob);
+    writer_write(w, "<struct>", 8);
 }
 
+MxcObjImpl struct_objimpl = {
+    "struct",
+    struct_tostring,
+    struct_dealloc,
+    struct_copy,
+    0,
+    0,
+    struct_trace,
+};
+
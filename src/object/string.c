@@ -1,133 +1,688 @@
 /* implementation of string object */
 #include <stdio.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <string.h>
 #include <stdlib.h>
+#include <ctype.h>
 
 #include "object/strobject.h"
+#include "object/listobject.h"
 #include "error/error.h"
 #include "mem.h"
+#include "gc.h"
 #include "vm.h"
+#include "writer.h"
 
+/* room for len bytes in the object; the caller writes them */
+static MxcString *str_alloc_inline(size_t len) {
+    size_t size = offsetof(MxcString, inl) + len + 1;
+    MxcString *ob = (MxcString *)Mxc_malloc_fin(size);
+    ITERABLE(ob)->index = 0;
+    ITERABLE(ob)->next = mval_invalid;
+    ob->str = NULL;
+    ob->buf = NULL;
+    ob->hash = 0;
+    ob->index = NULL;
+    ob->enc = STR_ENC_UNKNOWN;
+    ob->storage = STR_INLINE;
+    ob->interned = false;
+    ob->inl[len] = '\0';
+    ITERABLE(ob)->length = len;
+    OBJIMPL(ob) = &string_objimpl; 
+
+    return ob;
+}
+
+static MxcValue new_string_inline(const char *s, size_t len) {
+    MxcString *ob = str_alloc_inline(len);
+    memcpy(ob->inl, s, len);
+
+    return mval_obj(ob);
+}
+
+/* takes s, which is malloc'd and NUL-terminated */
 MxcValue new_string(char *s, size_t len) {
-    MxcString *ob = (MxcString *)Mxc_malloc(sizeof(MxcString));
+    if(len <= STR_INLINE_MAX) {
+        MxcValue res = new_string_inline(s, len);
+        free(s);
+        return res;
+    }
+
+    MxcString *ob = (MxcString *)Mxc_malloc_fin(sizeof(MxcString));
     ITERABLE(ob)->index = 0;
     ITERABLE(ob)->next = mval_invalid;
     ob->str = s;
-    ob->isdyn = true;
+    ob->buf = NULL;
+    ob->hash = 0;
+    ob->index = NULL;
+    ob->enc = STR_ENC_UNKNOWN;
+    ob->storage = STR_DYN;
+    ob->interned = false;
     ITERABLE(ob)->length = len;
     OBJIMPL(ob) = &string_objimpl; 
+    Mxc_set_extsize((MxcObject *)ob, len + 1);
 
     return mval_obj(ob);
 }
 
 MxcValue new_string_copy(char *s, size_t len) {
-    MxcString *ob = (MxcString *)Mxc_malloc(sizeof(MxcString));
+    if(len <= STR_INLINE_MAX) {
+        return new_string_inline(s, len);
+    }
+
+    MxcString *ob = (MxcString *)Mxc_malloc_fin(sizeof(MxcString));
     ITERABLE(ob)->index = 0;
     ITERABLE(ob)->next = mval_invalid;
     ob->str = malloc(sizeof(char) * (len + 1));
     memcpy(ob->str, s, len);
     ob->str[len] = '\0';
 
-    ob->isdyn = true;
+    ob->buf = NULL;
+    ob->hash = 0;
+    ob->index = NULL;
+    ob->enc = STR_ENC_UNKNOWN;
+    ob->storage = STR_DYN;
+    ob->interned = false;
     ITERABLE(ob)->length = len;
     OBJIMPL(ob) = &string_objimpl; 
+    Mxc_set_extsize((MxcObject *)ob, len + 1);
 
     return mval_obj(ob);
 }
 
 MxcValue new_string_static(char *s, size_t len) {
-    MxcString *ob = (MxcString *)Mxc_malloc(sizeof(MxcString));
+    MxcString *ob = (MxcString *)Mxc_malloc_fin(sizeof(MxcString));
     ITERABLE(ob)->index = 0;
     ITERABLE(ob)->next = mval_invalid;
     ob->str = s;
-    ob->isdyn = false;
+    ob->buf = NULL;
+    ob->hash = 0;
+    ob->index = NULL;
+    ob->enc = STR_ENC_UNKNOWN;
+    ob->storage = STR_STATIC;
+    ob->interned = false;
     ITERABLE(ob)->length = len;
     OBJIMPL(ob) = &string_objimpl; 
 
     return mval_obj(ob);
 }
 
-MxcValue string_copy(MxcObject *s) {
-    MxcString *n = (MxcString *)Mxc_malloc(sizeof(MxcString));
-    MxcString *old = (MxcString *)s;
-    *n = *old; 
+/* the bytes are shared with every other string of the same literal */
+MxcValue new_string_interned(InternedStr *is) {
+    MxcString *ob = (MxcString *)Mxc_malloc_fin(sizeof(MxcString));
+    ITERABLE(ob)->index = 0;
+    ITERABLE(ob)->next = mval_invalid;
+    ob->str = is->str;
+    ob->buf = NULL;
+    ob->hash = is->hash;
+    ob->index = is->index;
+    ob->enc = is->enc;
+    ob->storage = STR_STATIC;
+    ob->interned = true;
+    ITERABLE(ob)->length = is->len;
+    OBJIMPL(ob) = &string_objimpl; 
+
+    return mval_obj(ob);
+}
+
+static MxcValue new_string_view(StrBuf *buf, char *str, size_t len,
+                                size_t extsize) {
+    MxcString *ob = (MxcString *)Mxc_malloc_fin(sizeof(MxcString));
+    ITERABLE(ob)->index = 0;
+    ITERABLE(ob)->next = mval_invalid;
+    ob->str = str;
+    ob->buf = buf;
+    ob->hash = 0;
+    ob->index = NULL;
+    ob->enc = STR_ENC_UNKNOWN;
+    ob->storage = STR_STATIC;
+    ob->interned = false;
+    ITERABLE(ob)->length = len;
+    OBJIMPL(ob) = &string_objimpl; 
+    Mxc_set_extsize((MxcObject *)ob, extsize);
+
+    return mval_obj(ob);
+}
+
+static StrBuf *strbuf_new(char *data, size_t len, size_t cap) {
+    StrBuf *buf = malloc(sizeof(StrBuf));
+    buf->refs = 1;
+    buf->len = len;
+    buf->cap = cap;
+    buf->data = data;
+
+    return buf;
+}
+
+#define STR_END(s)  (STR_PTR(s) + ITERABLE(s)->length)
+#define BUF_END(b)  ((b)->data + (b)->len)
 
-    char *olds = n->str;
-    n->str = malloc(sizeof(char) * (ITERABLE(n)->length + 1));
-    strcpy(n->str, olds);
-    n->isdyn = true;
+/* bytes the object has room for inline, besides the NUL */
+static size_t inline_room(MxcString *s) {
+    size_t size = ((MxcObject *)s)->size;
+    size_t used = offsetof(MxcString, inl) + 1;
 
-    return mval_obj(n);
+    return size > used ? size - used : 0;
 }
 
-void string_gc_mark(MxcObject *ob) {
-    if(ob->marked) return;
-    ob->marked = 1;
+static void str_release(MxcString *s) {
+    if(s->buf) {
+        if(--s->buf->refs == 0) {
+            free(s->buf->data);
+            free(s->buf);
+        }
+    }
+    else if(s->storage == STR_DYN) {
+        free(s->str);
+    }
 }
 
-void str_guard(MxcObject *ob) {
-    ob->gc_guard = 1;
+/* literals and shared buffers are copied before writing */
+static bool str_writable(MxcString *s) {
+    if(s->buf) return s->buf->refs == 1;
+
+    return s->storage != STR_STATIC;
 }
 
-void str_unguard(MxcObject *ob) {
-    ob->gc_guard = 0;
+/* the index of an interned string belongs to the literal */
+static void str_drop_index(MxcString *s) {
+    if(!s->interned) {
+        free(s->index);
+    }
+    s->index = NULL;
 }
 
-void string_dealloc(MxcObject *s) {
-    MxcString *str = (MxcString *)s;
-    if(str->isdyn) {
-        free(str->str);
+/* ASCII and UTF-8 stay valid when put together */
+static int concat_enc(int l, int r) {
+    if(l == STR_ENC_ASCII && r == STR_ENC_ASCII)
+        return STR_ENC_ASCII;
+    if((l == STR_ENC_ASCII || l == STR_ENC_UTF8) &&
+       (r == STR_ENC_ASCII || r == STR_ENC_UTF8))
+        return STR_ENC_UTF8;
+
+    return STR_ENC_UNKNOWN;
+}
+
+/*
+ *  Makes the len bytes at p, NUL-terminated, the contents of s. p is
+ *  either s->inl or malloc'd.
+ */
+static void str_own(MxcString *s, char *p, size_t len) {
+    str_release(s);
+    if(s->interned) {
+        s->index = NULL;
+    }
+    s->buf = NULL;
+    s->interned = false;
+    ITERABLE(s)->length = len;
+
+    if(p == s->inl) {
+        s->str = NULL;
+        s->storage = STR_INLINE;
+        Mxc_set_extsize((MxcObject *)s, 0);
+    }
+    else {
+        s->str = p;
+        s->storage = STR_DYN;
+        Mxc_set_extsize((MxcObject *)s, len + 1);
+    }
+}
+
+/* gives s a private, NUL-terminated copy of its contents */
+static void str_detach(MxcString *s) {
+    size_t len = ITERABLE(s)->length;
+    char *p = len <= inline_room(s) ? s->inl
+                                    : malloc(sizeof(char) * (len + 1));
+
+    memcpy(p, s->str, len);
+    p[len] = '\0';
+    str_own(s, p, len);
+}
+
+char *str_cstr(MxcString *s) {
+    bool terminated;
+
+    if(s->buf)
+        terminated = STR_END(s) == BUF_END(s->buf);
+    else    /* a slice of a literal ends inside it */
+        terminated = s->storage != STR_STATIC || *STR_END(s) == '\0';
+
+    if(!terminated) {
+        str_detach(s);
     }
+
+    return STR_PTR(s);
+}
+
+/* shares the buffer of a, which is not copied unless it is inline */
+MxcValue str_slice(MxcValue a, size_t begin, size_t len) {
+    MxcString *s = ostr(a);
+    MxcValue res;
+
+    if(s->storage == STR_INLINE) {
+        res = new_string_copy(s->inl + begin, len);
+    }
+    else {
+        if(s->storage == STR_DYN) {
+            size_t slen = ITERABLE(s)->length;
+            s->buf = strbuf_new(s->str, slen, slen + 1);
+            s->storage = STR_STATIC;
+        }
+        if(s->buf) {
+            s->buf->refs++;
+        }
+        res = new_string_view(s->buf, s->str + begin, len, 0);
+    }
+
+    if(s->enc == STR_ENC_ASCII) {
+        ostr(res)->enc = STR_ENC_ASCII;
+    }
+
+    return res;
+}
+
+MxcValue string_copy(MxcObject *s) {
+    MxcString *old = (MxcString *)s;
+    MxcValue n = new_string_copy(STR_PTR(old), ITERABLE(old)->length);
+
+    ITERABLE(ostr(n))->index = ITERABLE(old)->index;
+    ITERABLE(ostr(n))->next = ITERABLE(old)->next;
+    ostr(n)->hash = old->hash;
+    ostr(n)->enc = old->enc;
+
+    return n;
+}
+
+void string_dealloc(MxcObject *s) {
+    str_drop_index((MxcString *)s);
+    str_release((MxcString *)s);
     Mxc_free(s);
 }
 
+/* code point idx; strings that are not UTF-8 are indexed by byte */
 MxcValue str_index(MxcIterable *self, int64_t idx) {
     MxcString *str = (MxcString *)self;
-    if(self->length <= idx) return mval_invalid;
 
-    return new_char_ref(&str->str[idx]);
+    if(str_enc(str) != STR_ENC_UTF8) {
+        if(idx < 0 || self->length <= idx) return mval_invalid;
+        return mval_char((uint8_t)STR_PTR(str)[idx]);
+    }
+    if(idx < 0 || str_nchars(str) <= (size_t)idx) return mval_invalid;
+
+    return mval_char(utf8_decode(STR_PTR(str) + str_offset(str, idx)));
+}
+
+/* replaces the bytes of code point idx with the encoding of c */
+static void str_replace_char(MxcString *s, int64_t idx, uint32_t c) {
+    char enc[4];
+    size_t n = utf8_encode(enc, c);
+    size_t off = str_offset(s, idx);
+    size_t oldn = s->enc == STR_ENC_UTF8 ? utf8_seqlen(STR_PTR(s)[off]) : 1;
+
+    if(n == oldn) {     /* the index stays valid */
+        if(!str_writable(s)) {
+            str_detach(s);
+        }
+        memcpy(STR_PTR(s) + off, enc, n);
+        return;
+    }
+
+    size_t len = ITERABLE(s)->length - oldn + n;
+    char *src = STR_PTR(s);
+    char *p = len <= inline_room(s) ? s->inl
+                                    : malloc(sizeof(char) * (len + 1));
+
+    /* an inline string is changed in place */
+    memmove(p + off + n, src + off + oldn, len - off - n);
+    if(p != src) {
+        memcpy(p, src, off);
+    }
+    memcpy(p + off, enc, n);
+    p[len] = '\0';
+
+    str_drop_index(s);
+    str_own(s, p, len);
+    s->enc = STR_ENC_UNKNOWN;
 }
 
 MxcValue str_index_set(MxcIterable *self, int64_t idx, MxcValue a) {
     MxcString *str = (MxcString *)self;
-    if(self->length <= idx) return mval_invalid;
-    str->str[idx] = ((MxcChar *)optr(a))->ch;
+
+    if(str_enc(str) == STR_ENC_UTF8 || a.num >= 0x80) {
+        if(idx < 0 || str_nchars(str) <= (size_t)idx) return mval_invalid;
+        str_replace_char(str, idx, a.num);
+        str->hash = 0;
+        return a;
+    }
+
+    if(idx < 0 || self->length <= idx) return mval_invalid;
+    if(!str_writable(str)) {
+        str_detach(str);
+    }
+    STR_PTR(str)[idx] = (char)a.num;
+    str->hash = 0;
+    if(str->enc == STR_ENC_BYTES) {
+        str->enc = STR_ENC_UNKNOWN;
+    }
 
     return a;
 }
 
+uint32_t str_hashof(MxcString *s) {
+    if(!s->hash) {
+        s->hash = str_hash_len(STR_PTR(s), ITERABLE(s)->length);
+    }
+
+    return s->hash;
+}
+
+/* equal strings of one literal share their bytes, different ones never do */
+bool str_eq(MxcValue a, MxcValue b) {
+    MxcString *l = ostr(a);
+    MxcString *r = ostr(b);
+    size_t len = ITERABLE(l)->length;
+
+    if(len != ITERABLE(r)->length) return false;
+    if(STR_PTR(l) == STR_PTR(r)) return true;
+    if(l->interned && r->interned) return false;
+    if(str_hashof(l) != str_hashof(r)) return false;
+
+    return memcmp(STR_PTR(l), STR_PTR(r), len) == 0;
+}
+
 MxcValue str_concat(MxcValue a, MxcValue b) {
-    size_t len = ITERABLE(ostr(a))->length + ITERABLE(ostr(b))->length;
-    char *res = malloc(sizeof(char) * (len + 1));
-    strcpy(res, ostr(a)->str);
-    strcat(res, ostr(b)->str);
+    MxcString *l = ostr(a);
+    MxcString *r = ostr(b);
+    size_t llen = ITERABLE(l)->length;
+    size_t rlen = ITERABLE(r)->length;
+    size_t len = llen + rlen;
+    size_t extsize = 0;
+    StrBuf *buf = l->buf;
+    char *str;
 
-    return new_string(res, len);
+    if(buf && STR_END(l) == BUF_END(buf) &&
+       (size_t)(l->str - buf->data) + len < buf->cap) {
+        buf->refs++;
+        str = l->str;
+    }
+    else if(!buf && len <= STR_INLINE_MAX) {
+        MxcString *ob = str_alloc_inline(len);
+        memcpy(ob->inl, STR_PTR(l), llen);
+        memcpy(ob->inl + llen, STR_PTR(r), rlen);
+        ob->enc = concat_enc(l->enc, r->enc);
+        return mval_obj(ob);
+    }
+    else {
+        /* l came from a concatenation: leave room for the next one */
+        size_t cap = buf ? (len + 1) * 2 : len + 1;
+        buf = strbuf_new(malloc(cap), 0, cap);
+        str = buf->data;
+        memcpy(str, STR_PTR(l), llen);
+        extsize = cap;
+    }
+    memcpy(str + llen, STR_PTR(r), rlen);
+    str[len] = '\0';
+    buf->len = str + len - buf->data;
+
+    MxcValue res = new_string_view(buf, str, len, extsize);
+    ostr(res)->enc = concat_enc(l->enc, r->enc);
+
+    return res;
+}
+
+/* measures the pieces first, so the result is allocated once */
+MxcValue str_format(MxcValue *pieces, int n) {
+    MxcWriter w;
+
+    writer_open_count(&w);
+    for(int i = 0; i < n; ++i) {
+        mval_write(&w, pieces[i]);
+    }
+
+    if(w.len <= STR_INLINE_MAX) {
+        MxcString *ob = str_alloc_inline(w.len);
+        writer_open_buf(&w, ob->inl, w.len + 1);
+        for(int i = 0; i < n; ++i) {
+            mval_write(&w, pieces[i]);
+        }
+        /* floats were counted at their longest */
+        ob->inl[w.len] = '\0';
+        ITERABLE(ob)->length = w.len;
+        return mval_obj(ob);
+    }
+
+    writer_open_mem(&w, w.len + 1);
+    for(int i = 0; i < n; ++i) {
+        mval_write(&w, pieces[i]);
+    }
+
+    return new_string(writer_cstr(&w), w.len);
 }
 
 void str_cstr_append(MxcValue a, char *b, size_t blen) {
-    size_t len = ITERABLE(ostr(a))->length + blen;
-    if(ostr(a)->isdyn) {
-        ostr(a)->str = realloc(ostr(a)->str, sizeof(char) * (len + 1));
+    MxcString *s = ostr(a);
+    size_t olen = ITERABLE(s)->length;
+    size_t len = olen + blen;
+    StrBuf *buf = s->buf;
+
+    str_drop_index(s);
+    s->hash = 0;
+    s->enc = STR_ENC_UNKNOWN;
+
+    /* b may be the contents of s, so they are released last */
+    if(!buf && len <= inline_room(s)) {
+        if(s->storage != STR_INLINE) {
+            memcpy(s->inl, s->str, olen);
+        }
+        memcpy(s->inl + olen, b, blen);
+        s->inl[len] = '\0';
+        str_own(s, s->inl, len);
+        return;
     }
-    else {
-        char *buf = malloc(sizeof(char) * (len + 1));
-        strcpy(buf, ostr(a)->str);
-        ostr(a)->str = buf;
+
+    if(!buf || buf->refs > 1 || s->str != buf->data) {
+        size_t cap = (len + 1) * 2;
+        buf = strbuf_new(malloc(cap), 0, cap);
+        memcpy(buf->data, STR_PTR(s), olen);
     }
+    else if(len >= buf->cap) {
+        bool inbuf = b >= buf->data && b < buf->data + buf->cap;
+        size_t boff = inbuf ? (size_t)(b - buf->data) : 0;
 
-    strcat(ostr(a)->str, b);
-    ITERABLE(ostr(a))->length = len;
-    ostr(a)->isdyn = true;
+        buf->cap = (len + 1) * 2;
+        buf->data = realloc(buf->data, buf->cap);
+        if(inbuf) {
+            b = buf->data + boff;
+        }
+    }
+
+    memcpy(buf->data + olen, b, blen);
+    buf->data[len] = '\0';
+    buf->len = len;
+    if(buf != s->buf) {
+        str_release(s);
+        s->buf = buf;
+    }
+    s->str = buf->data;
+    s->storage = STR_STATIC;
+    s->interned = false;
+    ITERABLE(s)->length = len;
+    Mxc_set_extsize(optr(a), buf->cap);
 }
 
 void str_append(MxcValue a, MxcValue b) {
-    str_cstr_append(a, ostr(b)->str, ITERABLE(ostr(b))->length);
+    int enc = concat_enc(ostr(a)->enc, ostr(b)->enc);
+
+    str_cstr_append(a, STR_PTR(ostr(b)), ITERABLE(ostr(b))->length);
+    ostr(a)->enc = enc;
 }
 
-MxcValue string_tostring(MxcObject *ob) {
-    return mval_obj(ob);
+static char *find_sep(char *s, char *end, char *sep, size_t seplen) {
+    return (char *)str_search(s, end - s, sep, seplen);
+}
+
+static MxcValue new_piece_list(size_t n) {
+    MxcValue list = new_list(n);
+    for(size_t i = 0; i < n; ++i) {
+        olist(list)->elem[i] = mval_null;
+    }
+
+    return list;
+}
+
+static void set_piece(MxcValue *list, size_t i, MxcValue *str,
+                      char *begin, char *end) {
+    MxcValue piece = str_slice(*str, begin - STR_PTR(ostr(*str)), end - begin);
+    olist(*list)->elem[i] = piece;
+    GC_WRITE_BARRIER(olist(*list), piece);
+}
+
+/* the pieces are slices of a */
+MxcValue str_split(MxcValue a, MxcValue b) {
+    HandleScope scope = GC_SCOPE_OPEN();
+    MxcValue *str = gc_handle(a);
+    char *s = STR_PTR(ostr(a));
+    char *end = STR_END(ostr(a));
+    char *sep = STR_PTR(ostr(b));
+    size_t seplen = ITERABLE(ostr(b))->length;
+    size_t n = 1;
+
+    if(seplen > 0) {
+        for(char *p = s; (p = find_sep(p, end, sep, seplen)); p += seplen) {
+            n++;
+        }
+    }
+
+    MxcValue *list = gc_handle(new_piece_list(n));
+    char *p = s;
+    for(size_t i = 0; i < n; ++i) {
+        char *q = i + 1 < n ? find_sep(p, end, sep, seplen) : end;
+        set_piece(list, i, str, p, q);
+        p = q + seplen;
+    }
+
+    MxcValue res = *list;
+    GC_SCOPE_CLOSE(scope);
+    return res;
+}
+
+/* a trailing newline does not start another line; "\r\n" is accepted */
+MxcValue str_lines(MxcValue a) {
+    HandleScope scope = GC_SCOPE_OPEN();
+    MxcValue *str = gc_handle(a);
+    char *s = STR_PTR(ostr(a));
+    char *end = STR_END(ostr(a));
+    size_t n = 0;
+
+    for(char *p = s; p < end; ++n) {
+        char *q = memchr(p, '\n', end - p);
+        p = q ? q + 1 : end;
+    }
+
+    MxcValue *list = gc_handle(new_piece_list(n));
+    char *p = s;
+    for(size_t i = 0; i < n; ++i) {
+        char *q = memchr(p, '\n', end - p);
+        char *next = q ? q + 1 : end;
+        if(!q) q = end;
+        if(q > p && q[-1] == '\r') q--;
+
+        set_piece(list, i, str, p, q);
+        p = next;
+    }
+
+    MxcValue res = *list;
+    GC_SCOPE_CLOSE(scope);
+    return res;
+}
+
+MxcValue str_trim(MxcValue a) {
+    char *s = STR_PTR(ostr(a));
+    char *begin = s;
+    char *end = STR_END(ostr(a));
+
+    while(begin < end && isspace((unsigned char)*begin)) begin++;
+    while(end > begin && isspace((unsigned char)end[-1])) end--;
+
+    return str_slice(a, begin - s, end - begin);
+}
+
+MxcValue str_find(MxcValue a, MxcValue b) {
+    MxcString *s = ostr(a);
+    const char *p = str_search(STR_PTR(s), ITERABLE(s)->length,
+                               STR_PTR(ostr(b)), ITERABLE(ostr(b))->length);
+
+    return mval_int(p ? (int64_t)str_cpos(s, p - STR_PTR(s)) : -1);
+}
+
+bool str_contains(MxcValue a, MxcValue b) {
+    return str_search(STR_PTR(ostr(a)), ITERABLE(ostr(a))->length,
+                      STR_PTR(ostr(b)), ITERABLE(ostr(b))->length) != NULL;
+}
+
+bool str_starts_with(MxcValue a, MxcValue b) {
+    size_t m = ITERABLE(ostr(b))->length;
+
+    return m <= ITERABLE(ostr(a))->length &&
+           memcmp(STR_PTR(ostr(a)), STR_PTR(ostr(b)), m) == 0;
+}
+
+/* non-overlapping occurrences; the empty string occurs len + 1 times */
+static size_t count_occurrences(MxcString *s, MxcString *sub) {
+    char *p = STR_PTR(s);
+    char *end = STR_END(s);
+    size_t m = ITERABLE(sub)->length;
+    size_t k = 0;
+
+    if(m == 0) return ITERABLE(s)->length + 1;
+    if(m == 1) return str_count_char(p, end - p, STR_PTR(sub)[0]);
+
+    while((p = find_sep(p, end, STR_PTR(sub), m))) {
+        k++;
+        p += m;
+    }
+
+    return k;
+}
+
+MxcValue str_count(MxcValue a, MxcValue b) {
+    return mval_int(count_occurrences(ostr(a), ostr(b)));
+}
+
+MxcValue str_replace(MxcValue a, MxcValue old, MxcValue new) {
+    MxcString *s = ostr(a);
+    size_t m = ITERABLE(ostr(old))->length;
+    size_t k = m ? count_occurrences(s, ostr(old)) : 0;
+
+    if(k == 0) {
+        return str_slice(a, 0, ITERABLE(s)->length);
+    }
+
+    char *from = STR_PTR(ostr(old));
+    char *to = STR_PTR(ostr(new));
+    size_t tolen = ITERABLE(ostr(new))->length;
+    size_t len = ITERABLE(s)->length - k * m + k * tolen;
+    char *res = malloc(sizeof(char) * (len + 1));
+    char *dst = res;
+    char *p = STR_PTR(s);
+    char *end = STR_END(s);
+
+    for(char *q; (q = find_sep(p, end, from, m)); p = q + m) {
+        memcpy(dst, p, q - p);
+        dst += q - p;
+        memcpy(dst, to, tolen);
+        dst += tolen;
+    }
+    memcpy(dst, p, end - p);
+    res[len] = '\0';
+
+    return new_string(res, len);
+}
+
+void string_tostring(MxcObject *ob, MxcWriter *w) {
+    MxcString *s = (MxcString *)ob;
+    writer_write(w, STR_PTR(s), ITERABLE(s)->length);
 }
 
 MxcObjImpl string_objimpl = {
@@ -135,9 +690,7 @@ MxcObjImpl string_objimpl = {
     string_tostring,
     string_dealloc,
     string_copy,
-    string_gc_mark,
-    str_guard,
-    str_unguard,
     str_index,
     str_index_set,
+    0,
 };
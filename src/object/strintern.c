@@ -0,0 +1,62 @@
+/* intern table of string literals */
+#include <stdlib.h>
+#include <string.h>
+
+#include "object/strobject.h"
+#include "internal.h"
+#include "util.h"
+
+static InternedStr **table;
+static size_t table_cap;
+static size_t table_len;
+
+static void table_grow() {
+    size_t cap = table_cap ? table_cap * 2 : 256;
+    InternedStr **t = calloc(cap, sizeof(InternedStr *));
+
+    for(size_t i = 0; i < table_cap; ++i) {
+        InternedStr *e = table[i];
+        if(!e) continue;
+
+        size_t j = e->hash & (cap - 1);
+        while(t[j]) j = (j + 1) & (cap - 1);
+        t[j] = e;
+    }
+
+    free(table);
+    table = t;
+    table_cap = cap;
+}
+
+/*
+ *  s is kept, not copied, so it has to live until exit. It is validated
+ *  here once, for every string made from the literal.
+ */
+InternedStr *str_intern(char *s, size_t len) {
+    if(table_len * 2 >= table_cap) {
+        table_grow();
+    }
+
+    uint32_t h = str_hash_len(s, len);
+    size_t i = h & (table_cap - 1);
+
+    for(InternedStr *e; (e = table[i]); i = (i + 1) & (table_cap - 1)) {
+        if(e->hash == h && e->len == len && memcmp(e->str, s, len) == 0)
+            return e;
+    }
+
+    InternedStr *e = xmalloc(sizeof(InternedStr));
+    e->str = s;
+    e->len = len;
+    e->hash = h;
+    e->lit = -1;
+
+    size_t nchars;
+    e->enc = utf8_scan(s, len, &nchars);
+    e->index = e->enc == STR_ENC_UTF8 ? str_index_build(s, len, nchars)
+                                      : NULL;
+    table[i] = e;
+    table_len++;
+
+    return e;
+}
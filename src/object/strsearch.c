@@ -0,0 +1,158 @@
+/* substring search kernels used by the str functions */
+#include <stdint.h>
+#include <string.h>
+
+#include "object/strobject.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define STRSEARCH_SIMD
+#include <immintrin.h>
+#endif
+
+typedef const char *(*search_fn)(const char *, size_t, const char *, size_t);
+typedef size_t (*count_fn)(const char *, size_t, char);
+
+static const char *search_scalar(const char *s, size_t n,
+                                 const char *sub, size_t m) {
+    if(n < m) return NULL;
+
+    const char *end = s + n - m + 1;
+    for(const char *p = s; (p = memchr(p, sub[0], end - p)); ++p) {
+        if(memcmp(p, sub, m) == 0) return p;
+    }
+
+    return NULL;
+}
+
+static size_t count_scalar(const char *s, size_t n, char c) {
+    size_t k = 0;
+
+    for(size_t i = 0; i < n; ++i) {
+        k += s[i] == c;
+    }
+
+    return k;
+}
+
+#ifdef STRSEARCH_SIMD
+/*
+ *  Candidates are the positions where both the first and the last byte
+ *  of sub match, tested a vector at a time; only they are compared in
+ *  full. sub is at least 2 bytes long.
+ */
+static const char *search_sse2(const char *s, size_t n,
+                               const char *sub, size_t m) {
+    const __m128i first = _mm_set1_epi8(sub[0]);
+    const __m128i last = _mm_set1_epi8(sub[m - 1]);
+    size_t i = 0;
+
+    for(; i + m - 1 + 16 <= n; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(s + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(s + i + m - 1));
+        unsigned mask = _mm_movemask_epi8(
+                _mm_and_si128(_mm_cmpeq_epi8(a, first),
+                              _mm_cmpeq_epi8(b, last)));
+
+        while(mask) {
+            int bit = __builtin_ctz(mask);
+            if(memcmp(s + i + bit + 1, sub + 1, m - 2) == 0)
+                return s + i + bit;
+            mask &= mask - 1;
+        }
+    }
+
+    return search_scalar(s + i, n - i, sub, m);
+}
+
+__attribute__((target("avx2")))
+static const char *search_avx2(const char *s, size_t n,
+                               const char *sub, size_t m) {
+    const __m256i first = _mm256_set1_epi8(sub[0]);
+    const __m256i last = _mm256_set1_epi8(sub[m - 1]);
+    size_t i = 0;
+
+    for(; i + m - 1 + 32 <= n; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(s + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(s + i + m - 1));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(
+                _mm256_and_si256(_mm256_cmpeq_epi8(a, first),
+                                 _mm256_cmpeq_epi8(b, last)));
+
+        while(mask) {
+            int bit = __builtin_ctz(mask);
+            if(memcmp(s + i + bit + 1, sub + 1, m - 2) == 0)
+                return s + i + bit;
+            mask &= mask - 1;
+        }
+    }
+
+    return search_sse2(s + i, n - i, sub, m);
+}
+
+static size_t count_sse2(const char *s, size_t n, char c) {
+    const __m128i v = _mm_set1_epi8(c);
+    size_t k = 0;
+    size_t i = 0;
+
+    for(; i + 16 <= n; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(s + i));
+        k += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(a, v)));
+    }
+
+    return k + count_scalar(s + i, n - i, c);
+}
+
+__attribute__((target("avx2,popcnt")))
+static size_t count_avx2(const char *s, size_t n, char c) {
+    const __m256i v = _mm256_set1_epi8(c);
+    size_t k = 0;
+    size_t i = 0;
+
+    for(; i + 32 <= n; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(s + i));
+        k += __builtin_popcount(
+                (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, v)));
+    }
+
+    return k + count_sse2(s + i, n - i, c);
+}
+#endif  /* STRSEARCH_SIMD */
+
+static search_fn search_impl;
+static count_fn count_impl;
+
+static void select_kernels() {
+    search_impl = search_scalar;
+    count_impl = count_scalar;
+#ifdef STRSEARCH_SIMD
+    search_impl = search_sse2;
+    count_impl = count_sse2;
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")) {
+        search_impl = search_avx2;
+        count_impl = count_avx2;
+    }
+#endif
+}
+
+/* first occurrence of sub in s, or NULL */
+const char *str_search(const char *s, size_t n, const char *sub, size_t m) {
+    if(m == 0) return s;
+    if(m > n) return NULL;
+    if(m == 1) return memchr(s, sub[0], n);
+
+    if(!search_impl) {
+        select_kernels();
+    }
+
+    return search_impl(s, n, sub, m);
+}
+
+/* occurrences of c in s */
+size_t str_count_char(const char *s, size_t n, char c) {
+    if(!count_impl) {
+        select_kernels();
+    }
+
+    return count_impl(s, n, c);
+}
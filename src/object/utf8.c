@@ -0,0 +1,288 @@
+/* UTF-8 validation and code point access for strings */
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "object/strobject.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define UTF8_SIMD
+#include <immintrin.h>
+#endif
+
+typedef size_t (*ascii_fn)(const char *, size_t);
+
+/* length of the ASCII prefix of s */
+static size_t ascii_scalar(const char *s, size_t n) {
+    size_t i = 0;
+
+    for(; i + 8 <= n; i += 8) {
+        uint64_t w;
+        memcpy(&w, s + i, 8);
+        if(w & 0x8080808080808080ull) break;
+    }
+    while(i < n && !(s[i] & 0x80)) i++;
+
+    return i;
+}
+
+#ifdef UTF8_SIMD
+static size_t ascii_sse2(const char *s, size_t n) {
+    size_t i = 0;
+
+    for(; i + 16 <= n; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(s + i));
+        unsigned mask = _mm_movemask_epi8(a);
+        if(mask) return i + __builtin_ctz(mask);
+    }
+
+    return i + ascii_scalar(s + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static size_t ascii_avx2(const char *s, size_t n) {
+    size_t i = 0;
+
+    for(; i + 32 <= n; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(s + i));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(a);
+        if(mask) return i + __builtin_ctz(mask);
+    }
+
+    return i + ascii_sse2(s + i, n - i);
+}
+#endif  /* UTF8_SIMD */
+
+static ascii_fn ascii_impl;
+
+static void select_kernels() {
+    ascii_impl = ascii_scalar;
+#ifdef UTF8_SIMD
+    ascii_impl = ascii_sse2;
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")) {
+        ascii_impl = ascii_avx2;
+    }
+#endif
+}
+
+/* bytes of the sequence led by c, by its high nibble */
+static const uint8_t seqlen[16] = {
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 3, 4
+};
+
+#define SEQLEN(c)   seqlen[(uint8_t)(c) >> 4]
+#define IS_CONT(c)  (((uint8_t)(c) & 0xc0) == 0x80)
+
+/* length of the valid sequence at s, or 0 */
+static size_t valid_seq(const uint8_t *s, size_t n) {
+    uint8_t c = s[0];
+
+    if(c < 0xc2 || c > 0xf4) return 0;     /* continuation or overlong */
+    size_t len = SEQLEN(c);
+    if(len > n) return 0;
+    for(size_t i = 1; i < len; ++i) {
+        if(!IS_CONT(s[i])) return 0;
+    }
+
+    switch(c) {
+    case 0xe0: if(s[1] < 0xa0) return 0; break;     /* overlong */
+    case 0xed: if(s[1] > 0x9f) return 0; break;     /* surrogate */
+    case 0xf0: if(s[1] < 0x90) return 0; break;     /* overlong */
+    case 0xf4: if(s[1] > 0x8f) return 0; break;     /* > U+10FFFF */
+    }
+
+    return len;
+}
+
+/*
+ *  ASCII runs are skipped a vector at a time; only the bytes of
+ *  multibyte sequences are checked one by one.
+ */
+int utf8_scan(const char *s, size_t n, size_t *nchars) {
+    size_t i = 0;
+    size_t k = 0;
+    int enc = STR_ENC_ASCII;
+
+    if(!ascii_impl) {
+        select_kernels();
+    }
+
+    for(;;) {
+        size_t run = ascii_impl(s + i, n - i);
+        i += run;
+        k += run;
+        if(i == n) break;
+
+        size_t len = valid_seq((const uint8_t *)s + i, n - i);
+        if(!len) return STR_ENC_BYTES;
+        i += len;
+        k++;
+        enc = STR_ENC_UTF8;
+    }
+
+    if(nchars) *nchars = k;
+    return enc;
+}
+
+uint32_t utf8_decode(const char *p) {
+    const uint8_t *s = (const uint8_t *)p;
+
+    switch(SEQLEN(s[0])) {
+    case 2: return (s[0] & 0x1f) << 6 | (s[1] & 0x3f);
+    case 3: return (s[0] & 0x0f) << 12 | (s[1] & 0x3f) << 6 | (s[2] & 0x3f);
+    case 4: return (s[0] & 0x07) << 18 | (s[1] & 0x3f) << 12 |
+                   (s[2] & 0x3f) << 6 | (s[3] & 0x3f);
+    default: return s[0];
+    }
+}
+
+/* writes c to buf, which has room for 4 bytes */
+size_t utf8_encode(char *buf, uint32_t c) {
+    if(c < 0x80) {
+        buf[0] = c;
+        return 1;
+    }
+    if(c < 0x800) {
+        buf[0] = 0xc0 | c >> 6;
+        buf[1] = 0x80 | (c & 0x3f);
+        return 2;
+    }
+    if(c < 0x10000) {
+        buf[0] = 0xe0 | c >> 12;
+        buf[1] = 0x80 | (c >> 6 & 0x3f);
+        buf[2] = 0x80 | (c & 0x3f);
+        return 3;
+    }
+    buf[0] = 0xf0 | c >> 18;
+    buf[1] = 0x80 | (c >> 12 & 0x3f);
+    buf[2] = 0x80 | (c >> 6 & 0x3f);
+    buf[3] = 0x80 | (c & 0x3f);
+    return 4;
+}
+
+/* s is valid UTF-8 of nchars code points */
+StrIndex *str_index_build(const char *s, size_t n, size_t nchars) {
+    size_t nmarks = nchars / STR_INDEX_STEP + 1;
+    StrIndex *x = malloc(sizeof(StrIndex) + nmarks * sizeof(size_t));
+    x->nchars = nchars;
+    x->cp = 0;
+    x->off = 0;
+
+    size_t off = 0;
+    for(size_t m = 0; m < nmarks; ++m) {
+        x->marks[m] = off;
+        for(int c = 0; c < STR_INDEX_STEP && off < n; ++c) {
+            off += SEQLEN(s[off]);
+        }
+    }
+
+    return x;
+}
+
+/* inline strings are short enough to walk without an index */
+int str_enc(MxcString *s) {
+    if(s->enc == STR_ENC_UNKNOWN) {
+        size_t nchars;
+        s->enc = utf8_scan(STR_PTR(s), ITERABLE(s)->length, &nchars);
+        if(s->enc == STR_ENC_UTF8 && !s->index &&
+           s->storage != STR_INLINE) {
+            s->index = str_index_build(STR_PTR(s), ITERABLE(s)->length, nchars);
+        }
+    }
+
+    return s->enc;
+}
+
+static StrIndex *cpindex(MxcString *s) {
+    assert(s->storage != STR_INLINE);
+
+    if(!s->index) {
+        size_t nchars;
+        utf8_scan(STR_PTR(s), ITERABLE(s)->length, &nchars);
+        s->index = str_index_build(STR_PTR(s), ITERABLE(s)->length, nchars);
+    }
+
+    return s->index;
+}
+
+size_t str_nchars(MxcString *s) {
+    if(str_enc(s) != STR_ENC_UTF8) return ITERABLE(s)->length;
+
+    if(s->storage == STR_INLINE) {
+        size_t nchars;
+        utf8_scan(s->inl, ITERABLE(s)->length, &nchars);
+        return nchars;
+    }
+
+    return cpindex(s)->nchars;
+}
+
+/*
+ *  Byte offset of code point cp, cp <= str_nchars(s). The walk starts
+ *  from the cursor when it lies between the nearest mark and cp.
+ */
+size_t str_offset(MxcString *s, size_t cp) {
+    if(str_enc(s) != STR_ENC_UTF8) return cp;
+
+    if(s->storage == STR_INLINE) {
+        size_t off = 0;
+        for(size_t c = 0; c < cp && off < ITERABLE(s)->length; ++c) {
+            off += SEQLEN(s->inl[off]);
+        }
+        return off;
+    }
+
+    StrIndex *x = cpindex(s);
+    if(cp >= x->nchars) return ITERABLE(s)->length;
+
+    size_t base = cp - cp % STR_INDEX_STEP;
+    size_t c = base;
+    size_t off = x->marks[cp / STR_INDEX_STEP];
+    if(x->cp >= base && x->cp <= cp) {
+        c = x->cp;
+        off = x->off;
+    }
+    for(; c < cp; ++c) {
+        off += SEQLEN(STR_PTR(s)[off]);
+    }
+
+    x->cp = cp;
+    x->off = off;
+    return off;
+}
+
+/* code point starting at byte offset off */
+size_t str_cpos(MxcString *s, size_t off) {
+    if(str_enc(s) != STR_ENC_UTF8) return off;
+
+    if(s->storage == STR_INLINE) {
+        size_t cp = 0;
+        for(size_t o = 0; o < off; o += SEQLEN(s->inl[o])) {
+            cp++;
+        }
+        return cp;
+    }
+
+    StrIndex *x = cpindex(s);
+    size_t lo = 0;
+    size_t hi = x->nchars / STR_INDEX_STEP;
+
+    while(lo < hi) {
+        size_t mid = (lo + hi + 1) / 2;
+        if(x->marks[mid] <= off) lo = mid;
+        else hi = mid - 1;
+    }
+
+    size_t cp = lo * STR_INDEX_STEP;
+    for(size_t o = x->marks[lo]; o < off; o += SEQLEN(STR_PTR(s)[o])) {
+        cp++;
+    }
+
+    return cp;
+}
+
+size_t utf8_seqlen(char c) {
+    return SEQLEN(c);
+}
@@ -18,6 +18,7 @@
 #include "object/strobject.h"
 #include "literalpool.h"
 #include "gc.h"
+#include "writer.h"
 
 extern int errcnt;
 extern char *filename;
@@ -60,10 +61,13 @@ void mxc_repl_run(const char *src,
     frame->pc = 0;
 
     res = VM_run(frame);
+    writer_flush(&mxc_stdout);
+    /* the frame is reused by the next input */
+    frame->occurred_rterr.type = RTERR_NONEERR;
 
     if(sema_res.isexpr && (res == 0)) {
         MxcValue top = Pop();
-        char *dump = ostr(mval2str(top))->str;
+        char *dump = str_cstr(ostr(mval2str(top)));
         printf("%s : %s\n",
                dump,
                sema_res.tyname);
@@ -6,6 +6,7 @@
 #include "object/object.h"
 #include "internal.h"
 #include "object/strobject.h"
+#include "writer.h"
 
 struct {
     char *str;
@@ -29,6 +30,7 @@ debug_fn search_table(char *input) {
 }
 
 void start_debug(Frame *frame) {
+    writer_flush(&mxc_stdout);
     printf("breakpoint at \n");
     printf("maxc debug mode\n");
     
@@ -74,6 +76,6 @@ void local_vars(Frame *frame) {
     for(size_t i = 0; i < frame->nlvars; ++i) {
         NodeVariable *cur = (NodeVariable *)frame->lvar_info->vars->data[i];
         printf("%s:\t", cur->name);
-        printf("%s\n", ostr(mval2str(frame->lvars[i]))->str);
+        printf("%s\n", str_cstr(ostr(mval2str(frame->lvars[i]))));
     }
 }
@@ -44,6 +44,7 @@ Frame *new_frame(userfunction *u, Frame *prev) {
     f->nlvars = u->nlvars;
     f->stackptr = prev->stackptr;
     f->stackbase = prev->stackbase;
+    f->occurred_rterr.type = RTERR_NONEERR;
 
     return f;
 }
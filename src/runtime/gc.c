@@ -1,38 +1,65 @@
+#define _POSIX_C_SOURCE 200809L
 #include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
 #include <assert.h>
 #include <time.h>
 
 #include "object/object.h"
 #include "gc.h"
+#include "heapprof.h"
 #include "vm.h"
-
-GCHeap root;
-GCHeap *tailp = NULL;
+#include "literalpool.h"
+#include "module.h"
+#include "error/error.h"
 
 clock_t gc_time;
 
-void heap_dump() {
-    GCHeap *ptr = &root;
-    int counter = 0;
-    puts("----- [heap dump] -----");
-    while(ptr) {
-        bool marked = ptr->obj->marked;
-        printf("%s%d: ", marked ? "[marked]" : "", counter++);
-        printf("%s\n", OBJIMPL(ptr->obj)->type_name);
-        ptr = ptr->next;
-    }
-    puts("-----------------------");
-}
+/* set by the allocator when the nursery is full */
+int gc_pending = 0;
+/* some global may hold a young object */
+int gc_globals_dirty = 0;
 
-size_t heap_length() {
-    GCHeap *ptr = &root;
-    size_t i = 0;
-    while(ptr) {
-        ptr = ptr->next;
-        ++i;
-    }
-    return i;
-}
+/* marking a major cycle in slices, see gc_shade */
+int gc_marking = 0;
+static int gc_sweeping = 0;
+static int gc_incremental = 1;
+static int gc_nthreads = 1;
+#ifdef USE_MARK_AND_SWEEP
+/* allocated_mem at the end of the last marking step */
+static size_t marked_at;
+#endif
+
+/* the next major cycle starts when the heap grows by this factor */
+static double gc_growth = 2.0;
+static size_t gc_min_heap = 4 * 1024 * 1024;
+static size_t gc_live_bytes;
+/* compact a size class when more of its slots than this are unused */
+static double gc_compact_limit = 0.5;
+
+#define GC_MARK_SLICE   (1 << 14)
+#define GC_SWEEP_SLICE  32      /* pages */
+
+MxcValue gc_handles[GC_NHANDLE_MAX];
+int gc_nhandles = 0;
+
+static Vector *remembered;
+static Vector *promoted;
+static Vector *gray;
+
+static struct {
+    uint64_t *pauses;   /* nanoseconds */
+    size_t npause;
+    size_t reserved;
+    size_t nmajor;
+    uint64_t remark;    /* nanoseconds spent in final marking */
+    size_t ncompact;
+    size_t released;    /* pages given back to the OS */
+} gc_stats;
+/* builtins and literal objects already moved out of the nursery */
+static int nold_cbltins = 0;
+static int nold_literals = 0;
 
 void stack_dump_weak() {
     MxcValue *base = cur_frame->stackbase;
@@ -49,67 +76,526 @@ void stack_dump_weak() {
     puts("---------------");
 }
 
-static void gc_mark_all() {
+MxcValue *gc_handle(MxcValue v) {
+    if(gc_nhandles == GC_NHANDLE_MAX) {
+        intern_die("too many GC handles");
+    }
+
+    gc_handles[gc_nhandles] = v;
+    return &gc_handles[gc_nhandles++];
+}
+
+void gc_remember(MxcObject *ob) {
+    if(!remembered) {
+        remembered = New_Vector();
+    }
+
+    ob->gc_flags |= GC_REMEMBERED;
+    vec_push(remembered, ob);
+}
+
+static void evacuate(MxcValue *slot) {
+    if(!isobj(*slot)) return;
+
+    MxcObject *ob = slot->obj;
+    if(!IS_YOUNG(ob)) return;
+
+    if(ob->gc_flags & GC_FORWARDED) {
+        /* the forwarding address replaces impl */
+        slot->obj = (MxcObject *)OBJIMPL(ob);
+        return;
+    }
+
+    MxcObject *n = heap_alloc(ob->size);
+    memcpy(n, ob, ob->size);
+    heap_bytes += n->extsize;
+    allocated_mem += n->extsize;
+
+    ob->gc_flags |= GC_FORWARDED;
+    OBJIMPL(ob) = (MxcObjImpl *)n;
+    slot->obj = n;
+    if(gc_marking) {
+        GC_SET_MARK(n);
+    }
+
+    if(OBJIMPL(n)->trace) {
+        vec_push(promoted, n);
+    }
+}
+
+static void evacuate_roots() {
     MxcValue *base = cur_frame->stackbase;
     MxcValue *cur = cur_frame->stackptr;
-    MxcValue val;
     while(base < cur) {
-        val = *--cur;
-        mgc_mark(val);
+        evacuate(--cur);
+    }
+
+    for(Frame *f = cur_frame; f; f = f->prev) {
+        for(size_t i = 0; i < f->nlvars; ++i) {
+            evacuate(&f->lvars[i]);
+        }
+    }
+
+    for(int i = 0; i < gc_nhandles; ++i) {
+        evacuate(&gc_handles[i]);
+    }
+    region_visit(evacuate);
+
+    if(gc_globals_dirty) {
+        for(size_t i = 0; i < cur_frame->ngvars; ++i) {
+            evacuate(&cur_frame->gvars[i]);
+        }
+        gc_globals_dirty = 0;
+    }
+
+    for(; nold_cbltins < Global_Cbltins->len; ++nold_cbltins) {
+        evacuate(&((MxcCBltin *)Global_Cbltins->data[nold_cbltins])->impl);
+    }
+    cmodule_visit(evacuate);
+    for(; ltable && nold_literals < ltable->len; ++nold_literals) {
+        Literal *l = (Literal *)ltable->data[nold_literals];
+        if(l->kind == LIT_RAWOBJ) {
+            evacuate(&l->raw);
+        }
+    }
+}
+
+/*
+ *  Copies the live part of the nursery into the old generation. Only
+ *  roots, remembered objects and survivors are visited.
+ */
+void gc_minor() {
+    if(!promoted) {
+        promoted = New_Vector();
+    }
+    if(!remembered) {
+        remembered = New_Vector();
+    }
+
+    evacuate_roots();
+
+    for(int i = 0; i < remembered->len; ++i) {
+        MxcObject *ob = remembered->data[i];
+
+        ob->gc_flags &= ~GC_REMEMBERED;
+        if(OBJIMPL(ob)->trace) {
+            OBJIMPL(ob)->trace(ob, evacuate);
+        }
+    }
+    remembered->len = 0;
+
+    while(promoted->len > 0) {
+        MxcObject *ob = vec_pop(promoted);
+        OBJIMPL(ob)->trace(ob, evacuate);
+    }
+
+    nursery_reset();
+    gc_pending = 0;
+}
+
+/*
+ *  Major collections mark the old generation incrementally with a
+ *  snapshot-at-the-beginning invariant: everything reachable when the
+ *  roots are scanned stays marked, because overwritten heap slots are
+ *  shaded by the store barrier and objects entering the old generation
+ *  meanwhile are allocated black.
+ */
+static void shade(MxcObject *ob) {
+    if(GC_MARKED(ob)) return;
+
+    GC_SET_MARK(ob);
+    if(OBJIMPL(ob)->trace) {
+        vec_push(gray, ob);
+    }
+}
+
+/* region objects are not marked, their slots are roots instead */
+void gc_shade(MxcValue v) {
+    if(isobj(v) && !IS_YOUNG(v.obj) && !(v.obj->gc_flags & GC_REGION)) {
+        shade(v.obj);
+    }
+}
+
+void gc_visit_roots(ob_visit_fn visit) {
+    MxcValue *base = cur_frame->stackbase;
+    MxcValue *cur = cur_frame->stackptr;
+    while(base < cur) {
+        visit(--cur);
     }
     for(size_t i = 0; i < cur_frame->ngvars; ++i) {
-        val = cur_frame->gvars[i];
-        mgc_mark(val);
+        visit(&cur_frame->gvars[i]);
     }
 
     Frame *f = cur_frame;
     while(f) {
         for(size_t i = 0; i < f->nlvars; ++i) {
-            val = f->lvars[i];
-            mgc_mark(val);
+            visit(&f->lvars[i]);
         }
         f = f->prev;
     }
+    for(int i = 0; i < gc_nhandles; ++i) {
+        visit(&gc_handles[i]);
+    }
+    region_visit(visit);
+
+    for(int i = 0; i < Global_Cbltins->len; ++i) {
+        visit(&((MxcCBltin *)Global_Cbltins->data[i])->impl);
+    }
+    cmodule_visit(visit);
+    for(int i = 0; ltable && i < ltable->len; ++i) {
+        Literal *l = (Literal *)ltable->data[i];
+        if(l->kind == LIT_RAWOBJ) {
+            visit(&l->raw);
+        }
+    }
+}
+
+static void gc_sweep_done() {
+    gc_sweeping = 0;
+    gc_stats.nmajor++;
+
+    /* what survived the cycle, give or take what was allocated meanwhile */
+    gc_live_bytes = heap_bytes;
+    allocated_mem = 0;
+    gc_trigger = (size_t)(gc_live_bytes * gc_growth);
+    if(gc_trigger < gc_min_heap) {
+        gc_trigger = gc_min_heap;
+    }
+
+    heapprof_gc();
+}
+
+#ifdef USE_MARK_AND_SWEEP
+static void mark_slot(MxcValue *slot) {
+    gc_shade(*slot);
+}
+
+/* returns true when no gray object is left */
+static bool gc_mark_step(size_t budget) {
+    while(gray->len > 0 && budget-- > 0) {
+        MxcObject *ob = vec_pop(gray);
+        OBJIMPL(ob)->trace(ob, mark_slot);
+    }
+
+    return gray->len == 0;
 }
 
-static void gc_sweep() {
-    GCHeap *ptr = &root;
-    GCHeap *prev = NULL;
-    GCHeap *next = NULL;
-    MxcObject *ob;
-    while(ptr) {
-        ob = ptr->obj;
-        next = ptr->next;
-        if(ob->marked || ob->gc_guard) {
-            ob->marked = 0;
-            prev = ptr;
+static void gc_major_start() {
+    if(!gray) {
+        gray = New_Vector();
+    }
+
+    gc_marking = 1;
+    gc_visit_roots(mark_slot);
+    marked_at = allocated_mem;
+}
+
+static void forward_slot(MxcValue *slot) {
+    if(isobj(*slot) && !IS_YOUNG(slot->obj)) {
+        slot->obj = heap_forward(slot->obj);
+    }
+}
+
+/* the nursery is empty here, so only old objects are referenced */
+static void gc_compact() {
+    if(!heap_compact_start(gc_compact_limit)) return;
+
+    gc_visit_roots(forward_slot);
+    for(int i = 0; remembered && i < remembered->len; ++i) {
+        remembered->data[i] = heap_forward(remembered->data[i]);
+    }
+    heap_trace_live(forward_slot);
+
+    gc_stats.released += heap_compact_finish();
+    gc_stats.ncompact++;
+}
+
+static uint64_t now_ns(void);
+
+static void gc_major_finish() {
+    uint64_t t = now_ns();
+
+    /* remark: objects shaded by the barrier since the last step */
+    if(gc_nthreads > 1)
+        gc_parallel_mark(gray, gc_nthreads);
+    else
+        gc_mark_step(SIZE_MAX);
+    gc_stats.remark += now_ns() - t;
+    gc_marking = 0;
+
+    if(gc_compact_limit < 1.0) {
+        gc_compact();
+    }
+
+    heap_sweep_start();
+    gc_sweeping = 1;
+    if(!gc_incremental) {
+        heap_sweep_step(SIZE_MAX);
+        gc_sweep_done();
+    }
+}
+
+#endif  /* USE_MARK_AND_SWEEP */
+
+static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void record_pause(uint64_t ns) {
+    if(gc_stats.npause == gc_stats.reserved) {
+        gc_stats.reserved = gc_stats.reserved ? gc_stats.reserved * 2 : 256;
+        gc_stats.pauses = realloc(gc_stats.pauses,
+                                  sizeof(uint64_t) * gc_stats.reserved);
+    }
+    gc_stats.pauses[gc_stats.npause++] = ns;
+}
+
+/* called by the VM where every live value is reachable from a frame */
+void gc_safepoint() {
+    clock_t start = clock();
+    uint64_t t = now_ns();
+
+#ifndef USE_MARK_AND_SWEEP
+    gc_pending = 0;
+    if(heap_bytes >= gc_trigger) {
+        rc_reconcile(true);
+        gc_sweep_done();
+    }
+    else {
+        rc_reconcile(false);
+    }
+#else
+    gc_minor();
+
+    if(gc_marking) {
+        /* mark faster than objects enter the old generation */
+        size_t budget = GC_MARK_SLICE + (allocated_mem - marked_at) / 8;
+        marked_at = allocated_mem;
+        if(gc_mark_step(budget)) {
+            gc_major_finish();
         }
-        else {
-            OBJIMPL(ob)->dealloc(ob);
-            if(prev) prev->next = ptr->next;
-            else root = *ptr->next;
-            free(ptr);
+    }
+    else if(gc_sweeping) {
+        if(heap_sweep_step(GC_SWEEP_SLICE)) {
+            gc_sweep_done();
         }
-        ptr = next;
     }
+    else if(heap_bytes >= gc_trigger) {
+        gc_major_start();
+        /* parallel marking is done in one pause */
+        if(!gc_incremental || gc_nthreads > 1) {
+            gc_major_finish();
+        }
+    }
+#endif  /* USE_MARK_AND_SWEEP */
 
-    tailp = prev;
+    record_pause(now_ns() - t);
+    gc_time += clock() - start;
 }
 
 void gc_run() {
-    /*
-    size_t before = heap_length(); */
-    clock_t start, end;
+    clock_t start = clock();
+    uint64_t t = now_ns();
+
+#ifndef USE_MARK_AND_SWEEP
+    rc_reconcile(true);
+    gc_sweep_done();
+#else
+    gc_minor();
+    if(gc_sweeping) {
+        heap_sweep_step(SIZE_MAX);
+        gc_sweep_done();
+    }
+    if(!gc_marking) {
+        gc_major_start();
+    }
+    gc_major_finish();
+    if(gc_sweeping) {
+        heap_sweep_step(SIZE_MAX);
+        gc_sweep_done();
+    }
+#endif  /* USE_MARK_AND_SWEEP */
+
+    record_pause(now_ns() - t);
+    gc_time += clock() - start;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+static double percentile(double p) {
+    size_t i = (size_t)(p * (gc_stats.npause - 1) + 0.5);
+
+    return gc_stats.pauses[i] / 1e6;
+}
+
+static void report_regions() {
+    fprintf(stderr, "gc: %zu regions released, %zu escaped into the heap\n",
+            region_nreleased, region_nescaped);
+}
+
+static void gc_report() {
+    if(gc_stats.npause == 0) {
+        fprintf(stderr, "gc: no pauses\n");
+        report_regions();
+        return;
+    }
+
+    uint64_t total = 0;
+    for(size_t i = 0; i < gc_stats.npause; ++i) {
+        total += gc_stats.pauses[i];
+    }
+    qsort(gc_stats.pauses, gc_stats.npause, sizeof(uint64_t), cmp_u64);
+
+    fprintf(stderr, "gc: %zu pauses, %zu major cycles, total %.3f ms\n",
+            gc_stats.npause, gc_stats.nmajor, total / 1e6);
+    fprintf(stderr, "gc: heap %zu KiB, %zu KiB live after the last cycle, "
+                    "next cycle at %zu KiB\n",
+            heap_bytes >> 10, gc_live_bytes >> 10, gc_trigger >> 10);
+#ifndef USE_MARK_AND_SWEEP
+    fprintf(stderr, "gc: deferred RC, %zu objects freed in garbage cycles\n",
+            rc_ncycle());
+#endif
+    report_regions();
+    fprintf(stderr, "gc: %zu compactions released %zu KiB\n",
+            gc_stats.ncompact, gc_stats.released * (HEAP_PAGE_SIZE >> 10));
+    fprintf(stderr, "gc: final marking %.3f ms with %d thread%s\n",
+            gc_stats.remark / 1e6, gc_nthreads, gc_nthreads > 1 ? "s" : "");
+    fprintf(stderr, "gc: pause p50 %.3f ms, p90 %.3f ms, p99 %.3f ms, "
+                    "max %.3f ms\n",
+            percentile(0.5), percentile(0.9), percentile(0.99),
+            percentile(1.0));
+}
+
+static bool parse_size(const char *s, size_t *res) {
+    char *end;
+    double n = strtod(s, &end);
+
+    switch(*end) {
+    case 'k': case 'K': n *= 1024; ++end; break;
+    case 'm': case 'M': n *= 1024 * 1024; ++end; break;
+    case 'g': case 'G': n *= 1024 * 1024 * 1024; ++end; break;
+    default: break;
+    }
+    if(end == s || *end || n < 0) return false;
+
+    *res = (size_t)n;
+    return true;
+}
+
+static bool set_growth(const char *s) {
+    char *end;
+    double g = strtod(s, &end);
+    if(end == s || *end || g <= 1.0) return false;
+
+    gc_growth = g;
+    return true;
+}
+
+static bool set_min_heap(const char *s) {
+    if(!parse_size(s, &gc_min_heap)) return false;
+
+    if(gc_stats.nmajor == 0) {
+        gc_trigger = gc_min_heap;
+    }
+    return true;
+}
+
+static bool set_compact(const char *s) {
+    char *end;
+    double f = strtod(s, &end);
+    if(end == s || *end || f < 0) return false;
+
+    gc_compact_limit = f;
+    return true;
+}
+
+static bool set_incremental(const char *s) {
+    gc_incremental = strcmp(s, "0") != 0;
+    return true;
+}
 
-    start = clock();
+static bool set_threads(const char *s) {
+    int n = atoi(s);
+    if(n < 1) return false;
 
-    gc_mark_all();
-    gc_sweep();
+    gc_nthreads = n;
+    return true;
+}
+
+static bool set_stats(const char *s) {
+    static bool registered = false;
+
+    if(*s && strcmp(s, "0") != 0 && !registered) {
+        atexit(gc_report);
+        registered = true;
+    }
+    return true;
+}
+
+/* each option is read from MAXC_GC_<NAME> and --gc-<name>=<value> */
+static const struct {
+    const char *name;
+    bool (*set)(const char *);
+} gc_options[] = {
+    {"growth", set_growth},
+    {"min-heap", set_min_heap},
+    {"compact", set_compact},
+    {"incremental", set_incremental},
+    {"threads", set_threads},
+    {"stats", set_stats},
+};
+
+#define NGCOPTION (sizeof(gc_options) / sizeof(gc_options[0]))
+
+static void gc_set_option(int i, const char *value, const char *from) {
+    if(!gc_options[i].set(value)) {
+        warn("invalid value '%s' for %s, ignored", value, from);
+    }
+}
+
+void gc_init() {
+    for(size_t i = 0; i < NGCOPTION; ++i) {
+        char env[64] = "MAXC_GC_";
+        size_t len = strlen(env);
 
-    end = clock();
+        for(const char *c = gc_options[i].name; *c; ++c) {
+            env[len++] = *c == '-' ? '_' : *c - 'a' + 'A';
+        }
+        env[len] = '\0';
+
+        char *s = getenv(env);
+        if(s) {
+            gc_set_option(i, s, env);
+        }
+    }
+}
+
+/* returns true if arg is a GC flag such as --gc-growth=1.5 */
+bool gc_option(const char *arg) {
+    if(strncmp(arg, "--gc-", 5) != 0) return false;
+
+    for(size_t i = 0; i < NGCOPTION; ++i) {
+        size_t len = strlen(gc_options[i].name);
+
+        if(strncmp(arg + 5, gc_options[i].name, len) != 0) continue;
+        if(arg[5 + len] == '=') {
+            gc_set_option(i, arg + 5 + len + 1, arg);
+            return true;
+        }
+        if(arg[5 + len] == '\0') {
+            /* a bare flag switches the option on */
+            gc_set_option(i, "1", arg);
+            return true;
+        }
+    }
 
-    gc_time += end - start;
-    /*
-    size_t after = heap_length();
-    printf("before: %zdslots, after: %zdslots\n", before, after); */
+    return false;
 }
@@ -0,0 +1,230 @@
+/* parallel marking of the old generation */
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "object/object.h"
+#include "gc.h"
+
+/*
+ *  Every worker owns a Chase-Lev deque: it pushes and takes at the
+ *  bottom, idle workers steal from the top. Deques have a fixed size and
+ *  spill into a shared, locked overflow stack.
+ */
+#define DEQUE_SIZE  (1 << 14)
+#define DEQUE_MASK  (DEQUE_SIZE - 1)
+
+typedef struct MarkWorker {
+    int64_t top;
+    int64_t bottom;
+    MxcObject **buf;
+    pthread_t thread;
+    unsigned int seed;
+} MarkWorker;
+
+static MarkWorker *workers;
+static int nworkers;
+static int nrunning;
+static int nidle;
+
+static pthread_mutex_t overflow_lock = PTHREAD_MUTEX_INITIALIZER;
+static Vector *overflow;
+static int noverflow;
+
+static _Thread_local MarkWorker *self;
+
+#define LOAD(p, o)      __atomic_load_n(p, __ATOMIC_##o)
+#define STORE(p, v, o)  __atomic_store_n(p, v, __ATOMIC_##o)
+#define CAS(p, e, d)                                                        \
+    __atomic_compare_exchange_n(p, e, d, false,                             \
+                                __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)
+#define FENCE()         __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+static bool try_mark(MxcObject *ob) {
+    uint64_t *word = &HEAP_PAGE(ob)->markbits[HEAP_GRANULE_OF(ob) >> 6];
+    uint64_t bit = (uint64_t)1 << (HEAP_GRANULE_OF(ob) & 63);
+
+    if(LOAD(word, RELAXED) & bit) return false;
+
+    return !(__atomic_fetch_or(word, bit, __ATOMIC_RELAXED) & bit);
+}
+
+static void overflow_push(MxcObject *ob) {
+    pthread_mutex_lock(&overflow_lock);
+    vec_push(overflow, ob);
+    STORE(&noverflow, overflow->len, RELAXED);
+    pthread_mutex_unlock(&overflow_lock);
+}
+
+static MxcObject *overflow_pop() {
+    MxcObject *ob = NULL;
+
+    if(LOAD(&noverflow, RELAXED) == 0) return NULL;
+
+    pthread_mutex_lock(&overflow_lock);
+    if(overflow->len > 0) {
+        ob = vec_pop(overflow);
+    }
+    STORE(&noverflow, overflow->len, RELAXED);
+    pthread_mutex_unlock(&overflow_lock);
+
+    return ob;
+}
+
+static void deque_push(MarkWorker *w, MxcObject *ob) {
+    int64_t b = LOAD(&w->bottom, RELAXED);
+    int64_t t = LOAD(&w->top, ACQUIRE);
+
+    if(b - t >= DEQUE_SIZE) {
+        overflow_push(ob);
+        return;
+    }
+
+    STORE(&w->buf[b & DEQUE_MASK], ob, RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    STORE(&w->bottom, b + 1, RELAXED);
+}
+
+static MxcObject *deque_take(MarkWorker *w) {
+    int64_t b = LOAD(&w->bottom, RELAXED) - 1;
+    STORE(&w->bottom, b, RELAXED);
+    FENCE();
+    int64_t t = LOAD(&w->top, RELAXED);
+
+    if(t > b) {
+        STORE(&w->bottom, b + 1, RELAXED);
+        return NULL;
+    }
+
+    MxcObject *ob = LOAD(&w->buf[b & DEQUE_MASK], RELAXED);
+    if(t == b) {
+        /* the last element: race against thieves */
+        if(!CAS(&w->top, &t, t + 1)) {
+            ob = NULL;
+        }
+        STORE(&w->bottom, b + 1, RELAXED);
+    }
+
+    return ob;
+}
+
+static MxcObject *deque_steal(MarkWorker *w) {
+    int64_t t = LOAD(&w->top, ACQUIRE);
+    FENCE();
+    int64_t b = LOAD(&w->bottom, ACQUIRE);
+
+    if(t >= b) return NULL;
+
+    MxcObject *ob = LOAD(&w->buf[t & DEQUE_MASK], RELAXED);
+    if(!CAS(&w->top, &t, t + 1)) {
+        return NULL;
+    }
+
+    return ob;
+}
+
+static void mark_slot(MxcValue *slot) {
+    MxcValue v = *slot;
+
+    if(!isobj(v) || IS_YOUNG(v.obj) || (v.obj->gc_flags & GC_REGION)) return;
+
+    if(try_mark(v.obj) && OBJIMPL(v.obj)->trace) {
+        deque_push(self, v.obj);
+    }
+}
+
+static MxcObject *steal_any() {
+    int start = rand_r(&self->seed) % nworkers;
+
+    for(int i = 0; i < nworkers; ++i) {
+        MarkWorker *victim = &workers[(start + i) % nworkers];
+        if(victim == self) continue;
+
+        MxcObject *ob = deque_steal(victim);
+        if(ob) return ob;
+    }
+
+    return overflow_pop();
+}
+
+static bool work_left() {
+    if(LOAD(&noverflow, RELAXED) > 0) return true;
+
+    for(int i = 0; i < nworkers; ++i) {
+        if(LOAD(&workers[i].top, ACQUIRE) < LOAD(&workers[i].bottom, ACQUIRE))
+            return true;
+    }
+
+    return false;
+}
+
+static void *mark_worker(void *arg) {
+    self = arg;
+
+    for(;;) {
+        MxcObject *ob;
+
+        while((ob = deque_take(self)) || (ob = steal_any())) {
+            OBJIMPL(ob)->trace(ob, mark_slot);
+        }
+
+        /* idle workers own no work, so all idle means marking is done */
+        __atomic_add_fetch(&nidle, 1, __ATOMIC_SEQ_CST);
+        for(;;) {
+            if(LOAD(&nidle, SEQ_CST) == nrunning) return NULL;
+
+            if(work_left()) {
+                __atomic_sub_fetch(&nidle, 1, __ATOMIC_SEQ_CST);
+                break;
+            }
+            sched_yield();
+        }
+    }
+}
+
+/*
+ *  Marks everything reachable from the gray objects, which must already
+ *  be marked, in one stop-the-world phase. The calling thread is worker 0.
+ */
+void gc_parallel_mark(Vector *gray, int nthreads) {
+    if(!workers) {
+        workers = calloc(nthreads, sizeof(MarkWorker));
+        for(int i = 0; i < nthreads; ++i) {
+            workers[i].buf = malloc(sizeof(MxcObject *) * DEQUE_SIZE);
+            workers[i].seed = i + 1;
+        }
+        overflow = New_Vector();
+        nworkers = nthreads;
+    }
+
+    for(int i = 0; i < nworkers; ++i) {
+        workers[i].top = workers[i].bottom = 0;
+    }
+    nidle = 0;
+
+    /* the other workers start by stealing from worker 0 */
+    self = &workers[0];
+    while(gray->len > 0) {
+        deque_push(self, vec_pop(gray));
+    }
+
+    int nthread = 1;
+    STORE(&nrunning, nworkers, SEQ_CST);
+    for(int i = 1; i < nworkers; ++i) {
+        /* run short-handed if a thread cannot be started */
+        if(pthread_create(&workers[nthread].thread, NULL,
+                          mark_worker, &workers[nthread]) == 0)
+            ++nthread;
+        else
+            __atomic_sub_fetch(&nrunning, 1, __ATOMIC_SEQ_CST);
+    }
+
+    mark_worker(&workers[0]);
+
+    for(int i = 1; i < nthread; ++i) {
+        pthread_join(workers[i].thread, NULL);
+    }
+}
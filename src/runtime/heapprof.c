@@ -0,0 +1,652 @@
+/* allocation-site heap profiler and heap snapshots */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "heapprof.h"
+#include "mem.h"
+#include "gc.h"
+#include "error/error.h"
+
+bool heap_profiling = false;
+
+typedef struct AllocSite {
+    const char *func;
+    size_t pc;
+    size_t nalloc;
+    size_t alloc_bytes;
+    size_t nfree;
+    size_t free_bytes;
+    /* totals at the end of the last major cycle */
+    size_t gc_nalloc;
+    size_t gc_alloc_bytes;
+    size_t gc_nfree;
+    size_t gc_free_bytes;
+} AllocSite;
+
+/* site 0 stands for objects allocated before profiling started */
+static AllocSite *sites;
+static uint32_t nsite;
+static uint32_t site_reserved;
+/* open addressing: (function, pc) -> site */
+static uint32_t *site_table;
+static size_t site_mask;
+
+static const char *prefix = "maxc-heap";
+static FILE *prof;
+static size_t ngc;
+static int nsnapshot;
+
+#define SITE_LIVE(s)        ((s)->nalloc - (s)->nfree)
+#define SITE_LIVE_BYTES(s)  ((s)->alloc_bytes - (s)->free_bytes)
+
+static size_t site_hash(const char *func, size_t pc) {
+    uint64_t h = ((uintptr_t)func ^ pc) * 0x9e3779b97f4a7c15ull;
+
+    return h ^ (h >> 29);
+}
+
+static uint32_t new_site(const char *func, size_t pc) {
+    if(nsite == site_reserved) {
+        site_reserved = site_reserved ? site_reserved * 2 : 64;
+        sites = realloc(sites, sizeof(AllocSite) * site_reserved);
+    }
+
+    memset(&sites[nsite], 0, sizeof(AllocSite));
+    sites[nsite].func = func;
+    sites[nsite].pc = pc;
+
+    return nsite++;
+}
+
+static void site_table_grow() {
+    size_t cap = site_mask ? (site_mask + 1) * 2 : 256;
+
+    free(site_table);
+    site_table = calloc(cap, sizeof(uint32_t));
+    site_mask = cap - 1;
+
+    for(uint32_t i = 1; i < nsite; ++i) {
+        size_t h = site_hash(sites[i].func, sites[i].pc) & site_mask;
+        while(site_table[h]) h = (h + 1) & site_mask;
+        site_table[h] = i;
+    }
+}
+
+/* the VM keeps frame->pc at the running instruction while profiling */
+static uint32_t current_site() {
+    const char *func = cur_frame ? cur_frame->func_name : "<init>";
+    size_t pc = cur_frame ? cur_frame->pc : 0;
+    size_t h = site_hash(func, pc) & site_mask;
+    uint32_t i;
+
+    while((i = site_table[h])) {
+        if(sites[i].func == func && sites[i].pc == pc) return i;
+        h = (h + 1) & site_mask;
+    }
+
+    i = new_site(func, pc);
+    if(nsite * 2 > site_mask + 1)
+        site_table_grow();
+    else
+        site_table[h] = i;
+
+    return i;
+}
+
+static uint32_t *site_slot(MxcObject *ob) {
+    HeapPage *page = HEAP_PAGE(ob);
+
+    if(!page->sites) {
+        page->sites = calloc(HEAP_NGRANULE, sizeof(uint32_t));
+    }
+
+    return &page->sites[HEAP_GRANULE_OF(ob)];
+}
+
+static uint32_t site_of(MxcObject *ob) {
+    HeapPage *page = HEAP_PAGE(ob);
+
+    return page->sites ? page->sites[HEAP_GRANULE_OF(ob)] : 0;
+}
+
+static const char *site_name(AllocSite *s) {
+    static char buf[256];
+
+    if(s == sites) return "<untracked>";
+
+    snprintf(buf, sizeof(buf), "%s@%zu", s->func, s->pc);
+    return buf;
+}
+
+void heapprof_alloc(MxcObject *ob) {
+    uint32_t s = current_site();
+
+    *site_slot(ob) = s;
+    sites[s].nalloc++;
+    sites[s].alloc_bytes += HEAP_PAGE(ob)->objsize;
+}
+
+/* ob is about to own n bytes of malloc'd memory */
+void heapprof_resize(MxcObject *ob, size_t n) {
+    if(IS_YOUNG(ob)) return;
+
+    uint32_t s = site_of(ob);
+    if(s == 0) return;
+
+    if(n > ob->extsize)
+        sites[s].alloc_bytes += n - ob->extsize;
+    else
+        sites[s].free_bytes += ob->extsize - n;
+}
+
+void heapprof_free(MxcObject *ob) {
+    HeapPage *page = HEAP_PAGE(ob);
+    if(!page->sites) return;
+
+    uint32_t s = page->sites[HEAP_GRANULE_OF(ob)];
+    page->sites[HEAP_GRANULE_OF(ob)] = 0;
+    if(s == 0) return;
+
+    sites[s].nfree++;
+    sites[s].free_bytes += page->objsize + ob->extsize;
+}
+
+/* compaction slid src into dst */
+void heapprof_move(MxcObject *dst, MxcObject *src) {
+    uint32_t s = site_of(src);
+
+    if(s || HEAP_PAGE(dst)->sites) {
+        *site_slot(dst) = s;
+    }
+    if(s) {
+        HEAP_PAGE(src)->sites[HEAP_GRANULE_OF(src)] = 0;
+    }
+}
+
+static const AllocSite *sort_sites;
+
+static int cmp_live_bytes(const void *a, const void *b) {
+    const AllocSite *x = &sort_sites[*(const uint32_t *)a];
+    const AllocSite *y = &sort_sites[*(const uint32_t *)b];
+    size_t lx = SITE_LIVE_BYTES(x), ly = SITE_LIVE_BYTES(y);
+
+    return (lx < ly) - (lx > ly);
+}
+
+static int cmp_alloc_bytes(const void *a, const void *b) {
+    const AllocSite *x = &sort_sites[*(const uint32_t *)a];
+    const AllocSite *y = &sort_sites[*(const uint32_t *)b];
+
+    return (x->alloc_bytes < y->alloc_bytes) - (x->alloc_bytes > y->alloc_bytes);
+}
+
+static void write_site_header(const char *what) {
+    fprintf(prof, "  %-32s %10s %12s %10s %12s %10s %12s\n",
+            what, "allocs", "bytes", "frees", "bytes", "live", "bytes");
+}
+
+/* called at the end of every major cycle, after the sweep */
+void heapprof_gc() {
+    if(!heap_profiling) return;
+
+    uint32_t *order = malloc(sizeof(uint32_t) * nsite);
+    uint32_t n = 0;
+    for(uint32_t i = 1; i < nsite; ++i) {
+        AllocSite *s = &sites[i];
+        if(s->nalloc != s->gc_nalloc || s->nfree != s->gc_nfree ||
+           s->alloc_bytes != s->gc_alloc_bytes || s->free_bytes != s->gc_free_bytes)
+            order[n++] = i;
+    }
+    sort_sites = sites;
+    qsort(order, n, sizeof(uint32_t), cmp_live_bytes);
+
+    fprintf(prof, "gc %zu: heap %zu KiB\n", ++ngc, heap_bytes >> 10);
+    write_site_header("site");
+    for(uint32_t i = 0; i < n; ++i) {
+        AllocSite *s = &sites[order[i]];
+
+        fprintf(prof, "  %-32s %10zu %12zu %10zu %12zu %10zu %12zu\n",
+                site_name(s),
+                s->nalloc - s->gc_nalloc, s->alloc_bytes - s->gc_alloc_bytes,
+                s->nfree - s->gc_nfree, s->free_bytes - s->gc_free_bytes,
+                SITE_LIVE(s), SITE_LIVE_BYTES(s));
+
+        s->gc_nalloc = s->nalloc;
+        s->gc_alloc_bytes = s->alloc_bytes;
+        s->gc_nfree = s->nfree;
+        s->gc_free_bytes = s->free_bytes;
+    }
+    fputc('\n', prof);
+
+    free(order);
+}
+
+/*
+ *  Snapshots number the objects reachable after a full collection. Node
+ *  0 stands for the roots. Retained sizes come from the dominator tree,
+ *  computed with the iterative algorithm of Cooper, Harvey and Kennedy.
+ */
+#define NO_NODE     SIZE_MAX
+#define MAX_TYPE    64
+
+static MxcObject **nodes;
+static size_t nnode;
+static size_t node_reserved;
+/* open addressing: object -> node */
+static size_t *node_table;
+static size_t node_mask;
+/* successors of node i are edges[first_edge[i] .. first_edge[i + 1]) */
+static size_t *edges;
+static size_t nedge;
+static size_t edge_reserved;
+
+static MxcObjImpl *types[MAX_TYPE];
+static int ntype;
+
+static size_t node_of(MxcObject *ob) {
+    size_t h = site_hash((const char *)ob, 0) & node_mask;
+    size_t i;
+
+    while((i = node_table[h]) != 0) {
+        if(nodes[i] == ob) return i;
+        h = (h + 1) & node_mask;
+    }
+
+    if(nnode == node_reserved) {
+        node_reserved *= 2;
+        nodes = realloc(nodes, sizeof(MxcObject *) * node_reserved);
+    }
+    nodes[nnode] = ob;
+    node_table[h] = nnode;
+
+    return nnode++;
+}
+
+static void snap_edge(MxcValue *slot) {
+    if(!isobj(*slot)) return;
+
+    if(nedge == edge_reserved) {
+        edge_reserved *= 2;
+        edges = realloc(edges, sizeof(size_t) * edge_reserved);
+    }
+    edges[nedge++] = node_of(slot->obj);
+}
+
+static int type_of(MxcObject *ob) {
+    for(int t = 0; t < ntype; ++t) {
+        if(types[t] == OBJIMPL(ob)) return t;
+    }
+    if(ntype == MAX_TYPE - 1) return MAX_TYPE - 1;
+
+    types[ntype] = OBJIMPL(ob);
+    return ntype++;
+}
+
+static const char *type_name(int t) {
+    return t < ntype ? types[t]->type_name : "<other>";
+}
+
+static size_t shallow_size(MxcObject *ob) {
+    return HEAP_PAGE(ob)->objsize + ob->extsize;
+}
+
+/* walks the graph from the roots and records the successors of each node */
+static size_t *snap_graph() {
+    size_t cap = 64;
+    while(cap < (heap_length() + 16) * 2) cap *= 2;
+
+    node_table = calloc(cap, sizeof(size_t));
+    node_mask = cap - 1;
+    node_reserved = 1024;
+    nodes = malloc(sizeof(MxcObject *) * node_reserved);
+    nodes[0] = NULL;
+    nnode = 1;
+    edge_reserved = 1024;
+    edges = malloc(sizeof(size_t) * edge_reserved);
+    nedge = 0;
+
+    size_t reserved = 1024;
+    size_t *first_edge = malloc(sizeof(size_t) * reserved);
+
+    first_edge[0] = 0;
+    gc_visit_roots(snap_edge);
+    for(size_t i = 1; i <= nnode; ++i) {
+        if(i + 1 >= reserved) {
+            reserved *= 2;
+            first_edge = realloc(first_edge, sizeof(size_t) * reserved);
+        }
+        first_edge[i] = nedge;
+        if(i < nnode && OBJIMPL(nodes[i])->trace) {
+            OBJIMPL(nodes[i])->trace(nodes[i], snap_edge);
+        }
+    }
+
+    return first_edge;
+}
+
+static size_t intersect(size_t a, size_t b, size_t *idom, size_t *post) {
+    while(a != b) {
+        while(post[a] < post[b]) a = idom[a];
+        while(post[b] < post[a]) b = idom[b];
+    }
+
+    return a;
+}
+
+/* returns the immediate dominator of each node, and its postorder */
+static size_t *dominators(size_t *first_edge, size_t *post, size_t *order) {
+    size_t *stack = malloc(sizeof(size_t) * nnode);
+    size_t *next = malloc(sizeof(size_t) * nnode);
+    char *seen = calloc(nnode, 1);
+    size_t sp = 0, n = 0;
+
+    stack[sp++] = 0;
+    next[0] = first_edge[0];
+    seen[0] = 1;
+    while(sp > 0) {
+        size_t v = stack[sp - 1];
+
+        if(next[v] < first_edge[v + 1]) {
+            size_t w = edges[next[v]++];
+            if(!seen[w]) {
+                seen[w] = 1;
+                next[w] = first_edge[w];
+                stack[sp++] = w;
+            }
+        }
+        else {
+            post[v] = n;
+            order[n++] = v;
+            --sp;
+        }
+    }
+
+    /* predecessors in the same layout as the successors */
+    size_t *first_pred = calloc(nnode + 1, sizeof(size_t));
+    size_t *preds = malloc(sizeof(size_t) * (nedge + 1));
+    for(size_t e = 0; e < nedge; ++e) {
+        first_pred[edges[e] + 1]++;
+    }
+    for(size_t i = 0; i < nnode; ++i) {
+        first_pred[i + 1] += first_pred[i];
+    }
+    memcpy(next, first_pred, sizeof(size_t) * nnode);
+    for(size_t v = 0; v < nnode; ++v) {
+        for(size_t e = first_edge[v]; e < first_edge[v + 1]; ++e) {
+            preds[next[edges[e]]++] = v;
+        }
+    }
+
+    size_t *idom = malloc(sizeof(size_t) * nnode);
+    for(size_t i = 0; i < nnode; ++i) {
+        idom[i] = NO_NODE;
+    }
+    idom[0] = 0;
+
+    bool changed = true;
+    while(changed) {
+        changed = false;
+        /* reverse postorder, skipping the root */
+        for(size_t k = nnode - 1; k-- > 0;) {
+            size_t v = order[k];
+            size_t d = NO_NODE;
+
+            for(size_t e = first_pred[v]; e < first_pred[v + 1]; ++e) {
+                size_t p = preds[e];
+                if(idom[p] == NO_NODE) continue;
+
+                d = d == NO_NODE ? p : intersect(p, d, idom, post);
+            }
+            if(idom[v] != d) {
+                idom[v] = d;
+                changed = true;
+            }
+        }
+    }
+
+    free(stack);
+    free(next);
+    free(seen);
+    free(first_pred);
+    free(preds);
+
+    return idom;
+}
+
+typedef struct TypeStat {
+    size_t count;
+    size_t bytes;
+    size_t retained;
+} TypeStat;
+
+static int cmp_site_name(const void *a, const void *b) {
+    const AllocSite *x = &sort_sites[*(const uint32_t *)a];
+    const AllocSite *y = &sort_sites[*(const uint32_t *)b];
+    int c = strcmp(x->func, y->func);
+
+    if(c) return c;
+    return (x->pc > y->pc) - (x->pc < y->pc);
+}
+
+#define NLARGEST    10
+
+static void write_snapshot(FILE *fp) {
+    size_t *first_edge = snap_graph();
+    size_t *post = malloc(sizeof(size_t) * nnode);
+    size_t *order = malloc(sizeof(size_t) * nnode);
+    size_t *idom = dominators(first_edge, post, order);
+
+    int *type = malloc(sizeof(int) * nnode);
+    size_t *retained = malloc(sizeof(size_t) * nnode);
+    size_t total = 0;
+    type[0] = MAX_TYPE;
+    retained[0] = 0;
+    for(size_t v = 1; v < nnode; ++v) {
+        type[v] = type_of(nodes[v]);
+        retained[v] = shallow_size(nodes[v]);
+        total += retained[v];
+    }
+    /* dominators come later in postorder */
+    for(size_t k = 0; k + 1 < nnode; ++k) {
+        size_t v = order[k];
+        retained[idom[v]] += retained[v];
+    }
+
+    /*
+     *  The retained size of a type only counts the objects that no other
+     *  object of the same type dominates, so nested ones are not counted
+     *  twice.
+     */
+    TypeStat tstat[MAX_TYPE] = {{0}};
+    uint64_t *above = malloc(sizeof(uint64_t) * nnode);
+    above[0] = 0;
+    for(size_t k = nnode - 1; k-- > 0;) {
+        size_t v = order[k];
+        size_t d = idom[v];
+        uint64_t bit = (uint64_t)1 << type[v];
+
+        above[v] = d == 0 ? 0 : above[d] | ((uint64_t)1 << type[d]);
+        tstat[type[v]].count++;
+        tstat[type[v]].bytes += shallow_size(nodes[v]);
+        if(!(above[v] & bit)) {
+            tstat[type[v]].retained += retained[v];
+        }
+    }
+
+    fprintf(fp, "# maxc heap snapshot %d\n", nsnapshot);
+    fprintf(fp, "# %zu objects, %zu bytes reachable\n\n", nnode - 1, total);
+
+    int tord[MAX_TYPE];
+    for(int t = 0; t < ntype; ++t) {
+        tord[t] = t;
+    }
+    for(int i = 1; i < ntype; ++i) {
+        for(int j = i; j > 0 && strcmp(type_name(tord[j - 1]), type_name(tord[j])) > 0; --j) {
+            int t = tord[j]; tord[j] = tord[j - 1]; tord[j - 1] = t;
+        }
+    }
+
+    fprintf(fp, "%-34s %10s %12s %12s\n", "types", "count", "bytes", "retained");
+    for(int i = 0; i < ntype; ++i) {
+        TypeStat *s = &tstat[tord[i]];
+        if(s->count == 0) continue;
+
+        fprintf(fp, "  %-32s %10zu %12zu %12zu\n",
+                type_name(tord[i]), s->count, s->bytes, s->retained);
+    }
+
+    /* reachable objects per allocation site */
+    size_t *scount = calloc(nsite, sizeof(size_t));
+    size_t *sbytes = calloc(nsite, sizeof(size_t));
+    for(size_t v = 1; v < nnode; ++v) {
+        uint32_t s = site_of(nodes[v]);
+        scount[s]++;
+        sbytes[s] += shallow_size(nodes[v]);
+    }
+    uint32_t *sord = malloc(sizeof(uint32_t) * nsite);
+    uint32_t n = 0;
+    for(uint32_t i = 1; i < nsite; ++i) {
+        if(scount[i]) sord[n++] = i;
+    }
+    sort_sites = sites;
+    qsort(sord, n, sizeof(uint32_t), cmp_site_name);
+
+    fprintf(fp, "\n%-34s %10s %12s\n", "sites", "count", "bytes");
+    if(scount[0]) {
+        fprintf(fp, "  %-32s %10zu %12zu\n", site_name(&sites[0]), scount[0], sbytes[0]);
+    }
+    for(uint32_t i = 0; i < n; ++i) {
+        fprintf(fp, "  %-32s %10zu %12zu\n",
+                site_name(&sites[sord[i]]), scount[sord[i]], sbytes[sord[i]]);
+    }
+
+    /* references between types; row MAX_TYPE is the roots */
+    static size_t tedge[MAX_TYPE + 1][MAX_TYPE];
+    memset(tedge, 0, sizeof(tedge));
+    for(size_t v = 0; v < nnode; ++v) {
+        for(size_t e = first_edge[v]; e < first_edge[v + 1]; ++e) {
+            tedge[type[v]][type[edges[e]]]++;
+        }
+    }
+
+    fprintf(fp, "\n%-34s %10s\n", "edges", "count");
+    for(int i = -1; i < ntype; ++i) {
+        int from = i < 0 ? MAX_TYPE : tord[i];
+
+        for(int j = 0; j < ntype; ++j) {
+            size_t c = tedge[from][tord[j]];
+            if(c == 0) continue;
+
+            char buf[80];
+            snprintf(buf, sizeof(buf), "%s -> %s",
+                     i < 0 ? "<roots>" : type_name(from), type_name(tord[j]));
+            fprintf(fp, "  %-32s %10zu\n", buf, c);
+        }
+    }
+
+    /* the objects retaining the most */
+    size_t largest[NLARGEST];
+    int nlargest = 0;
+    for(size_t v = 1; v < nnode; ++v) {
+        if(nlargest == NLARGEST && retained[v] <= retained[largest[NLARGEST - 1]])
+            continue;
+
+        int j = nlargest < NLARGEST ? nlargest++ : NLARGEST - 1;
+        for(; j > 0 && retained[largest[j - 1]] < retained[v]; --j) {
+            largest[j] = largest[j - 1];
+        }
+        largest[j] = v;
+    }
+
+    fprintf(fp, "\n%-34s %-24s %12s\n", "largest", "site", "retained");
+    for(int i = 0; i < nlargest; ++i) {
+        size_t v = largest[i];
+        fprintf(fp, "  %-32s %-24s %12zu\n",
+                type_name(type[v]), site_name(&sites[site_of(nodes[v])]), retained[v]);
+    }
+
+    free(first_edge);
+    free(post);
+    free(order);
+    free(idom);
+    free(type);
+    free(retained);
+    free(above);
+    free(scount);
+    free(sbytes);
+    free(sord);
+    free(nodes);
+    free(node_table);
+    free(edges);
+}
+
+/* writes <prefix>.<n>.snap after a full collection */
+void heapprof_snapshot() {
+    if(!heap_profiling || !cur_frame) return;
+
+    gc_run();
+
+    char path[1024];
+    snprintf(path, sizeof(path), "%s.%d.snap", prefix, ++nsnapshot);
+    FILE *fp = fopen(path, "w");
+    if(!fp) {
+        warn("cannot open %s", path);
+        return;
+    }
+
+    write_snapshot(fp);
+    fclose(fp);
+}
+
+static void heapprof_finish() {
+    heapprof_snapshot();
+
+    uint32_t *order = malloc(sizeof(uint32_t) * nsite);
+    uint32_t n = 0;
+    for(uint32_t i = 1; i < nsite; ++i) {
+        order[n++] = i;
+    }
+    sort_sites = sites;
+    qsort(order, n, sizeof(uint32_t), cmp_alloc_bytes);
+
+    fprintf(prof, "total: %zu major cycles, %d snapshots\n", ngc, nsnapshot);
+    write_site_header("site");
+    for(uint32_t i = 0; i < n; ++i) {
+        AllocSite *s = &sites[order[i]];
+
+        fprintf(prof, "  %-32s %10zu %12zu %10zu %12zu %10zu %12zu\n",
+                site_name(s), s->nalloc, s->alloc_bytes, s->nfree,
+                s->free_bytes, SITE_LIVE(s), SITE_LIVE_BYTES(s));
+    }
+
+    free(order);
+    fclose(prof);
+    heap_profiling = false;
+}
+
+/* returns true if arg is --heap-profile[=<prefix>] */
+bool heapprof_option(const char *arg) {
+    if(strncmp(arg, "--heap-profile", 14) != 0) return false;
+
+    if(arg[14] == '=')
+        prefix = arg + 15;
+    else if(arg[14] != '\0')
+        return false;
+
+    char path[1024];
+    snprintf(path, sizeof(path), "%s.prof", prefix);
+    prof = fopen(path, "w");
+    if(!prof) {
+        warn("cannot open %s, heap profiling disabled", path);
+        return true;
+    }
+
+    new_site("<untracked>", 0);
+    site_table_grow();
+    heap_profiling = true;
+    atexit(heapprof_finish);
+
+    return true;
+}
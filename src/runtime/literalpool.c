@@ -10,7 +10,7 @@ Literal *New_Literal() {
     return l;
 }
 
-Literal *New_Literal_With_Str(char *str) {
+Literal *New_Literal_With_Str(InternedStr *str) {
     Literal *l = xmalloc(sizeof(Literal));
     l->kind = LIT_STR;
     l->str = str;
@@ -51,15 +51,16 @@ Literal *New_Literal_Object(MxcValue o) {
 }
 
 int lpool_push_str(Vector *table, char *s) {
-    for(int i = 0; i < table->len; ++i) {
-        Literal *cur = (Literal *)table->data[i];
-
-        if(cur->kind != LIT_STR) continue;
-        if(strcmp(cur->str, s) == 0) return i;
+    InternedStr *is = str_intern(s, strlen(s));
+    /* the key is remembered per entry; check it belongs to this table */
+    if(is->lit != -1 && is->lit < table->len) {
+        Literal *cur = (Literal *)table->data[is->lit];
+        if(cur->kind == LIT_STR && cur->str == is) return is->lit;
     }
 
     int key = table->len;
-    vec_push(table, New_Literal_With_Str(s));
+    vec_push(table, New_Literal_With_Str(is));
+    is->lit = key;
 
     return key;
 }
@@ -119,7 +120,7 @@ void lpooldump(Vector *table) {
 
         switch(a->kind) {
         case LIT_STR:
-            printf(" str: '%s' ", a->str);
+            printf(" str: '%s' ", a->str->str);
             break;
         case LIT_FNUM:
             printf(" fnum: %lf ", a->fnumber);
@@ -1,86 +1,709 @@
+#define _DEFAULT_SOURCE
 #include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/mman.h>
 
 #include "mem.h"
 #include "internal.h"
 #include "gc.h"
+#include "heapprof.h"
+#include "region.h"
+#include "util.h"
 
+size_t heap_bytes = 0;
+/* bytes entering the old generation since the last major GC */
 size_t allocated_mem = 0;
-size_t threshold = 1024;
+size_t gc_trigger = 4 * 1024 * 1024;
 
-#ifdef OBJECT_POOL
-ObjectPool obpool;
+uint8_t *nursery_start;
+static uint8_t *nursery_top;
+#ifdef USE_MARK_AND_SWEEP
+static uint8_t *nursery_end;
+#endif
+/* young objects that own malloc'd memory */
+static Vector *nursery_owners;
+/* their bytes, or all bytes allocated while profiling */
+static size_t nursery_ext;
+
+#define NCLASS HEAP_NCLASS
 
-#define NALLOC 1024
+static const uint32_t class_size[NCLASS] = {
+    16, 32, 48, 64, 96, 128, 192, 256,
+};
 
-void New_Objectpool() {
-    obpool.pool = malloc(sizeof(MxcObject *) * NALLOC);
-    obpool.reserved = obpool.len = NALLOC;
+typedef struct SizeClass {
+    HeapPage *pages;
+    HeapPage *avail;
+} SizeClass;
 
-    for(int i = 0; i < NALLOC; ++i) {
-        obpool.pool[i] = malloc(sizeof(union obalign));
+static SizeClass classes[NCLASS];
+/* pages of the classes being compacted, in sliding order */
+static HeapPage **compact_order[NCLASS];
+static size_t compact_npages[NCLASS];
+static int sweep_class = NCLASS;
+static HeapPage *sweep_cursor;
+/* granule count -> size class */
+static uint8_t class_of[HEAP_MAX_SMALL / HEAP_GRANULE + 1];
+static bool heap_ready = false;
+
+static void *os_map(size_t len) {
+    void *p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(p == MAP_FAILED) {
+        intern_die("out of memory");
     }
+
+    return p;
 }
 
-/* free */
-void obpool_push(MxcObject *ob) {
-    if(obpool.reserved == obpool.len) {
-        obpool.reserved *= 2;
-        obpool.pool =
-            realloc(obpool.pool, sizeof(MxcObject *) * obpool.reserved);
+static void heap_init() {
+    int c = 0;
+    for(size_t g = 0; g <= HEAP_MAX_SMALL / HEAP_GRANULE; ++g) {
+        while(class_size[c] < g * HEAP_GRANULE) ++c;
+        class_of[g] = c;
     }
-    memset(ob, 0, sizeof(union obalign));
 
-    obpool.pool[obpool.len++] = ob;
+#ifdef USE_MARK_AND_SWEEP
+    nursery_start = nursery_top = os_map(NURSERY_SIZE);
+    nursery_end = nursery_start + NURSERY_SIZE;
+    nursery_owners = New_Vector();
+#endif
+
+    heap_ready = true;
 }
 
-static MxcObject *obpool_pop() { return obpool.pool[--obpool.len]; }
+static void *page_map() {
+    /* over-map and trim so that the page is aligned to its size */
+    size_t len = HEAP_PAGE_SIZE * 2;
+    uint8_t *raw = os_map(len);
 
-#endif /* OBJECT_POOL */
+    uintptr_t aligned = ((uintptr_t)raw + HEAP_PAGE_SIZE - 1) &
+                        ~(uintptr_t)(HEAP_PAGE_SIZE - 1);
+    size_t head = aligned - (uintptr_t)raw;
 
-MxcObject *Mxc_malloc(size_t s) {
-    if(++allocated_mem >= threshold) {
-        allocated_mem = 0;
-        gc_run();
+    if(head) munmap(raw, head);
+    munmap((uint8_t *)aligned + HEAP_PAGE_SIZE, HEAP_PAGE_SIZE - head);
+
+    return (void *)aligned;
+}
+
+static void avail_push(SizeClass *cls, HeapPage *page) {
+    if(page->inavail) return;
+
+    page->inavail = 1;
+    page->next_avail = cls->avail;
+    cls->avail = page;
+}
+
+static void page_init(HeapPage *page, int sc) {
+    memset(page, 0, sizeof(HeapPage));
+    page->objsize = class_size[sc];
+    page->sizeclass = sc;
+    page->first = (sizeof(HeapPage) + HEAP_GRANULE - 1) >> HEAP_GRANULE_SHIFT;
+    page->nslot = (HEAP_PAGE_SIZE - ((size_t)page->first << HEAP_GRANULE_SHIFT)) /
+                  page->objsize;
+}
+
+static HeapPage *new_page(int sc) {
+    HeapPage *page = page_map();
+    SizeClass *cls = &classes[sc];
+
+    page_init(page, sc);
+
+    uint8_t *base = (uint8_t *)page;
+    size_t start = (size_t)page->first << HEAP_GRANULE_SHIFT;
+
+    /* free list in address order */
+    for(size_t i = page->nslot; i-- > 0;) {
+        MxcObject *ob = (MxcObject *)(base + start + i * page->objsize);
+        *(MxcObject **)ob = page->freelist;
+        page->freelist = ob;
+    }
+    page->nfree = page->nslot;
+
+    page->next = cls->pages;
+    cls->pages = page;
+    avail_push(cls, page);
+
+    return page;
+}
+
+static void sweep_page(HeapPage *page) {
+    uint8_t *base = (uint8_t *)page;
+
+    for(int w = 0; w < HEAP_BITMAP_WORDS; ++w) {
+        uint64_t dead = page->allocbits[w] & ~page->markbits[w];
+
+        while(dead) {
+            int bit = __builtin_ctzll(dead);
+            dead &= dead - 1;
+
+            MxcObject *ob =
+                (MxcObject *)(base + (((size_t)w * 64 + bit) << HEAP_GRANULE_SHIFT));
+            OBJIMPL(ob)->dealloc(ob);
+        }
     }
 
-#ifdef OBJECT_POOL
-    INTERN_UNUSE(s);
-    if(obpool.len == 0) {
-        New_Objectpool();
+    memset(page->markbits, 0, sizeof(page->markbits));
+    page->unswept = 0;
+}
+
+MxcObject *heap_alloc(size_t size) {
+    if(size > HEAP_MAX_SMALL) {
+        intern_die("object too large for the heap");
     }
-    MxcObject *ob = obpool_pop();
-#else
-    MxcObject *ob = malloc(s);
-    if(!ob) {
-        gc_run();
-        ob = malloc(s);
-        if(!ob) {
-            return NULL;
+
+    int sc = class_of[(size + HEAP_GRANULE - 1) >> HEAP_GRANULE_SHIFT];
+    SizeClass *cls = &classes[sc];
+    HeapPage *page;
+
+    while((page = cls->avail)) {
+        /* garbage left from the last marking must go before reuse */
+        if(page->unswept) sweep_page(page);
+        if(page->freelist) break;
+
+        page->inavail = 0;
+        cls->avail = page->next_avail;
+    }
+    if(!page) {
+        page = new_page(sc);
+    }
+
+    MxcObject *ob = page->freelist;
+    page->freelist = *(MxcObject **)ob;
+    page->nfree--;
+    BITMAP_SET(page->allocbits, HEAP_GRANULE_OF(ob));
+    heap_bytes += page->objsize;
+    allocated_mem += page->objsize;
+
+    return ob;
+}
+
+void heap_free(MxcObject *ob) {
+    /* the nursery is reclaimed as a whole by nursery_reset */
+    if(IS_YOUNG(ob)) return;
+
+    HeapPage *page = HEAP_PAGE(ob);
+    /* and regions when they exit */
+    if(page->region) return;
+
+    if(heap_profiling) {
+        heapprof_free(ob);
+    }
+    heap_bytes -= page->objsize + ob->extsize;
+    BITMAP_CLEAR(page->allocbits, HEAP_GRANULE_OF(ob));
+    *(MxcObject **)ob = page->freelist;
+    page->freelist = ob;
+    page->nfree++;
+
+    avail_push(&classes[page->sizeclass], page);
+}
+
+/*
+ *  Pages are swept lazily after marking: in steps at safepoints, or
+ *  when the allocator is about to reuse one.
+ */
+void heap_sweep_start() {
+    for(size_t c = 0; c < NCLASS; ++c) {
+        for(HeapPage *p = classes[c].pages; p; p = p->next) {
+            p->unswept = 1;
+        }
+    }
+
+    sweep_class = 0;
+    sweep_cursor = classes[0].pages;
+}
+
+/* returns true when every page is swept */
+bool heap_sweep_step(size_t npages) {
+    while(npages > 0) {
+        while(!sweep_cursor) {
+            if(++sweep_class >= (int)NCLASS) return true;
+            sweep_cursor = classes[sweep_class].pages;
+        }
+
+        if(sweep_cursor->unswept) {
+            sweep_page(sweep_cursor);
+            --npages;
+        }
+        sweep_cursor = sweep_cursor->next;
+    }
+
+    return false;
+}
+
+void heap_sweep() {
+    heap_sweep_start();
+    heap_sweep_step(SIZE_MAX);
+}
+
+static MxcObject *slot_at(HeapPage *page, size_t i) {
+    return (MxcObject *)((uint8_t *)page + ((size_t)page->first << HEAP_GRANULE_SHIFT) +
+                         i * page->objsize);
+}
+
+static size_t page_live(HeapPage *page) {
+    size_t n = 0;
+    for(int w = 0; w < HEAP_BITMAP_WORDS; ++w) {
+        n += __builtin_popcountll(page->markbits[w]);
+    }
+
+    return n;
+}
+
+static void free_unmarked(HeapPage *page) {
+    for(int w = 0; w < HEAP_BITMAP_WORDS; ++w) {
+        uint64_t dead = page->allocbits[w] & ~page->markbits[w];
+
+        while(dead) {
+            int bit = __builtin_ctzll(dead);
+            dead &= dead - 1;
+
+            MxcObject *ob = (MxcObject *)((uint8_t *)page +
+                                          (((size_t)w * 64 + bit) << HEAP_GRANULE_SHIFT));
+            OBJIMPL(ob)->dealloc(ob);
+        }
+    }
+}
+
+/*
+ *  Sliding compaction, run right after marking while the nursery is
+ *  empty. Live objects of a class keep their order and slide towards the
+ *  front of its page list, so an object's new slot is its rank among the
+ *  marked objects of the class.
+ *
+ *  Picks the classes whose unused share of slots exceeds limit and frees
+ *  their garbage. Returns false if there is nothing to compact.
+ */
+bool heap_compact_start(double limit) {
+    bool any = false;
+
+    for(size_t c = 0; c < NCLASS; ++c) {
+        SizeClass *cls = &classes[c];
+        size_t npages = 0, nslot = 0, live = 0;
+
+        for(HeapPage *p = cls->pages; p; p = p->next) {
+            npages++;
+            nslot = p->nslot;
+            live += page_live(p);
+        }
+        if(npages == 0) continue;
+
+        size_t need = (live + nslot - 1) / nslot;
+        if(need == npages || 1.0 - (double)live / (npages * nslot) <= limit) continue;
+
+        HeapPage **order = malloc(sizeof(HeapPage *) * npages);
+        size_t i = 0, rank = 0;
+        for(HeapPage *p = cls->pages; p; p = p->next) {
+            order[i++] = p;
+            p->rank = malloc(sizeof(uint32_t) * HEAP_BITMAP_WORDS);
+            for(int w = 0; w < HEAP_BITMAP_WORDS; ++w) {
+                p->rank[w] = rank;
+                rank += __builtin_popcountll(p->markbits[w]);
+            }
+            free_unmarked(p);
+        }
+
+        compact_order[c] = order;
+        compact_npages[c] = npages;
+        any = true;
+    }
+
+    return any;
+}
+
+/* new address of a marked object */
+MxcObject *heap_forward(MxcObject *ob) {
+    HeapPage *page = HEAP_PAGE(ob);
+    if(!page->rank) return ob;
+
+    size_t g = HEAP_GRANULE_OF(ob);
+    uint64_t below = page->markbits[g >> 6] & (((uint64_t)1 << (g & 63)) - 1);
+    size_t k = page->rank[g >> 6] + __builtin_popcountll(below);
+
+    return slot_at(compact_order[page->sizeclass][k / page->nslot], k % page->nslot);
+}
+
+/* visits the slots of every object surviving the current cycle */
+void heap_trace_live(ob_visit_fn visit) {
+    for(size_t c = 0; c < NCLASS; ++c) {
+        for(HeapPage *p = classes[c].pages; p; p = p->next) {
+            for(size_t i = 0; i < p->nslot; ++i) {
+                MxcObject *ob = slot_at(p, i);
+                size_t g = HEAP_GRANULE_OF(ob);
+
+                if(BITMAP_TEST(p->markbits, g) && OBJIMPL(ob)->trace) {
+                    OBJIMPL(ob)->trace(ob, visit);
+                }
+            }
         }
     }
-#endif  /* OBJECT_POOL */
+}
+
+static size_t compact_class(int c) {
+    SizeClass *cls = &classes[c];
+    HeapPage **order = compact_order[c];
+    size_t npages = compact_npages[c];
+    size_t nslot = order[0]->nslot;
+    size_t k = 0, released = 0;
+
+    /* slots in front of an object are already vacated */
+    for(size_t i = 0; i < npages; ++i) {
+        HeapPage *p = order[i];
+
+        for(int w = 0; w < HEAP_BITMAP_WORDS; ++w) {
+            uint64_t live = p->markbits[w];
+
+            while(live) {
+                int bit = __builtin_ctzll(live);
+                live &= live - 1;
+
+                MxcObject *src = (MxcObject *)((uint8_t *)p +
+                                               (((size_t)w * 64 + bit) << HEAP_GRANULE_SHIFT));
+                MxcObject *dst = slot_at(order[k / nslot], k % nslot);
+                if(dst != src) {
+                    memcpy(dst, src, src->size);
+                    if(heap_profiling) {
+                        heapprof_move(dst, src);
+                    }
+                }
+                k++;
+            }
+        }
+    }
+
+    /*
+     *  Rebuild the pages. Objects stay marked so that the sweep that
+     *  follows keeps them.
+     */
+    cls->pages = cls->avail = NULL;
+    HeapPage **tail = &cls->pages;
+    for(size_t i = 0; i < npages; ++i) {
+        HeapPage *p = order[i];
+        size_t used = k > i * nslot ? k - i * nslot : 0;
+        if(used > nslot) used = nslot;
+
+        free(p->rank);
+        p->rank = NULL;
+
+        if(used == 0) {
+            free(p->sites);
+            munmap(p, HEAP_PAGE_SIZE);
+            released++;
+            continue;
+        }
+
+        memset(p->allocbits, 0, sizeof(p->allocbits));
+        memset(p->markbits, 0, sizeof(p->markbits));
+        p->freelist = NULL;
+        for(size_t s = nslot; s-- > 0;) {
+            MxcObject *ob = slot_at(p, s);
+
+            if(s < used) {
+                BITMAP_SET(p->allocbits, HEAP_GRANULE_OF(ob));
+                BITMAP_SET(p->markbits, HEAP_GRANULE_OF(ob));
+            }
+            else {
+                *(MxcObject **)ob = p->freelist;
+                p->freelist = ob;
+            }
+        }
+        p->nfree = nslot - used;
+        p->unswept = 0;
+        p->inavail = 0;
+
+        *tail = p;
+        tail = &p->next;
+        if(p->nfree) {
+            avail_push(cls, p);
+        }
+    }
+    *tail = NULL;
+
+    free(order);
+    compact_order[c] = NULL;
+
+    return released;
+}
+
+/* moves the objects once every reference is forwarded; returns the pages released */
+size_t heap_compact_finish() {
+    size_t released = 0;
+
+    for(size_t c = 0; c < NCLASS; ++c) {
+        if(compact_order[c]) {
+            released += compact_class(c);
+        }
+    }
+
+    return released;
+}
+
+void heap_dump() {
+    int counter = 0;
+    puts("----- [heap dump] -----");
+    for(size_t c = 0; c < NCLASS; ++c) {
+        for(HeapPage *p = classes[c].pages; p; p = p->next) {
+            for(size_t g = 0; g < HEAP_NGRANULE; ++g) {
+                if(!BITMAP_TEST(p->allocbits, g)) continue;
+
+                MxcObject *ob = (MxcObject *)((uint8_t *)p + (g << HEAP_GRANULE_SHIFT));
+                printf("%s%d: ", GC_MARKED(ob) ? "[marked]" : "", counter++);
+                printf("%s\n", OBJIMPL(ob)->type_name);
+            }
+        }
+    }
+    puts("-----------------------");
+}
+
+size_t heap_length() {
+    size_t n = 0;
+    for(size_t c = 0; c < NCLASS; ++c) {
+        for(HeapPage *p = classes[c].pages; p; p = p->next) {
+            n += p->nslot - p->nfree;
+        }
+    }
+
+    return n;
+}
+
+/*
+ *  Region pages are bump-allocated in slot order and never swept. Pages
+ *  of released regions are kept for the next ones.
+ */
+#define REGION_POOL_MAX 32
+
+static HeapPage *region_pool;
+static int region_npool;
+
+MxcObject *region_alloc(Region *r, size_t size) {
+    if(size > HEAP_MAX_SMALL) {
+        intern_die("object too large for the heap");
+    }
+
+    int sc = class_of[(size + HEAP_GRANULE - 1) >> HEAP_GRANULE_SHIFT];
+    HeapPage *page = r->cur[sc];
+
+    if(!page || page->nfree == 0) {
+        if(region_pool) {
+            page = region_pool;
+            region_pool = page->next;
+            region_npool--;
+        }
+        else {
+            page = page_map();
+        }
+        page_init(page, sc);
+        page->nfree = page->nslot;
+        page->region = r->depth;
+
+        page->next = r->pages;
+        r->pages = page;
+        r->cur[sc] = page;
+    }
+
+    MxcObject *ob = slot_at(page, page->nslot - page->nfree--);
+    BITMAP_SET(page->allocbits, HEAP_GRANULE_OF(ob));
+
+    return ob;
+}
+
+void region_pages_release(Region *r) {
+    HeapPage *next;
+
+    for(HeapPage *p = r->pages; p; p = next) {
+        next = p->next;
+#ifdef MXC_DEBUG
+        memset(p, 0xdb, HEAP_PAGE_SIZE);
+#endif
+        if(region_npool < REGION_POOL_MAX) {
+            p->next = region_pool;
+            region_pool = p;
+            region_npool++;
+        }
+        else {
+            munmap(p, HEAP_PAGE_SIZE);
+        }
+    }
+
+    r->pages = NULL;
+    memset(r->cur, 0, sizeof(r->cur));
+}
+
+/* the GC takes over the pages of a region whose objects escaped */
+void region_pages_adopt(Region *r) {
+    HeapPage *next;
+
+    for(HeapPage *p = r->pages; p; p = next) {
+        next = p->next;
+        SizeClass *cls = &classes[p->sizeclass];
+        size_t used = p->nslot - p->nfree;
+
+        p->region = 0;
+        p->freelist = NULL;
+        for(size_t s = p->nslot; s-- > used;) {
+            MxcObject *ob = slot_at(p, s);
+            *(MxcObject **)ob = p->freelist;
+            p->freelist = ob;
+        }
+        /* a running major cycle keeps them, like objects allocated black */
+        if(gc_marking) {
+            memcpy(p->markbits, p->allocbits, sizeof(p->markbits));
+        }
+
+        p->next = cls->pages;
+        cls->pages = p;
+        if(p->nfree) {
+            avail_push(cls, p);
+        }
+    }
+
+    r->pages = NULL;
+    memset(r->cur, 0, sizeof(r->cur));
+}
+
+void nursery_reset() {
+    for(int i = 0; i < nursery_owners->len; ++i) {
+        MxcObject *ob = nursery_owners->data[i];
+
+        if(!(ob->gc_flags & GC_FORWARDED)) {
+            OBJIMPL(ob)->dealloc(ob);
+        }
+    }
+    nursery_owners->len = 0;
+    nursery_ext = 0;
+
+#ifdef MXC_DEBUG
+    memset(nursery_start, 0xdb, nursery_top - nursery_start);
+#endif
+    nursery_top = nursery_start;
+}
+
+/*
+ *  Never collects: the VM empties the nursery at its next safepoint.
+ *  Until then allocation spills into the old generation, and such
+ *  objects are remembered since they are initialized without barriers.
+ */
+MxcObject *Mxc_malloc(size_t s) {
+    if(!heap_ready) {
+        heap_init();
+    }
+
+    size_t size = (s + HEAP_GRANULE - 1) & ~(size_t)(HEAP_GRANULE - 1);
+    MxcObject *ob;
+
+    /* the profiler records every object, so regions are ignored */
+    if(nregion && !heap_profiling) {
+        ob = region_alloc(region_current(), size);
+        ob->gc_flags = GC_REGION_FLAGS;
+        ob->size = size;
+        ob->extsize = 0;
+#ifndef USE_MARK_AND_SWEEP
+        ob->refcount = 0;
+#endif
+        return ob;
+    }
 
 #ifdef USE_MARK_AND_SWEEP
-    ob->marked = 0;
-    ob->gc_guard = 0;
-    if(!tailp) {    /* first call */
-        root.obj = ob;
-        root.next = NULL;
-        tailp = &root;
+    if(heap_profiling) {
+        /* objects must keep the address their site is recorded at */
+        ob = heap_alloc(size);
+        if(gc_marking) {
+            GC_SET_MARK(ob);
+        }
+        nursery_ext += size;
+        if(nursery_ext >= NURSERY_SIZE) {
+            gc_pending = 1;
+        }
+    }
+    else if(nursery_top + size <= nursery_end) {
+        ob = (MxcObject *)nursery_top;
+        nursery_top += size;
     }
     else {
-        GCHeap *new = malloc(sizeof(GCHeap));
-        new->obj = ob;
-        new->next = NULL;
-        tailp->next = new;
-        tailp = new;
+        ob = heap_alloc(size);
+        gc_pending = 1;
+        if(gc_marking) {
+            GC_SET_MARK(ob);
+        }
     }
 #else
-    ob->refcount = 1;
+    /* no nursery: objects are freed in place */
+    ob = heap_alloc(size);
 #endif  /* USE_MARK_AND_SWEEP */
 
+    ob->gc_flags = 0;
+    ob->size = size;
+    ob->extsize = 0;
+
+#ifdef USE_MARK_AND_SWEEP
+    /* nothing is young while profiling */
+    if(!IS_YOUNG(ob) && !heap_profiling) {
+        gc_remember(ob);
+    }
+#else
+    rc_track(ob);
+#endif  /* USE_MARK_AND_SWEEP */
+
+    if(heap_profiling) {
+        heapprof_alloc(ob);
+    }
+
+    return ob;
+}
+
+MxcObject *Mxc_malloc_fin(size_t s) {
+    MxcObject *ob = Mxc_malloc(s);
+
+    if(IS_YOUNG(ob)) {
+        vec_push(nursery_owners, ob);
+    }
+    else if(ob->gc_flags & GC_REGION) {
+        region_own(ob);
+    }
+
     return ob;
 }
 
+/*
+ *  Records that ob now owns n bytes of malloc'd memory. Buffers of young
+ *  objects count towards the next minor collection, the others towards
+ *  the next major one.
+ */
+void Mxc_set_extsize(MxcObject *ob, size_t n) {
+    if(n > UINT32_MAX) {
+        n = UINT32_MAX;
+    }
+    /* counted when the region escapes */
+    if(ob->gc_flags & GC_REGION) {
+        ob->extsize = n;
+        return;
+    }
+    if(heap_profiling) {
+        heapprof_resize(ob, n);
+    }
+
+    if(IS_YOUNG(ob)) {
+        if(n > ob->extsize) {
+            nursery_ext += n - ob->extsize;
+            if(nursery_ext >= NURSERY_SIZE) {
+                gc_pending = 1;
+            }
+        }
+    }
+    else {
+        if(n > ob->extsize) {
+            allocated_mem += n - ob->extsize;
+        }
+        heap_bytes += n;
+        heap_bytes -= ob->extsize;
+        if(heap_bytes >= gc_trigger) {
+            gc_pending = 1;
+        }
+    }
+
+    ob->extsize = n;
+}
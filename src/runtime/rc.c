@@ -0,0 +1,284 @@
+/* deferred reference counting, built with `make rc` */
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "object/object.h"
+#include "gc.h"
+
+#ifndef USE_MARK_AND_SWEEP
+
+/*
+ *  Only references from heap objects are counted. An object whose count
+ *  drops to zero goes into the zero count table (ZCT) and is freed at the
+ *  next safepoint unless the stack, a local, a global or a handle still
+ *  refers to it.
+ *
+ *  Cycles are found by trial deletion (Bacon and Rajan): objects whose
+ *  count was decremented to non-zero, or that left the ZCT with a heap
+ *  reference, are buffered as possible roots of garbage cycles, their internal references are subtracted, and whatever
+ *  ends up with no external reference is freed.
+ */
+#define RC_ZCT_LIMIT    (1 << 12)
+
+static Vector *zct;
+static Vector *kept;
+static Vector *candidates;
+static Vector *work;
+static Vector *blacken;
+static size_t ncycle;
+
+static void zct_push(MxcObject *ob) {
+    if(ob->gc_flags & GC_ZCT) return;
+
+    ob->gc_flags |= GC_ZCT;
+    vec_push(zct, ob);
+    if(zct->len >= RC_ZCT_LIMIT) {
+        gc_pending = 1;
+    }
+}
+
+static void rc_init() {
+    zct = New_Vector();
+    kept = New_Vector();
+    candidates = New_Vector();
+    work = New_Vector();
+    blacken = New_Vector();
+}
+
+/* new objects start with no heap reference */
+void rc_track(MxcObject *ob) {
+    if(!zct) {
+        rc_init();
+    }
+
+    ob->refcount = 0;
+    zct_push(ob);
+}
+
+static void possible_root(MxcObject *ob) {
+    if(!(ob->gc_flags & GC_PURPLE) && OBJIMPL(ob)->trace) {
+        ob->gc_flags |= GC_PURPLE;
+        vec_push(candidates, ob);
+    }
+}
+
+/* objects of an escaped region keep the counts they got there */
+void rc_adopt(MxcObject *ob) {
+    if(!zct) {
+        rc_init();
+    }
+
+    ob->gc_flags &= ~(GC_ZCT | GC_PURPLE);
+    if(ob->refcount == 0)
+        zct_push(ob);
+    else
+        possible_root(ob);
+}
+
+void rc_decref(MxcObject *ob) {
+    if(--ob->refcount == 0) {
+        zct_push(ob);
+    }
+    else {
+        possible_root(ob);
+    }
+}
+
+static void release_slot(MxcValue *slot) {
+    RC_DECREF(*slot);
+}
+
+/*
+ *  Stale ZCT and candidate entries may point to freed slots, so flags
+ *  are cleared before the slot goes back to the heap.
+ */
+static void rc_free(MxcObject *ob) {
+    ob->gc_flags = 0;
+    OBJIMPL(ob)->dealloc(ob);
+}
+
+static void root_slot(MxcValue *slot) {
+    if(isobj(*slot)) {
+        slot->obj->gc_flags |= GC_ROOTED;
+    }
+}
+
+static void unroot_slot(MxcValue *slot) {
+    if(isobj(*slot)) {
+        slot->obj->gc_flags &= ~GC_ROOTED;
+    }
+}
+
+static void gray_child(MxcValue *slot) {
+    if(!isobj(*slot)) return;
+
+    MxcObject *ob = slot->obj;
+    ob->refcount--;
+    if(!(ob->gc_flags & GC_GRAY)) {
+        ob->gc_flags |= GC_GRAY;
+        vec_push(work, ob);
+    }
+}
+
+/* subtracts the references from inside the subgraph of ob */
+static void mark_gray(MxcObject *ob) {
+    if(ob->gc_flags & GC_GRAY) return;
+
+    ob->gc_flags |= GC_GRAY;
+    vec_push(work, ob);
+    while(work->len > 0) {
+        MxcObject *o = vec_pop(work);
+        if(OBJIMPL(o)->trace) {
+            OBJIMPL(o)->trace(o, gray_child);
+        }
+    }
+}
+
+static void black_child(MxcValue *slot) {
+    if(!isobj(*slot)) return;
+
+    MxcObject *ob = slot->obj;
+    ob->refcount++;
+    if(ob->gc_flags & (GC_GRAY | GC_WHITE)) {
+        ob->gc_flags &= ~(GC_GRAY | GC_WHITE);
+        vec_push(blacken, ob);
+    }
+}
+
+/* ob is externally referenced: restore the counts below it */
+static void scan_black(MxcObject *ob) {
+    ob->gc_flags &= ~(GC_GRAY | GC_WHITE);
+    vec_push(blacken, ob);
+    while(blacken->len > 0) {
+        MxcObject *o = vec_pop(blacken);
+        if(OBJIMPL(o)->trace) {
+            OBJIMPL(o)->trace(o, black_child);
+        }
+    }
+}
+
+static void push_child(MxcValue *slot) {
+    if(isobj(*slot)) {
+        vec_push(work, slot->obj);
+    }
+}
+
+static void scan(MxcObject *root) {
+    vec_push(work, root);
+    while(work->len > 0) {
+        MxcObject *ob = vec_pop(work);
+        if(!(ob->gc_flags & GC_GRAY)) continue;
+
+        /* region objects live until their block exits */
+        if(ob->refcount > 0 || (ob->gc_flags & (GC_ROOTED | GC_REGION))) {
+            /* only referenced from roots now, so it belongs in the ZCT */
+            if(ob->refcount == 0) {
+                zct_push(ob);
+            }
+            scan_black(ob);
+        }
+        else {
+            ob->gc_flags = (ob->gc_flags & ~GC_GRAY) | GC_WHITE;
+            if(OBJIMPL(ob)->trace) {
+                OBJIMPL(ob)->trace(ob, push_child);
+            }
+        }
+    }
+}
+
+static void push_white(MxcValue *slot) {
+    if(isobj(*slot) && (slot->obj->gc_flags & GC_WHITE)) {
+        vec_push(work, slot->obj);
+    }
+}
+
+/* white objects only reference each other or black objects that do not count them */
+static void collect_white(MxcObject *root) {
+    vec_push(work, root);
+    while(work->len > 0) {
+        MxcObject *ob = vec_pop(work);
+        if(!(ob->gc_flags & GC_WHITE)) continue;
+
+        ob->gc_flags &= ~GC_WHITE;
+        if(OBJIMPL(ob)->trace) {
+            OBJIMPL(ob)->trace(ob, push_white);
+        }
+        rc_free(ob);
+        ncycle++;
+    }
+}
+
+static void collect_cycles() {
+    Vector *roots = New_Vector();
+
+    for(int i = 0; i < candidates->len; ++i) {
+        MxcObject *ob = candidates->data[i];
+        if(!(ob->gc_flags & GC_PURPLE)) continue;
+
+        ob->gc_flags &= ~GC_PURPLE;
+        if(ob->refcount > 0) {
+            mark_gray(ob);
+            vec_push(roots, ob);
+        }
+    }
+    candidates->len = 0;
+
+    for(int i = 0; i < roots->len; ++i) {
+        scan(roots->data[i]);
+    }
+    for(int i = 0; i < roots->len; ++i) {
+        collect_white(roots->data[i]);
+    }
+
+    Delete_Vector(roots);
+}
+
+/* frees unreferenced objects of the ZCT, and garbage cycles if asked to */
+void rc_reconcile(bool cycles) {
+    if(!zct) return;
+
+    gc_visit_roots(root_slot);
+
+    /* freeing an object may append its children */
+    for(int i = 0; i < zct->len; ++i) {
+        MxcObject *ob = zct->data[i];
+        if(!(ob->gc_flags & GC_ZCT)) continue;
+
+        ob->gc_flags &= ~GC_ZCT;
+        if(ob->refcount > 0) {
+            /* its counts were never decremented, so it may close a cycle */
+            possible_root(ob);
+            continue;
+        }
+
+        if(ob->gc_flags & GC_ROOTED) {
+            vec_push(kept, ob);
+        }
+        else {
+            if(OBJIMPL(ob)->trace) {
+                OBJIMPL(ob)->trace(ob, release_slot);
+            }
+            rc_free(ob);
+        }
+    }
+
+    Vector *t = zct;
+    zct = kept;
+    kept = t;
+    kept->len = 0;
+    for(int i = 0; i < zct->len; ++i) {
+        ((MxcObject *)zct->data[i])->gc_flags |= GC_ZCT;
+    }
+
+    if(cycles) {
+        collect_cycles();
+    }
+
+    gc_visit_roots(unroot_slot);
+}
+
+size_t rc_ncycle() {
+    return ncycle;
+}
+
+#endif  /* USE_MARK_AND_SWEEP */
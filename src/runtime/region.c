@@ -0,0 +1,183 @@
+/* region blocks: bulk allocation released when the block exits */
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "region.h"
+#include "gc.h"
+
+int nregion = 0;
+size_t region_nreleased = 0;
+size_t region_nescaped = 0;
+
+static Region regions[REGION_NEST_MAX];
+
+#define NACTIVE (nregion < REGION_NEST_MAX ? nregion : REGION_NEST_MAX)
+
+Region *region_current() {
+    return &regions[NACTIVE - 1];
+}
+
+void region_enter() {
+    /* deeper blocks share the innermost region */
+    if(++nregion > REGION_NEST_MAX) return;
+
+    Region *r = region_current();
+    if(!r->owners) {
+        r->owners = New_Vector();
+    }
+    r->depth = nregion;
+    r->escaped = false;
+}
+
+void region_escape(MxcObject *ob) {
+    regions[HEAP_PAGE(ob)->region - 1].escaped = true;
+}
+
+void region_own(MxcObject *ob) {
+    vec_push(region_current()->owners, ob);
+}
+
+static void each_object(Region *r, void (*fn)(MxcObject *)) {
+    for(HeapPage *p = r->pages; p; p = p->next) {
+        for(int w = 0; w < HEAP_BITMAP_WORDS; ++w) {
+            uint64_t bits = p->allocbits[w];
+
+            while(bits) {
+                int bit = __builtin_ctzll(bits);
+                bits &= bits - 1;
+
+                fn((MxcObject *)((uint8_t *)p +
+                                 (((size_t)w * 64 + bit) << HEAP_GRANULE_SHIFT)));
+            }
+        }
+    }
+}
+
+static ob_visit_fn visitor;
+
+static void visit_object(MxcObject *ob) {
+    if(OBJIMPL(ob)->trace) {
+        OBJIMPL(ob)->trace(ob, visitor);
+    }
+}
+
+/* region objects are roots until their block exits */
+void region_visit(ob_visit_fn visit) {
+    visitor = visit;
+    for(int i = 0; i < NACTIVE; ++i) {
+        each_object(&regions[i], visit_object);
+    }
+}
+
+static bool refers_to(MxcValue *vars, size_t n, int depth) {
+    for(size_t i = 0; i < n; ++i) {
+        if(isobj(vars[i]) && REGION_OF(vars[i].obj) == depth)
+            return true;
+    }
+
+    return false;
+}
+
+#ifndef USE_MARK_AND_SWEEP
+static void release_slot(MxcValue *slot) {
+    RC_DECREF(*slot);
+}
+
+/* references from region objects were counted */
+static void release_object(MxcObject *ob) {
+    if(OBJIMPL(ob)->trace) {
+        OBJIMPL(ob)->trace(ob, release_slot);
+    }
+}
+#endif
+
+static void release(Region *r) {
+#ifndef USE_MARK_AND_SWEEP
+    each_object(r, release_object);
+#endif
+    for(int i = 0; i < r->owners->len; ++i) {
+        MxcObject *ob = r->owners->data[i];
+        OBJIMPL(ob)->dealloc(ob);
+    }
+    r->owners->len = 0;
+
+    region_pages_release(r);
+    region_nreleased++;
+}
+
+/* objects of enclosing regions become reachable from the heap too */
+static void escape_slot(MxcValue *slot) {
+    if(isobj(*slot) && (slot->obj->gc_flags & GC_REGION)) {
+        region_escape(slot->obj);
+    }
+}
+
+static void adopt_object(MxcObject *ob) {
+    size_t n = HEAP_PAGE(ob)->objsize + ob->extsize;
+    heap_bytes += n;
+    allocated_mem += n;
+
+    if(OBJIMPL(ob)->trace) {
+        OBJIMPL(ob)->trace(ob, escape_slot);
+    }
+
+#ifdef USE_MARK_AND_SWEEP
+    ob->gc_flags &= ~(GC_REGION | GC_REMEMBERED);
+    /* it may point to young objects */
+    if(OBJIMPL(ob)->trace) {
+        gc_remember(ob);
+    }
+#else
+    ob->gc_flags &= ~GC_REGION;
+    rc_adopt(ob);
+#endif
+}
+
+static void adopt(Region *r) {
+    each_object(r, adopt_object);
+    r->owners->len = 0;
+
+    region_pages_adopt(r);
+    region_nescaped++;
+    if(heap_bytes >= gc_trigger) {
+        gc_pending = 1;
+    }
+}
+
+/*
+ *  The VM has already cleared the variables declared inside the block.
+ *  Any other variable still referring to the region means an escape.
+ */
+void region_exit(Frame *f) {
+    if(nregion > REGION_NEST_MAX) {
+        nregion--;
+        return;
+    }
+
+    Region *r = region_current();
+    if(!r->escaped && r->pages) {
+        r->escaped = refers_to(f->gvars, f->ngvars, r->depth) ||
+                     refers_to(f->lvars, f->nlvars, r->depth);
+    }
+
+    nregion--;
+    if(r->escaped)
+        adopt(r);
+    else
+        release(r);
+}
+
+/* leaves the regions above depth after an error; their objects are kept */
+void region_unwind(int depth) {
+    while(nregion > depth) {
+        if(nregion > REGION_NEST_MAX) {
+            nregion--;
+            continue;
+        }
+
+        Region *r = region_current();
+        nregion--;
+        adopt(r);
+    }
+}
@@ -11,6 +11,7 @@
 #include "debug.h"
 #include "mem.h"
 #include "gc.h"
+#include "heapprof.h"
 #include "object/object.h"
 #include "object/boolobject.h"
 #include "object/charobject.h"
@@ -23,9 +24,11 @@
 // #define DPTEST
 
 int error_flag = 0;
+/* remaining jumps and calls before aborting; negative means unlimited */
+int64_t vm_fuel = -1;
 
 #ifndef DPTEST
-#define Dispatch() do { goto *optable[*pc]; } while(0)
+#define Dispatch() do { goto *dispatch[*pc]; } while(0)
 #else
 #define DISPATCH_CASE(name, smallname)                                         \
     case OP_##name:                                                            \
@@ -64,6 +67,9 @@ int error_flag = 0;
             DISPATCH_CASE(JMP_EQ, jmp_eq)                                \
             DISPATCH_CASE(JMP, jmp)                                            \
             DISPATCH_CASE(JMP_NOTERR, jmp_noterr)                              \
+            DISPATCH_CASE(JUMP_TABLE, jump_table)                              \
+            DISPATCH_CASE(JUMP_BSEARCH, jump_bsearch)                          \
+            DISPATCH_CASE(JUMP_HASH, jump_hash)                                \
             DISPATCH_CASE(SUB, sub)                                            \
             DISPATCH_CASE(ADD, add)                                            \
             DISPATCH_CASE(MUL, mul)                                            \
@@ -93,6 +99,8 @@ int error_flag = 0;
             DISPATCH_CASE(STRINGSET, stringset)                                \
             DISPATCH_CASE(SUBSCR, subscr)                                      \
             DISPATCH_CASE(SUBSCR_STORE, subscr_store)                          \
+            DISPATCH_CASE(LIST_GET_NOCHECK, list_get_nocheck)                  \
+            DISPATCH_CASE(LIST_SET_NOCHECK, list_set_nocheck)                  \
             DISPATCH_CASE(STRUCTSET, structset)                                \
             DISPATCH_CASE(LISTSET, listset)                                    \
             DISPATCH_CASE(LISTSET_SIZE, listset_size)                          \
@@ -103,6 +111,10 @@ int error_flag = 0;
             DISPATCH_CASE(MEMBER_STORE, member_store)                          \
             DISPATCH_CASE(ITER_NEXT, iter_next)                                \
             DISPATCH_CASE(STRCAT, strcat)                                      \
+            DISPATCH_CASE(STRSLICE, strslice)                                  \
+            DISPATCH_CASE(STREQ, streq)                                        \
+            DISPATCH_CASE(STRNOTEQ, strnoteq)                                  \
+            DISPATCH_CASE(FORMAT, format)                                      \
             DISPATCH_CASE(BREAKPOINT, breakpoint)                              \
         default:                                                               \
             printf("err:%d\n", *pc);                        \
@@ -111,23 +123,57 @@ int error_flag = 0;
     } while(0)
 #endif
 
+/* chars are matched by their code */
+#define Match_Key(v)  ((v).num)
+
 #define List_Setitem(val, index, item) (olist(val)->elem[(index)] = (item))
 
 #define Member_Getitem(ob, offset)       (ostrct(ob)->field[(offset)])
 #define Member_Setitem(ob, offset, item) (ostrct(ob)->field[(offset)] = (item))
 
+/* assembled unsigned: negative words would shift into the sign bit */
 #define PEEK_i32(pc)  \
-    ((uint8_t)(pc)[3]<<24|(uint8_t)(pc)[2]<<16|   \
-     (uint8_t)(pc)[1]<<8 |(uint8_t)(pc)[0])
+    ((int32_t)((uint32_t)(uint8_t)(pc)[3]<<24|(uint32_t)(uint8_t)(pc)[2]<<16| \
+               (uint32_t)(uint8_t)(pc)[1]<<8 |(uint32_t)(uint8_t)(pc)[0]))
 #define READ_i32(pc) (pc += 4, PEEK_i32(pc - 4))
+#define PEEK_i64(pc)  \
+    ((int64_t)((uint64_t)(uint32_t)PEEK_i32((pc) + 4) << 32 |    \
+               (uint32_t)PEEK_i32(pc)))
 #define PEEK_i8(pc) (*(pc))
 #define READ_i8(pc) (PEEK_i8(pc++))
 
 #define CASE(op) OP_ ## op:
 
+#define CONSUME_FUEL()                                  \
+    do {                                                \
+        if(vm_fuel >= 0) {                              \
+            if(vm_fuel == 0) {                          \
+                mxc_raise_err(frame, RTERR_OUT_OF_FUEL);\
+                goto exit_failure;                      \
+            }                                           \
+            --vm_fuel;                                  \
+        }                                               \
+    } while(0)
+
+/* the nursery is only collected here, when no C code holds an object */
+#define GC_SAFEPOINT()                                  \
+    do {                                                \
+        if(gc_pending) {                                \
+            gc_safepoint();                             \
+        }                                               \
+    } while(0)
+
 Frame *cur_frame;
 extern clock_t gc_time;
 
+/* strings count code points */
+static int64_t iterable_len(MxcIterable *ls) {
+    if(OBJIMPL(ls) == &string_objimpl)
+        return str_nchars((MxcString *)ls);
+
+    return ls->length;
+}
+
 int VM_run(Frame *frame) {
 #ifdef MXC_DEBUG
     printf(MUTED("ptr: %p")"\n", frame->stackptr);
@@ -150,6 +196,13 @@ int vm_exec(Frame *frame) {
 #include "opcode-def.h"
 #undef OPCODE_DEF
     };
+    /* every instruction first records where it is */
+    static const void *proftable[] = {
+#define OPCODE_DEF(op) &&profile_site,
+#include "opcode-def.h"
+#undef OPCODE_DEF
+    };
+    const void *const *dispatch = heap_profiling ? proftable : optable;
 #endif
 
     cur_frame = frame;
@@ -158,9 +211,17 @@ int vm_exec(Frame *frame) {
     uint8_t *pc = &frame->code[0];
     Literal **lit_table = (Literal **)ltable->data;
     int key;
+    int region_base = nregion;
 
     Dispatch();
 
+#ifndef DPTEST
+profile_site:
+    /* the allocation site of the objects created by this instruction */
+    frame->pc = pc - frame->code;
+    goto *optable[*pc];
+#endif
+
     CASE(PUSH) {
         ++pc;
         key = READ_i32(pc); 
@@ -178,7 +239,7 @@ int vm_exec(Frame *frame) {
     }
     CASE(CPUSH) {
         ++pc;
-        Push(new_char(READ_i8(pc)));
+        Push(mval_char(READ_i32(pc)));
 
         Dispatch();
     }
@@ -278,6 +339,53 @@ int vm_exec(Frame *frame) {
 
         Dispatch();
     }
+    CASE(STREQ) {
+        ++pc;
+        MxcValue r = Pop();
+        MxcValue l = Top();
+        SetTop(str_eq(l, r) ? mval_true : mval_false);
+
+        Dispatch();
+    }
+    CASE(STRNOTEQ) {
+        ++pc;
+        MxcValue r = Pop();
+        MxcValue l = Top();
+        SetTop(str_eq(l, r) ? mval_false : mval_true);
+
+        Dispatch();
+    }
+    CASE(FORMAT) {
+        ++pc;
+        int n = READ_i32(pc);
+        /* the pieces stay on the stack until the result is allocated */
+        MxcValue res = str_format(frame->stackptr - n, n);
+        frame->stackptr -= n;
+        Push(res);
+
+        Dispatch();
+    }
+    CASE(STRSLICE) {
+        ++pc;
+        int64_t end = Pop().num;
+        int64_t begin = Pop().num;
+        MxcValue s = Top();
+        int64_t len = str_nchars(ostr(s));
+        if(end > len) {
+            raise_outofrange(frame, mval_int(end), mval_int(len));
+            goto exit_failure;
+        }
+        if(begin < 0 || begin > end) {
+            raise_badslice(frame, mval_int(begin), mval_int(end));
+            goto exit_failure;
+        }
+        /* indices count code points */
+        size_t b = str_offset(ostr(s), begin);
+        size_t e = str_offset(ostr(s), end);
+        SetTop(str_slice(s, b, e - b));
+
+        Dispatch();
+    }
     CASE(SUB) {
         ++pc;
         MxcValue r = Pop();
@@ -555,6 +663,7 @@ int vm_exec(Frame *frame) {
         MxcValue old = gvmap[key];
 
         gvmap[key] = Top();
+        GC_GLOBAL_BARRIER(Top());
 
         Dispatch();
     }
@@ -587,6 +696,8 @@ int vm_exec(Frame *frame) {
     }
     CASE(JMP) {
         ++pc;
+        CONSUME_FUEL();
+        GC_SAFEPOINT();
         frame->pc = READ_i32(pc);
         pc = &frame->code[frame->pc];
 
@@ -607,6 +718,73 @@ int vm_exec(Frame *frame) {
 
         Dispatch();
     }
+    CASE(JUMP_TABLE) {
+        ++pc;
+        MxcValue v = Pop();
+        int64_t k = Match_Key(v) - (int32_t)READ_i32(pc);
+        int64_t n = READ_i32(pc);
+
+        if(k >= 0 && k < n)
+            frame->pc = PEEK_i32(pc + 4 + k * 4);
+        else
+            frame->pc = PEEK_i32(pc);
+        pc = &frame->code[frame->pc];
+
+        Dispatch();
+    }
+    CASE(JUMP_BSEARCH) {
+        ++pc;
+        MxcValue v = Pop();
+        int64_t k = Match_Key(v);
+        int lo = 0;
+        int hi = READ_i32(pc);
+
+        frame->pc = PEEK_i32(pc);
+        pc += 4;
+
+        while(lo < hi) {
+            int mid = (lo + hi) / 2;
+            int64_t key = PEEK_i64(pc + mid * 12);
+
+            if(key == k) {
+                frame->pc = PEEK_i32(pc + mid * 12 + 8);
+                break;
+            }
+            else if(key < k)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        pc = &frame->code[frame->pc];
+
+        Dispatch();
+    }
+    CASE(JUMP_HASH) {
+        ++pc;
+        MxcString *s = ostr(Pop());
+        uint32_t mask = READ_i32(pc);
+        uint32_t h = str_hashof(s) & mask;
+
+        frame->pc = PEEK_i32(pc);
+        pc += 4;
+
+        for(;;) {
+            int lit = PEEK_i32(pc + h * 8);
+            if(lit == -1) break;
+
+            InternedStr *is = lit_table[lit]->str;
+            if(ITERABLE(s)->length == is->len &&
+               (STR_PTR(s) == is->str ||
+                memcmp(STR_PTR(s), is->str, is->len) == 0)) {
+                frame->pc = PEEK_i32(pc + h * 8 + 4);
+                break;
+            }
+            h = (h + 1) & mask;
+        }
+        pc = &frame->code[frame->pc];
+
+        Dispatch();
+    }
     CASE(JMP_NOTEQ) {
         ++pc;
         MxcValue a = Pop();
@@ -641,7 +819,9 @@ int vm_exec(Frame *frame) {
         MxcValue list = new_list(narg);
         ITERABLE(olist(list))->next = Top();
         while(--narg >= 0) {
-            List_Setitem(list, narg, Pop());
+            MxcValue item = Pop();
+            List_Setitem(list, narg, item);
+            RC_INCREF(item);
         }
         Push(list);
 
@@ -671,9 +851,7 @@ int vm_exec(Frame *frame) {
         MxcValue idx = Top();
         MxcValue ob = OBJIMPL(ls)->get(ls, idx.num);
         if(Invalid_val(ob)) {
-            raise_outofrange(frame,
-                    idx,
-                    mval_int(ITERABLE(ls)->length));
+            raise_outofrange(frame, idx, mval_int(iterable_len(ls)));
             goto exit_failure;
         }
         SetTop(ob);
@@ -687,19 +865,33 @@ int vm_exec(Frame *frame) {
         MxcValue top = Top();
         MxcValue res = OBJIMPL(ls)->set(ls, idx.num, top);
         if(Invalid_val(res)) {
-            raise_outofrange(frame,
-                             idx,
-                             mval_int(ls->length));
+            raise_outofrange(frame, idx, mval_int(iterable_len(ls)));
             goto exit_failure;
         }
 
         Dispatch();
     }
+    CASE(LIST_GET_NOCHECK) {
+        ++pc;
+        MxcList *ls = olist(Pop());
+        SetTop(ls->elem[Top().num]);
+
+        Dispatch();
+    }
+    CASE(LIST_SET_NOCHECK) {
+        ++pc;
+        MxcList *ls = olist(Pop());
+        MxcValue idx = Pop();
+        GC_SATB_BARRIER(ls->elem[idx.num]);
+        ls->elem[idx.num] = Top();
+        GC_WRITE_BARRIER(ls, Top());
+
+        Dispatch();
+    }
     CASE(STRINGSET) {
         ++pc;
         key = READ_i32(pc);
-        char *str = lit_table[key]->str;
-        Push(new_string_static(str, strlen(str)));
+        Push(new_string_interned(lit_table[key]->str));
 
         Dispatch();
     }
@@ -727,6 +919,8 @@ int vm_exec(Frame *frame) {
     }
     CASE(CALL) {
         ++pc;
+        CONSUME_FUEL();
+        GC_SAFEPOINT();
         int nargs = READ_i32(pc);
         MxcValue callee = Pop();
         int ret = ocallee(callee)->call(ocallee(callee), frame, nargs);
@@ -753,7 +947,9 @@ int vm_exec(Frame *frame) {
         MxcValue strct = Pop();
         MxcValue data = Top();
 
+        GC_SATB_BARRIER(Member_Getitem(strct, offset));
         Member_Setitem(strct, offset, data);
+        GC_WRITE_BARRIER(strct.obj, data);
 
         Dispatch();
     }
@@ -787,6 +983,25 @@ int vm_exec(Frame *frame) {
 
         Dispatch();
     }
+    CASE(REGION_ENTER) {
+        ++pc;
+        region_enter();
+        Dispatch();
+    }
+    CASE(REGION_EXIT) {
+        ++pc;
+        int global = READ_i8(pc);
+        int n = READ_i32(pc);
+        MxcValue *vars = global ? gvmap : frame->lvars;
+
+        /* out of scope, but the GC would still see them */
+        for(int i = 0; i < n; ++i) {
+            vars[READ_i32(pc)] = mval_invalid;
+        }
+        region_exit(frame);
+
+        Dispatch();
+    }
     CASE(RET) {
         ++pc;
         return 0;
@@ -806,7 +1021,10 @@ int vm_exec(Frame *frame) {
     }
 
 exit_failure:
-    runtime_error(frame);
+    region_unwind(region_base);
+    /* errors inside a fuel-limited evaluation are reported by the caller */
+    if(vm_fuel < 0)
+        runtime_error(frame);
 
     return 1;
 }
@@ -818,7 +1036,7 @@ void stack_dump() {
     puts("---stack---");
     while(base < cur) {
         ob = *--cur;
-        printf("%s\n", ostr(mval2str(ob))->str);
+        printf("%s\n", str_cstr(ostr(mval2str(ob))));
     }
     puts("-----------");
 }
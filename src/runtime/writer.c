@@ -0,0 +1,180 @@
+/* buffered output and number formatting */
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "writer.h"
+
+#define STDOUT_BUFSIZE (64 * 1024)
+
+static char stdout_buf[STDOUT_BUFSIZE];
+MxcWriter mxc_stdout = {stdout_buf, 0, STDOUT_BUFSIZE, NULL, false};
+
+static void stdout_flush() {
+    writer_flush(&mxc_stdout);
+}
+
+void writer_init() {
+    mxc_stdout.fp = stdout;
+    mxc_stdout.linebuf = isatty(fileno(stdout));
+    atexit(stdout_flush);
+}
+
+void writer_open_mem(MxcWriter *w, size_t cap) {
+    w->cap = cap ? cap : 1;
+    w->buf = malloc(w->cap);
+    w->len = 0;
+    w->fp = NULL;
+    w->linebuf = false;
+}
+
+/* buf must hold everything written, as measured by a counting writer */
+void writer_open_buf(MxcWriter *w, char *buf, size_t cap) {
+    w->buf = buf;
+    w->len = 0;
+    w->cap = cap;
+    w->fp = NULL;
+    w->linebuf = false;
+}
+
+void writer_open_count(MxcWriter *w) {
+    w->buf = NULL;
+    w->len = 0;
+    w->cap = 0;
+    w->fp = NULL;
+    w->linebuf = false;
+}
+
+/* the buffer of a memory writer, NUL-terminated; the caller frees it */
+char *writer_cstr(MxcWriter *w) {
+    writer_putc(w, '\0');
+    w->len--;
+
+    return w->buf;
+}
+
+void writer_flush(MxcWriter *w) {
+    if(!w->fp) return;
+
+    fwrite(w->buf, 1, w->len, w->fp);
+    fflush(w->fp);
+    w->len = 0;
+}
+
+/* returns false if n bytes are better written around the buffer */
+static bool reserve(MxcWriter *w, size_t n) {
+    if(w->len + n <= w->cap) return true;
+
+    if(w->fp) {
+        writer_flush(w);
+        return n <= w->cap;
+    }
+
+    while(w->len + n > w->cap) w->cap *= 2;
+    w->buf = realloc(w->buf, w->cap);
+
+    return true;
+}
+
+void writer_write(MxcWriter *w, const char *s, size_t n) {
+    if(!w->buf) {
+        w->len += n;
+        return;
+    }
+    if(!reserve(w, n)) {
+        fwrite(s, 1, n, w->fp);
+        return;
+    }
+
+    memcpy(w->buf + w->len, s, n);
+    w->len += n;
+    if(w->linebuf && memchr(s, '\n', n)) {
+        writer_flush(w);
+    }
+}
+
+void writer_putc(MxcWriter *w, char c) {
+    if(!w->buf) {
+        w->len++;
+        return;
+    }
+    reserve(w, 1);
+    w->buf[w->len++] = c;
+
+    if(w->linebuf && c == '\n') {
+        writer_flush(w);
+    }
+}
+
+static const char digit_pairs[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+/* two digits per division */
+void writer_int(MxcWriter *w, int64_t v) {
+    char buf[24];
+    char *end = buf + sizeof(buf);
+    char *p = end;
+    uint64_t u = v < 0 ? -(uint64_t)v : (uint64_t)v;
+
+    while(u >= 100) {
+        p -= 2;
+        memcpy(p, digit_pairs + (u % 100) * 2, 2);
+        u /= 100;
+    }
+    if(u >= 10) {
+        p -= 2;
+        memcpy(p, digit_pairs + u * 2, 2);
+    }
+    else {
+        *--p = '0' + u;
+    }
+    if(v < 0) {
+        *--p = '-';
+    }
+
+    writer_write(w, p, end - p);
+}
+
+/*
+ *  The shortest of 15, 16 and 17 significant digits that reads back as
+ *  the same double. Integral values skip printf.
+ */
+void writer_float(MxcWriter *w, double f) {
+    char buf[32];
+    int n;
+
+    /* the longest "%.17g" output, e.g. "-2.2250738585072014e-308" */
+    if(!w->buf) {
+        w->len += 24;
+        return;
+    }
+
+    if(f > -1e15 && f < 1e15 && f == (double)(int64_t)f &&
+       !(f == 0 && signbit(f))) {
+        writer_int(w, (int64_t)f);
+        writer_write(w, ".0", 2);
+        return;
+    }
+
+    for(int prec = 15; ; ++prec) {
+        n = snprintf(buf, sizeof(buf), "%.*g", prec, f);
+        if(prec == 17 || strtod(buf, NULL) == f) break;
+    }
+
+    writer_write(w, buf, n);
+    /* "1" needs ".0" to read as a float, "1e+20" and "inf" do not */
+    if(!strpbrk(buf, ".en")) {
+        writer_write(w, ".0", 2);
+    }
+}
@@ -92,12 +92,14 @@ String *New_String() {
 }
 
 void string_push(String *self, char v) {
-    if(self->len == self->reserved) {
+    /* keep room for the terminator */
+    if(self->len + 1 == self->reserved) {
         self->reserved *= 2;
         self->data = realloc(self->data, sizeof(char) * self->reserved);
     }
 
     self->data[self->len++] = v;
+    self->data[self->len] = '\0';
 }
 
 char string_pop(String *self) {
@@ -116,6 +118,30 @@ int get_digit(int num) {
     return sprintf(buf, "%d", num);
 }
 
+/* FNV-1a */
+uint32_t str_hash(const char *s) {
+    uint32_t h = 2166136261u;
+
+    for(; *s; ++s) {
+        h ^= (uint8_t)*s;
+        h *= 16777619u;
+    }
+
+    return h;
+}
+
+/* same as str_hash for strings without '\0' */
+uint32_t str_hash_len(const char *s, size_t len) {
+    uint32_t h = 2166136261u;
+
+    for(size_t i = 0; i < len; ++i) {
+        h ^= (uint8_t)s[i];
+        h *= 16777619u;
+    }
+
+    return h;
+}
+
 char *read_file(char *path) {
     FILE *src_file = fopen(path, "r");
     if(!src_file) {
@@ -131,6 +157,7 @@ char *read_file(char *path) {
     if(fread(src, 1, fsize, src_file) < fsize) {
         error("Error reading file");
     }
+    src[fsize] = '\0';
 
     fclose(src_file);
 
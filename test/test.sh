@@ -3,7 +3,15 @@ fail=0
 for file in `\find ./test -name '*.mxc'`; do
     echo -n $file :\ 
     ./maxc $file > /dev/null
-    if [ $? -eq 0 ]; then
+    ok=$?
+    # `// dump has: op...` and `// dump lacks: op...` check the bytecode
+    for op in `sed -n 's|^// dump has: ||p' $file`; do
+        ./maxc --dump-code $file | grep -qwF $op || ok=1
+    done
+    for op in `sed -n 's|^// dump lacks: ||p' $file`; do
+        ./maxc --dump-code $file | grep -qwF $op && ok=1
+    done
+    if [ $ok -eq 0 ]; then
         echo "passed"
     else
         echo "failed"